@@ -0,0 +1,131 @@
+#ifndef _CS149_THREAD_POOL_H_
+#define _CS149_THREAD_POOL_H_
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#  include <pthread.h>
+#  include <sched.h>
+#endif
+
+//
+// ThreadPool --
+//
+// Threads that stay alive between calls to run().  run(numThreads, job)
+// calls job(threadId, numThreads) once for each threadId from 0 to
+// numThreads-1 and returns when all of them have.  The pool grows to the
+// largest numThreads asked for; threads beyond what a call asks for sit
+// it out.
+//
+// By default the calling thread works too, as threadId 0, and the pool
+// supplies the rest.  A pool built with callerWorks false runs every
+// threadId on its own pool thread and the caller only waits, so the same
+// thread always gets the same threadId; with pinned set, that thread is
+// also pinned to one CPU (on Linux).
+class ThreadPool {
+  public:
+    explicit ThreadPool(bool callerWorks = true, bool pinned = false)
+        : callerWorks(callerWorks), pinned(pinned), generation(0), activeThreads(0),
+          pending(0), terminated(false) {}
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            terminated = true;
+        }
+        startCv.notify_all();
+        for (size_t i = 0; i < threads.size(); i++)
+            threads[i].join();
+    }
+
+    void run(int numThreads, const std::function<void(int, int)>& work) {
+        int firstPoolId = callerWorks ? 1 : 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            // new threads start from the current generation, so they
+            // don't rerun the last call's job
+            while ((int)threads.size() + firstPoolId < numThreads) {
+                int threadId = threads.size() + firstPoolId;
+                threads.push_back(std::thread(&ThreadPool::workerLoop, this, threadId, generation));
+            }
+
+            job = work;
+            activeThreads = numThreads;
+            pending = numThreads - firstPoolId;
+            generation++;
+        }
+        startCv.notify_all();
+
+        if (callerWorks && numThreads > 0)
+            work(0, numThreads);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        doneCv.wait(lock, [this] { return pending <= 0; });
+    }
+
+  private:
+    // Pins the calling thread to the threadId-th CPU it may run on,
+    // wrapping around if there are fewer CPUs than threads.
+    static void pin(int threadId) {
+#if defined(__linux__)
+        cpu_set_t allowed;
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0)
+            return;
+        int target = threadId % CPU_COUNT(&allowed);
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &allowed) && target-- == 0) {
+                cpu_set_t one;
+                CPU_ZERO(&one);
+                CPU_SET(cpu, &one);
+                pthread_setaffinity_np(pthread_self(), sizeof(one), &one);
+                return;
+            }
+        }
+#endif
+    }
+
+    void workerLoop(int threadId, int seenGeneration) {
+        if (pinned)
+            pin(threadId);
+        while (true) {
+            std::function<void(int, int)> work;
+            int numThreads;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                startCv.wait(lock, [&] { return terminated || generation != seenGeneration; });
+                if (terminated)
+                    return;
+                seenGeneration = generation;
+
+                if (threadId >= activeThreads)
+                    continue;
+                work = job;
+                numThreads = activeThreads;
+            }
+
+            work(threadId, numThreads);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--pending == 0)
+                doneCv.notify_one();
+        }
+    }
+
+    const bool callerWorks;
+    const bool pinned;
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable startCv;
+    std::condition_variable doneCv;
+    int generation;
+    int activeThreads;
+    int pending;
+    bool terminated;
+    std::function<void(int, int)> job;
+};
+
+#endif // _CS149_THREAD_POOL_H_
@@ -20,6 +20,7 @@
     - TBB (ISPC_USE_TBB_TASK_GROUP, ISPC_USE_TBB_PARALLEL_FOR)
     - OpenMP (ISPC_USE_OMP)
     - HPX (ISPC_USE_HPX)
+    - the asst2 task system (ISPC_USE_ASST2)
 
   The task system implementation can be selected at compile time, by defining
   the appropriate preprocessor symbol on the command line (for e.g.: -D ISPC_USE_TBB).
@@ -39,6 +40,13 @@
   by assigning one pthread to each hyper-thread, and then uses spinlocks and atomics
   for task management.  This model is useful for KNC where tasks can take over
   the machine, but less so when there are other tasks that need running on the machine.
+  Idle workers and ISPCSync() park on futexes rather than polling.  Two
+  environment variables control where its threads run:
+    ISPC_RESERVED_CORES  number of cores not given a worker thread (default 1,
+                         for the thread calling ISPCSync(), which runs tasks too)
+    ISPC_PIN_CPUS        CPU list such as "0-3,8" that worker i is pinned to
+                         entry i of (cycling), or "none" for no pinning; by
+                         default worker i is pinned to CPU ISPC_RESERVED_CORES + i
 
 #define ISPC_USE_CREW
 #define ISPC_USE_HPX
@@ -48,11 +56,19 @@
   Number of threads can be specified as commandline parameter with
   --hpx:threads, use "all" to spawn one thread per processing unit.
 
+#define ISPC_USE_ASST2
+  The ASST2 model runs ispc tasks on the asst2 part B task system
+  (TaskSystemParallelThreadPoolSleeping), so that ispc 'launch'es and C++
+  task graphs in the same process share one pool of worker threads.  It
+  requires asst2-master/part_b on the include path and its tasksys.cpp
+  linked in; build the asst1 programs with 'make TASKSYS=asst2'.  Launches
+  made from inside an ispc task run on that task's thread.
+
 */
 
 #if !(defined ISPC_USE_CONCRT || defined ISPC_USE_GCD || defined ISPC_USE_PTHREADS ||                                  \
       defined ISPC_USE_PTHREADS_FULLY_SUBSCRIBED || defined ISPC_USE_TBB_TASK_GROUP ||                                 \
-      defined ISPC_USE_TBB_PARALLEL_FOR || defined ISPC_USE_OMP || defined ISPC_USE_HPX)
+      defined ISPC_USE_TBB_PARALLEL_FOR || defined ISPC_USE_OMP || defined ISPC_USE_HPX || defined ISPC_USE_ASST2)
 
 // If no task model chosen from the compiler cmdline, pick a reasonable default
 #if defined(_WIN32) || defined(_WIN64)
@@ -111,6 +127,7 @@ using namespace Concurrency;
 #include <unistd.h>
 #include <vector>
 //#include <stdexcept>
+#include <sched.h>
 #include <stack>
 #endif // ISPC_USE_PTHREADS_FULLY_SUBSCRIBED
 #ifdef ISPC_USE_TBB_PARALLEL_FOR
@@ -126,12 +143,24 @@ using namespace Concurrency;
 #include <hpx/include/async.hpp>
 #include <hpx/lcos/wait_all.hpp>
 #endif // ISPC_USE_HPX
+#ifdef ISPC_USE_ASST2
+#include "tasksys.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <unistd.h>
+#endif // ISPC_USE_ASST2
 #ifdef ISPC_IS_LINUX
+#include <limits.h>
+#include <linux/futex.h>
 #include <stdlib.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 #endif // ISPC_IS_LINUX
 
 #include <algorithm>
 #include <assert.h>
+#include <atomic>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -167,14 +196,120 @@ void *ISPCAlloc(void **handlePtr, int64_t size, int32_t alignment);
 void ISPCSync(void *handle);
 }
 
+///////////////////////////////////////////////////////////////////////////
+// ISPCAlloc arena
+
+/* The memory that ISPCAlloc() hands out comes in blocks whose sizes are
+   powers of two, from 4kB up ("size classes").  Blocks that are given
+   back go on a free list of the thread that gave them back, up to a few
+   per size class, and are reused from there; anything beyond that is
+   returned to the system.  Task groups are allocated and freed by the
+   same thread, so a program that keeps launching the same kernels
+   settles into reusing the same blocks without touching the allocator.
+
+   Run with ISPC_ARENA_STATS set in the environment to have the totals
+   below printed at exit, along with a warning if any block handed out
+   was never given back.
+ */
+
+#define LOG_MIN_ARENA_BLOCK_SIZE 12
+#define NUM_ARENA_SIZE_CLASSES 20
+#define MAX_FREE_ARENA_BLOCKS 4
+
+static std::atomic<int64_t> arenaLiveBytes(0);   // handed out, not yet given back
+static std::atomic<int64_t> arenaCachedBytes(0); // sitting on free lists
+static std::atomic<int64_t> arenaPeakBytes(0);   // max of live + cached
+static std::atomic<int64_t> arenaSystemAllocs(0);
+static std::atomic<int64_t> arenaReuses(0);
+
+// Returns the size class for a block of at least 'size' bytes, or -1 if
+// it's bigger than the largest class (such blocks are never cached).
+static inline int lArenaSizeClass(int64_t size) {
+    for (int c = 0; c < NUM_ARENA_SIZE_CLASSES; ++c)
+        if ((int64_t(1) << (LOG_MIN_ARENA_BLOCK_SIZE + c)) >= size)
+            return c;
+    return -1;
+}
+
+struct ThreadArena {
+    char *freeBlocks[NUM_ARENA_SIZE_CLASSES][MAX_FREE_ARENA_BLOCKS];
+    int numFreeBlocks[NUM_ARENA_SIZE_CLASSES];
+
+    ThreadArena() {
+        for (int c = 0; c < NUM_ARENA_SIZE_CLASSES; ++c)
+            numFreeBlocks[c] = 0;
+    }
+    ~ThreadArena() {
+        for (int c = 0; c < NUM_ARENA_SIZE_CLASSES; ++c)
+            for (int i = 0; i < numFreeBlocks[c]; ++i) {
+                arenaCachedBytes -= int64_t(1) << (LOG_MIN_ARENA_BLOCK_SIZE + c);
+                delete[] freeBlocks[c][i];
+            }
+    }
+};
+static thread_local ThreadArena threadArena;
+
+// Returns a block of at least 'size' bytes; its actual size, which must
+// be passed back to lArenaFree(), is returned in *blockSize.
+static char *lArenaAlloc(int64_t size, int64_t *blockSize) {
+    int c = lArenaSizeClass(size);
+    *blockSize = (c < 0) ? size : (int64_t(1) << (LOG_MIN_ARENA_BLOCK_SIZE + c));
+    arenaLiveBytes += *blockSize;
+
+    if (c >= 0 && threadArena.numFreeBlocks[c] > 0) {
+        arenaCachedBytes -= *blockSize;
+        ++arenaReuses;
+        return threadArena.freeBlocks[c][--threadArena.numFreeBlocks[c]];
+    }
+
+    ++arenaSystemAllocs;
+    int64_t total = arenaLiveBytes + arenaCachedBytes;
+    int64_t peak = arenaPeakBytes;
+    while (total > peak && !arenaPeakBytes.compare_exchange_weak(peak, total))
+        ;
+    return new char[*blockSize];
+}
+
+// Gives back a block from lArenaAlloc().  With 'cache' false the block
+// goes straight back to the system, which is what to do from code that
+// may run during thread exit, after this thread's free lists are gone.
+static void lArenaFree(char *block, int64_t blockSize, bool cache = true) {
+    arenaLiveBytes -= blockSize;
+
+    int c = lArenaSizeClass(blockSize);
+    if (cache && c >= 0 && (int64_t(1) << (LOG_MIN_ARENA_BLOCK_SIZE + c)) == blockSize &&
+        threadArena.numFreeBlocks[c] < MAX_FREE_ARENA_BLOCKS) {
+        arenaCachedBytes += blockSize;
+        threadArena.freeBlocks[c][threadArena.numFreeBlocks[c]++] = block;
+        return;
+    }
+    delete[] block;
+}
+
+static struct ArenaReport {
+    ~ArenaReport() {
+        if (getenv("ISPC_ARENA_STATS") == nullptr)
+            return;
+        fprintf(stderr,
+                "ISPCAlloc arena: %lld system allocations, %lld reuses, peak %lld bytes, "
+                "%lld bytes cached, %lld bytes live\n",
+                (long long)arenaSystemAllocs, (long long)arenaReuses, (long long)arenaPeakBytes,
+                (long long)arenaCachedBytes, (long long)arenaLiveBytes);
+        if (arenaLiveBytes != 0)
+            fprintf(stderr, "ISPCAlloc arena: %lld bytes were never given back (missing ISPCSync?)\n",
+                    (long long)arenaLiveBytes);
+    }
+} arenaReport;
+
 ///////////////////////////////////////////////////////////////////////////
 // TaskGroupBase
 
 #define LOG_TASK_QUEUE_CHUNK_SIZE 14
-#define MAX_TASK_QUEUE_CHUNKS 128
 #define TASK_QUEUE_CHUNK_SIZE (1 << LOG_TASK_QUEUE_CHUNK_SIZE)
 
-#define MAX_LAUNCHED_TASKS (MAX_TASK_QUEUE_CHUNKS * TASK_QUEUE_CHUNK_SIZE)
+// Segment i holds TASK_QUEUE_CHUNK_SIZE << i TaskInfos, so this many
+// segments cover every non-negative int task index.
+#define MAX_TASK_QUEUE_SEGMENTS (32 - LOG_TASK_QUEUE_CHUNK_SIZE)
 
 #define NUM_MEM_BUFFERS 16
 
@@ -201,17 +336,19 @@ class TaskGroupBase {
     int nextTaskInfoIndex;
 
   private:
-    /* We allocate blocks of TASK_QUEUE_CHUNK_SIZE TaskInfo structures as
-       needed by the calling function.  We hold up to MAX_TASK_QUEUE_CHUNKS
-       of these (and then exit at runtime if more than this many tasks are
-       launched.)
+    /* We allocate TaskInfo structures in segments as needed by the
+       calling function, each one twice the size of the one before, so
+       there's no limit on the number of tasks a group can launch.  Once
+       allocated a segment never moves, so other threads can keep reading
+       TaskInfos while the group launches more tasks.
      */
-    TaskInfo *taskInfo[MAX_TASK_QUEUE_CHUNKS];
+    TaskInfo *taskInfo[MAX_TASK_QUEUE_SEGMENTS];
 
     /* We also allocate chunks of memory to service ISPCAlloc() calls.  The
        memBuffers[] array holds pointers to this memory.  The first element
        of this array is initialized to point to mem and then any subsequent
-       elements required are initialized with dynamic allocation.
+       elements required come from the ISPCAlloc arena, and go back to it
+       when the group is Reset().
      */
     int curMemBuffer, curMemBufferOffset;
     int memBufferSize[NUM_MEM_BUFFERS];
@@ -231,21 +368,35 @@ inline TaskGroupBase::TaskGroupBase() {
         memBufferSize[i] = 0;
     }
 
-    for (int i = 0; i < MAX_TASK_QUEUE_CHUNKS; ++i)
+    for (int i = 0; i < MAX_TASK_QUEUE_SEGMENTS; ++i)
         taskInfo[i] = nullptr;
 }
 
 inline TaskGroupBase::~TaskGroupBase() {
     // Note: don't delete memBuffers[0], since it points to the start of
-    // the "mem" member!
+    // the "mem" member!  Groups can be deleted at thread exit, so don't
+    // use this thread's arena free lists here.
     for (int i = 1; i < NUM_MEM_BUFFERS; ++i)
-        delete[](memBuffers[i]);
+        if (memBuffers[i] != nullptr)
+            lArenaFree(memBuffers[i], memBufferSize[i], false);
+    for (int i = 0; i < MAX_TASK_QUEUE_SEGMENTS; ++i)
+        delete[](taskInfo[i]);
 }
 
 inline void TaskGroupBase::Reset() {
     nextTaskInfoIndex = 0;
     curMemBuffer = 0;
     curMemBufferOffset = 0;
+
+    // Free groups don't hold on to memory; it goes back to the arena,
+    // where any group allocated on this thread can reuse it.
+    for (int i = 1; i < NUM_MEM_BUFFERS; ++i) {
+        if (memBuffers[i] != nullptr) {
+            lArenaFree(memBuffers[i], memBufferSize[i]);
+            memBuffers[i] = nullptr;
+            memBufferSize[i] = 0;
+        }
+    }
 }
 
 inline int TaskGroupBase::AllocTaskInfo(int count) {
@@ -255,23 +406,16 @@ inline int TaskGroupBase::AllocTaskInfo(int count) {
 }
 
 inline TaskInfo *TaskGroupBase::GetTaskInfo(int index) {
-    int chunk = (index >> LOG_TASK_QUEUE_CHUNK_SIZE);
-    int offset = index & (TASK_QUEUE_CHUNK_SIZE - 1);
-
-    if (chunk == MAX_TASK_QUEUE_CHUNKS) {
-        fprintf(stderr,
-                "A total of %d tasks have been launched from the "
-                "current function--the simple built-in task system can handle "
-                "no more. You can increase the values of TASK_QUEUE_CHUNK_SIZE "
-                "and LOG_TASK_QUEUE_CHUNK_SIZE to work around this limitation.  "
-                "Sorry!  Exiting.\n",
-                index);
-        exit(1);
-    }
-
-    if (taskInfo[chunk] == nullptr)
-        taskInfo[chunk] = new TaskInfo[TASK_QUEUE_CHUNK_SIZE];
-    return &taskInfo[chunk][offset];
+    // Segment 'segment' starts at chunk number (1 << segment) - 1.
+    int chunkPlusOne = (index >> LOG_TASK_QUEUE_CHUNK_SIZE) + 1;
+    int segment = 0;
+    while ((chunkPlusOne >> (segment + 1)) != 0)
+        ++segment;
+    int offset = index - (((1 << segment) - 1) << LOG_TASK_QUEUE_CHUNK_SIZE);
+
+    if (taskInfo[segment] == nullptr)
+        taskInfo[segment] = new TaskInfo[TASK_QUEUE_CHUNK_SIZE << segment];
+    return &taskInfo[segment][offset];
 }
 
 inline void *TaskGroupBase::AllocMemory(int64_t size, int32_t alignment) {
@@ -289,10 +433,11 @@ inline void *TaskGroupBase::AllocMemory(int64_t size, int32_t alignment) {
     curMemBufferOffset = 0;
     assert(curMemBuffer < NUM_MEM_BUFFERS);
 
-    int allocSize = 1 << (12 + curMemBuffer);
-    allocSize = std::max(int(size + alignment), allocSize);
-    char *newBuf = new char[allocSize];
-    memBufferSize[curMemBuffer] = allocSize;
+    int64_t allocSize = int64_t(1) << (12 + curMemBuffer);
+    allocSize = std::max(size + alignment, allocSize);
+    int64_t blockSize;
+    char *newBuf = lArenaAlloc(allocSize, &blockSize);
+    memBufferSize[curMemBuffer] = int(blockSize);
     memBuffers[curMemBuffer] = newBuf;
     return AllocMemory(size, alignment);
 }
@@ -337,6 +482,25 @@ static inline int32_t lAtomicAdd(volatile int32_t *v, int32_t delta) {
 }
 #endif
 
+#if defined ISPC_USE_PTHREADS || defined ISPC_USE_PTHREADS_FULLY_SUBSCRIBED
+// Block until *addr no longer holds 'expected' (or a spurious wakeup).
+static inline void lFutexWait(volatile int32_t *addr, int32_t expected) {
+#ifdef ISPC_IS_LINUX
+    syscall(SYS_futex, (int32_t *)addr, FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+#else
+    // No futexes here; callers re-check *addr, so a short nap will do.
+    usleep(1);
+#endif // ISPC_IS_LINUX
+}
+
+// Wake every thread blocked in lFutexWait() on addr.
+static inline void lFutexWakeAll(volatile int32_t *addr) {
+#ifdef ISPC_IS_LINUX
+    syscall(SYS_futex, (int32_t *)addr, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#endif // ISPC_IS_LINUX
+}
+#endif
+
 ///////////////////////////////////////////////////////////////////////////
 
 #ifdef ISPC_USE_CONCRT
@@ -366,19 +530,30 @@ class TaskGroup : public TaskGroupBase {
 #endif // ISPC_USE_GCD
 
 #ifdef ISPC_USE_PTHREADS
-static void *lTaskEntry(void *arg);
-
+class TaskGroup;
+static TaskGroup *lClaimFromActiveGroups(int *first, int *count);
+
+/* Tasks are handed out to threads by atomically advancing
+   nextTaskToRun, a chunk of task indices at a time.  Since
+   AllocTaskInfo() hands out task indices consecutively, the tasks that
+   have been launched so far are always [0, numLaunchedTasks), and the
+   ones that are still waiting to run are [nextTaskToRun,
+   numLaunchedTasks).
+ */
 class TaskGroup : public TaskGroupBase {
   public:
     TaskGroup() {
         numUnfinishedTasks = 0;
-        waitingTasks.reserve(128);
+        nextTaskToRun = 0;
+        numLaunchedTasks = 0;
         inActiveList = false;
     }
 
     void Reset() {
         TaskGroupBase::Reset();
         numUnfinishedTasks = 0;
+        nextTaskToRun = 0;
+        numLaunchedTasks = 0;
         assert(inActiveList == false);
         lMemFence();
     }
@@ -386,12 +561,20 @@ class TaskGroup : public TaskGroupBase {
     void Launch(int baseIndex, int count);
     void Sync();
 
-  private:
-    friend void *lTaskEntry(void *arg);
+    int ClaimTasks(int *first);
+    void RunTasks(int first, int count, int threadIndex, int threadCount);
+    void FinishTasks(int count);
 
-    int32_t numUnfinishedTasks;
-    int32_t pad[3];
-    std::vector<int> waitingTasks;
+  private:
+    friend TaskGroup *lClaimFromActiveGroups(int *first, int *count);
+
+    // Every thread that runs tasks from this group hits these counters,
+    // so keep each of them on its own cache line.
+    volatile int32_t nextTaskToRun;
+    int32_t pad0[15];
+    volatile int32_t numUnfinishedTasks;
+    int32_t pad1[15];
+    volatile int32_t numLaunchedTasks;
     bool inActiveList;
 };
 
@@ -443,6 +626,56 @@ class TaskGroup : public TaskGroupBase {
 
 #endif // ISPC_USE_HPX
 
+#ifdef ISPC_USE_ASST2
+
+class TaskGroup;
+
+/* Each ISPCLaunch() becomes one bulk task launch on the asst2 task
+   system; an ISPCRunnable maps the asst2 task id back to the TaskInfo
+   that ISPCLaunch() filled in.
+ */
+class ISPCRunnable : public IRunnable {
+  public:
+    ISPCRunnable(TaskGroup *tg, int baseIndex) : tg(tg), baseIndex(baseIndex) {}
+
+    void runTask(int task_id, int num_total_tasks);
+
+  private:
+    TaskGroup *tg;
+    int baseIndex;
+};
+
+/* A group counts its own unfinished tasks, so that Sync() waits for just
+   this group's launches rather than everything on the task system.
+ */
+class TaskGroup : public TaskGroupBase {
+  public:
+    TaskGroup() : pending(0) {}
+
+    void Reset() {
+        TaskGroupBase::Reset();
+        runnables.clear();
+    }
+
+    void Launch(int baseIndex, int count);
+    void Sync();
+    void TaskDone();
+
+  private:
+    // A deque, so that pushing a new launch doesn't move runnables that
+    // worker threads are still using.
+    std::deque<ISPCRunnable> runnables;
+
+    // Only changed under lk_pending: once Sync() has seen it reach zero
+    // the group may be freed, so the last task must be done with the
+    // mutex by then.
+    int pending;
+    std::mutex lk_pending;
+    std::condition_variable cv_pending;
+};
+
+#endif // ISPC_USE_ASST2
+
 ///////////////////////////////////////////////////////////////////////////
 
 ///////////////////////////////////////////////////////////////////////////
@@ -547,80 +780,164 @@ static volatile int32_t lock = 0;
 static int nThreads;
 static pthread_t *threads = nullptr;
 
+// taskSysMutex only protects the activeTaskGroups list (and the
+// inActiveList flags); individual tasks are claimed with atomics.
 static pthread_mutex_t taskSysMutex;
 static std::vector<TaskGroup *> activeTaskGroups;
 static sem_t *workerSemaphore;
+static volatile int32_t numSleepingWorkers = 0;
 
-static void *lTaskEntry(void *arg) {
-    int threadIndex = (int)((int64_t)arg);
-    int threadCount = nThreads;
+// Bumped every time some task group's last task finishes.  Threads in
+// TaskGroup::Sync() with nothing left to help with sleep on it; it lives
+// outside the groups since a group may be recycled the moment it drains.
+static volatile int32_t groupsDrained = 0;
 
-    while (1) {
+static void lLockTaskSys() {
+    int err;
+    if ((err = pthread_mutex_lock(&taskSysMutex)) != 0) {
+        fprintf(stderr, "Error from pthread_mutex_lock: %s\n", strerror(err));
+        exit(1);
+    }
+}
+
+static void lUnlockTaskSys() {
+    int err;
+    if ((err = pthread_mutex_unlock(&taskSysMutex)) != 0) {
+        fprintf(stderr, "Error from pthread_mutex_unlock: %s\n", strerror(err));
+        exit(1);
+    }
+}
+
+//
+// Wake up one sleeping worker, if there is one.  Launch() wakes a single
+// worker; each worker that claims tasks while more are still waiting
+// wakes the next one, so the wake-ups fan out only as far as there is
+// work to go around.
+//
+static void lWakeWorker() {
+    // Pairs with the fence in the worker's increment of
+    // numSleepingWorkers: either we see the sleeper here, or it sees our
+    // work when it re-checks activeTaskGroups.
+    lMemFence();
+    if (numSleepingWorkers > 0) {
         int err;
-        //
-        // Wait on the semaphore until we're woken up due to the arrival of
-        // more work.
-        //
-        if ((err = sem_wait(workerSemaphore)) != 0) {
-            fprintf(stderr, "Error from sem_wait: %s\n", strerror(err));
+        if ((err = sem_post(workerSemaphore)) != 0) {
+            fprintf(stderr, "Error from sem_post: %s\n", strerror(err));
             exit(1);
         }
+    }
+}
 
-        //
-        // Acquire the mutex
-        //
-        if ((err = pthread_mutex_lock(&taskSysMutex)) != 0) {
-            fprintf(stderr, "Error from pthread_mutex_lock: %s\n", strerror(err));
-            exit(1);
+// Claims a chunk of waiting tasks from this group, returning how many
+// were claimed (zero if none are left) and the first one in *first.
+inline int TaskGroup::ClaimTasks(int *first) {
+    while (1) {
+        int32_t next = nextTaskToRun;
+        int32_t launched = numLaunchedTasks;
+        if (next >= launched)
+            return 0;
+
+        // Take a slice of what's left that shrinks as the group drains,
+        // so that the last tasks still spread across the threads.
+        int32_t chunk = std::max(1, (launched - next) / (4 * (nThreads + 1)));
+        if (lAtomicCompareAndSwap32(&nextTaskToRun, next + chunk, next) == next) {
+            *first = next;
+            if (next + chunk < launched)
+                lWakeWorker();
+            return chunk;
         }
+    }
+}
+
+inline void TaskGroup::RunTasks(int first, int count, int threadIndex, int threadCount) {
+    for (int i = first; i < first + count; ++i) {
+        DBG(fprintf(stderr, "running task %d from group %p\n", i, this));
+        TaskInfo *myTask = GetTaskInfo(i);
+        myTask->func(myTask->data, threadIndex, threadCount, myTask->taskIndex, myTask->taskCount(),
+                     myTask->taskIndex0(), myTask->taskIndex1(), myTask->taskIndex2(), myTask->taskCount0(),
+                     myTask->taskCount1(), myTask->taskCount2());
+    }
+}
+
+inline void TaskGroup::FinishTasks(int count) {
+    //
+    // Decrement the "number of unfinished tasks" counter in the task
+    // group.  Once this drops to zero the group may be synced and
+    // recycled, so it mustn't be touched afterwards.
+    //
+    lMemFence();
+    if (lAtomicAdd(&numUnfinishedTasks, -count) == count) {
+        lAtomicAdd(&groupsDrained, 1);
+        lFutexWakeAll(&groupsDrained);
+    }
+}
+
+//
+// Claim a chunk of tasks from the most recently launched task group that
+// still has tasks waiting, dropping exhausted groups from the active list
+// along the way.  Returns nullptr if there is nothing to run.  Must be
+// called with taskSysMutex held, which keeps the groups on the list from
+// being recycled underneath us.
+//
+static TaskGroup *lClaimFromActiveGroups(int *first, int *count) {
+    while (activeTaskGroups.size() > 0) {
+        TaskGroup *tg = activeTaskGroups.back();
+        if ((*count = tg->ClaimTasks(first)) > 0)
+            return tg;
 
-        if (activeTaskGroups.size() == 0) {
+        // Nothing left to start running from this group, so remove it
+        // from the active list.
+        activeTaskGroups.pop_back();
+        tg->inActiveList = false;
+    }
+    return nullptr;
+}
+
+static void *lTaskEntry(void *arg) {
+    int threadIndex = (int)((int64_t)arg);
+    int threadCount = nThreads;
+
+    while (1) {
+        int first, count;
+        lLockTaskSys();
+        TaskGroup *tg = lClaimFromActiveGroups(&first, &count);
+        lUnlockTaskSys();
+
+        if (tg == nullptr) {
             //
-            // Task queue is empty, go back and wait on the semaphore
+            // No work; announce that we're going to sleep, then check once
+            // more before actually waiting on the semaphore so that we
+            // can't miss a launch that raced with us.
             //
-            if ((err = pthread_mutex_unlock(&taskSysMutex)) != 0) {
-                fprintf(stderr, "Error from pthread_mutex_unlock: %s\n", strerror(err));
+            lAtomicAdd(&numSleepingWorkers, 1);
+            lLockTaskSys();
+            bool idle = (activeTaskGroups.size() == 0);
+            lUnlockTaskSys();
+
+            int err;
+            if (idle && (err = sem_wait(workerSemaphore)) != 0) {
+                fprintf(stderr, "Error from sem_wait: %s\n", strerror(err));
                 exit(1);
             }
+            lAtomicAdd(&numSleepingWorkers, -1);
             continue;
         }
 
         //
-        // Get the last task group on the active list and the last task
-        // from its waiting tasks list.
+        // Keep claiming chunks from this group without going through the
+        // mutex.  The next chunk is claimed before the current one is
+        // marked finished, so the group can't be synced and recycled
+        // while we're still using it.
         //
-        TaskGroup *tg = activeTaskGroups.back();
-        assert(tg->waitingTasks.size() > 0);
-        int taskNumber = tg->waitingTasks.back();
-        tg->waitingTasks.pop_back();
-
-        if (tg->waitingTasks.size() == 0) {
-            // We just took the last task from this task group, so remove
-            // it from the active list.
-            activeTaskGroups.pop_back();
-            tg->inActiveList = false;
-        }
-
-        if ((err = pthread_mutex_unlock(&taskSysMutex)) != 0) {
-            fprintf(stderr, "Error from pthread_mutex_unlock: %s\n", strerror(err));
-            exit(1);
+        while (count > 0) {
+            tg->RunTasks(first, count, threadIndex, threadCount);
+
+            int nextFirst = 0;
+            int nextCount = tg->ClaimTasks(&nextFirst);
+            tg->FinishTasks(count);
+            first = nextFirst;
+            count = nextCount;
         }
-
-        //
-        // And now actually run the task
-        //
-        DBG(fprintf(stderr, "running task %d from group %p\n", taskNumber, tg));
-        TaskInfo *myTask = tg->GetTaskInfo(taskNumber);
-        myTask->func(myTask->data, threadIndex, threadCount, myTask->taskIndex, myTask->taskCount(),
-                     myTask->taskIndex0(), myTask->taskIndex1(), myTask->taskIndex2(), myTask->taskCount0(),
-                     myTask->taskCount1(), myTask->taskCount2());
-
-        //
-        // Decrement the "number of unfinished tasks" counter in the task
-        // group.
-        //
-        lMemFence();
-        lAtomicAdd(&tg->numUnfinishedTasks, -1);
     }
 
     pthread_exit(nullptr);
@@ -663,21 +980,27 @@ static void InitTaskSystem() {
                         exit(1);
                     }
 
-                    threads = (pthread_t *)malloc(nThreads * sizeof(pthread_t));
-                    if (threads == nullptr) {
+                    activeTaskGroups.reserve(64);
+
+                    // Only publish 'threads' once everything is set up,
+                    // since other threads skip initialization as soon as
+                    // they see it non-null.
+                    pthread_t *newThreads = (pthread_t *)malloc(nThreads * sizeof(pthread_t));
+                    if (newThreads == nullptr) {
                         fprintf(stderr, "Error creating pthreads: %s\n", strerror(err));
                         exit(1);
                     }
 
                     for (int i = 0; i < nThreads; ++i) {
-                        err = pthread_create(&threads[i], nullptr, &lTaskEntry, (void *)((long long)i));
+                        err = pthread_create(&newThreads[i], nullptr, &lTaskEntry, (void *)((long long)i));
                         if (err != 0) {
                             fprintf(stderr, "Error creating pthread %d: %s\n", i, strerror(err));
                             exit(1);
                         }
                     }
 
-                    activeTaskGroups.reserve(64);
+                    lMemFence();
+                    threads = newThreads;
                 }
 
                 // Make sure all of the above goes to memory before we
@@ -692,142 +1015,90 @@ static void InitTaskSystem() {
 
 inline void TaskGroup::Launch(int baseCoord, int count) {
     //
-    // Acquire mutex, add task
+    // Count the new tasks as unfinished before anyone can claim them.
     //
-    int err;
-    if ((err = pthread_mutex_lock(&taskSysMutex)) != 0) {
-        fprintf(stderr, "Error from pthread_mutex_lock: %s\n", strerror(err));
-        exit(1);
-    }
+    lMemFence();
+    lAtomicAdd(&numUnfinishedTasks, count);
 
-    // Add the corresponding set of tasks to the waiting-to-be-run list for
-    // this task group.
     //
-    // FIXME: it's a little ugly to hold a global mutex for this when we
-    // only need to make sure no one else is accessing this task group's
-    // waitingTasks list.  (But a small experiment in switching to a
-    // per-TaskGroup mutex showed worse performance!)
-    for (int i = 0; i < count; ++i)
-        waitingTasks.push_back(baseCoord + i);
-
-    // Add the task group to the global active list if it isn't there
-    // already.
+    // Publish the tasks by advancing numLaunchedTasks, and add the task
+    // group to the global active list if it isn't there already.  This
+    // has to happen under the mutex so that it can't race with a thread
+    // that has just found the group exhausted and is removing it from
+    // the list.
+    //
+    lLockTaskSys();
+    assert(baseCoord == numLaunchedTasks);
+    lMemFence();
+    numLaunchedTasks = baseCoord + count;
     if (inActiveList == false) {
         activeTaskGroups.push_back(this);
         inActiveList = true;
     }
-
-    if ((err = pthread_mutex_unlock(&taskSysMutex)) != 0) {
-        fprintf(stderr, "Error from pthread_mutex_unlock: %s\n", strerror(err));
-        exit(1);
-    }
+    lUnlockTaskSys();
 
     //
-    // Update the count of the number of tasks left to run in this task
-    // group.
+    // Wake up a single worker; it will wake more if there's enough work.
     //
-    lMemFence();
-    lAtomicAdd(&numUnfinishedTasks, count);
-
-    //
-    // Post to the worker semaphore to wake up worker threads that are
-    // sleeping waiting for tasks to show up
-    //
-    for (int i = 0; i < count; ++i)
-        if ((err = sem_post(workerSemaphore)) != 0) {
-            fprintf(stderr, "Error from sem_post: %s\n", strerror(err));
-            exit(1);
-        }
+    lWakeWorker();
 }
 
 inline void TaskGroup::Sync() {
-    DBG(fprintf(stderr, "syncing %p - %d unfinished\n", tg, numUnfinishedTasks));
+    DBG(fprintf(stderr, "syncing %p - %d unfinished\n", this, numUnfinishedTasks));
 
+    //
+    // This may be running inside a task, for a nested launch; helping
+    // with whatever is runnable, including tasks from the enclosing
+    // launch, is what keeps that from deadlocking when every thread is
+    // waiting in a sync.
+    //
     while (numUnfinishedTasks > 0) {
         // All of the tasks in this group aren't finished yet.  We'll try
         // to help out here since we don't have anything else to do...
 
-        DBG(fprintf(stderr, "while syncing %p - %d unfinished\n", tg, numUnfinishedTasks));
+        DBG(fprintf(stderr, "while syncing %p - %d unfinished\n", this, numUnfinishedTasks));
 
-        //
-        // Acquire the global task system mutex to grab a task to work on
-        //
-        int err;
-        if ((err = pthread_mutex_lock(&taskSysMutex)) != 0) {
-            fprintf(stderr, "Error from pthread_mutex_lock: %s\n", strerror(err));
-            exit(1);
-        }
-
-        TaskInfo *myTask = nullptr;
+        int first = 0;
+        int count = ClaimTasks(&first);
         TaskGroup *runtg = this;
-        if (waitingTasks.size() > 0) {
-            int taskNumber = waitingTasks.back();
-            waitingTasks.pop_back();
-
-            if (waitingTasks.size() == 0) {
-                // There's nothing left to start running from this group,
-                // so remove it from the active task list.
-                activeTaskGroups.erase(std::find(activeTaskGroups.begin(), activeTaskGroups.end(), this));
-                inActiveList = false;
-            }
-            myTask = GetTaskInfo(taskNumber);
-            DBG(fprintf(stderr, "running task %d from group %p in sync\n", taskNumber, tg));
-        } else {
+        if (count == 0) {
             // Other threads are already working on all of the tasks in
             // this group, so we can't help out by running one ourself.
             // We'll try to run one from another group to make ourselves
             // useful here.
-            if (activeTaskGroups.size() == 0) {
-                // No active task groups left--there's nothing for us to do.
-                if ((err = pthread_mutex_unlock(&taskSysMutex)) != 0) {
-                    fprintf(stderr, "Error from pthread_mutex_unlock: %s\n", strerror(err));
-                    exit(1);
-                }
-                // FIXME: We basically end up busy-waiting here, which is
-                // extra wasteful in a world with hyper-threading.  It would
-                // be much better to put this thread to sleep on a
-                // condition variable that was signaled when the last task
-                // in this group was finished.
-                usleep(1);
+            lLockTaskSys();
+            runtg = lClaimFromActiveGroups(&first, &count);
+            lUnlockTaskSys();
+
+            if (runtg == nullptr) {
+                // Everything that's left is already running on other
+                // threads, so sleep until some group finishes.  Reading
+                // groupsDrained before re-checking our own count means
+                // we can't miss our group's wake-up.
+                int32_t drained = groupsDrained;
+                lMemFence();
+                if (numUnfinishedTasks > 0)
+                    lFutexWait(&groupsDrained, drained);
                 continue;
             }
-
-            // Get a task to run from another task group.
-            runtg = activeTaskGroups.back();
-            assert(runtg->waitingTasks.size() > 0);
-
-            int taskNumber = runtg->waitingTasks.back();
-            runtg->waitingTasks.pop_back();
-            if (runtg->waitingTasks.size() == 0) {
-                // There's left to start running from this group, so remove
-                // it from the active task list.
-                activeTaskGroups.pop_back();
-                runtg->inActiveList = false;
-            }
-            myTask = runtg->GetTaskInfo(taskNumber);
-            DBG(fprintf(stderr, "running task %d from other group %p in sync\n", taskNumber, runtg));
-        }
-
-        if ((err = pthread_mutex_unlock(&taskSysMutex)) != 0) {
-            fprintf(stderr, "Error from pthread_mutex_unlock: %s\n", strerror(err));
-            exit(1);
         }
 
-        //
-        // Do work for _myTask_
-        //
         // FIXME: bogus values for thread index/thread count here as well..
-        myTask->func(myTask->data, 0, 1, myTask->taskIndex, myTask->taskCount(), myTask->taskIndex0(),
-                     myTask->taskIndex1(), myTask->taskIndex2(), myTask->taskCount0(), myTask->taskCount1(),
-                     myTask->taskCount2());
+        runtg->RunTasks(first, count, 0, 1);
+        runtg->FinishTasks(count);
+    }
 
-        //
-        // Decrement the number of unfinished tasks counter
-        //
-        lMemFence();
-        lAtomicAdd(&runtg->numUnfinishedTasks, -1);
+    //
+    // This group is about to be recycled; make sure no other thread can
+    // still find it on the active list.
+    //
+    lLockTaskSys();
+    if (inActiveList) {
+        activeTaskGroups.erase(std::find(activeTaskGroups.begin(), activeTaskGroups.end(), this));
+        inActiveList = false;
     }
-    DBG(fprintf(stderr, "sync for %p done!n", tg));
+    lUnlockTaskSys();
+    DBG(fprintf(stderr, "sync for %p done!n", this));
 }
 
 #endif // ISPC_USE_PTHREADS
@@ -939,13 +1210,117 @@ inline void TaskGroup::Sync() {
 }
 #endif
 ///////////////////////////////////////////////////////////////////////////
+// asst2 task system
+
+#ifdef ISPC_USE_ASST2
+
+static volatile int32_t lock = 0;
+
+static ITaskSystem *asst2TaskSystem = nullptr;
+
+static void InitTaskSystem() {
+    if (asst2TaskSystem != nullptr)
+        return;
+
+    while (1) {
+        if (lAtomicCompareAndSwap32(&lock, 1, 0) == 0) {
+            if (asst2TaskSystem == nullptr) {
+                ITaskSystem *ts = new TaskSystemParallelThreadPoolSleeping(sysconf(_SC_NPROCESSORS_ONLN));
+                // Publish the task system only once it is fully constructed.
+                lMemFence();
+                asst2TaskSystem = ts;
+            }
+            lMemFence();
+            lock = 0;
+            break;
+        }
+    }
+}
+
+// Set while this thread runs an ispc task.  A task that synced a launch
+// of its own would hold an asst2 worker while it waited, and once every
+// worker is waiting like that nothing is left to run the tasks they wait
+// for.  So launches made from inside a task are run right away on the
+// launching thread instead.
+static thread_local bool lInAsst2Task = false;
+
+void ISPCRunnable::runTask(int task_id, int num_total_tasks) {
+    TaskInfo *ti = tg->GetTaskInfo(baseIndex + task_id);
+
+    // The asst2 task system does not expose the task -> thread mapping
+    // so, like TBB, we pretend it's 1:1
+    int threadIndex = ti->taskIndex;
+    int threadCount = ti->taskCount();
+    bool wasInTask = lInAsst2Task;
+    lInAsst2Task = true;
+    ti->func(ti->data, threadIndex, threadCount, ti->taskIndex, ti->taskCount(), ti->taskIndex0(), ti->taskIndex1(),
+             ti->taskIndex2(), ti->taskCount0(), ti->taskCount1(), ti->taskCount2());
+    lInAsst2Task = wasInTask;
+    tg->TaskDone();
+}
+
+inline void TaskGroup::Launch(int baseIndex, int count) {
+    if (count <= 0)
+        return;
+
+    runnables.emplace_back(this, baseIndex);
+    ISPCRunnable *runnable = &runnables.back();
+    {
+        std::lock_guard<std::mutex> lock(lk_pending);
+        pending += count;
+    }
+
+    if (lInAsst2Task) {
+        for (int i = 0; i < count; ++i)
+            runnable->runTask(i, count);
+        return;
+    }
+
+    std::vector<TaskID> noDeps;
+    asst2TaskSystem->runAsyncWithDeps(runnable, count, noDeps);
+}
+
+inline void TaskGroup::TaskDone() {
+    std::lock_guard<std::mutex> lock(lk_pending);
+    if (--pending == 0)
+        cv_pending.notify_all();
+}
+
+inline void TaskGroup::Sync() {
+    std::unique_lock<std::mutex> lock(lk_pending);
+    cv_pending.wait(lock, [this] { return pending == 0; });
+}
+
+#endif // ISPC_USE_ASST2
+///////////////////////////////////////////////////////////////////////////
 
 #ifndef ISPC_USE_PTHREADS_FULLY_SUBSCRIBED
 
 #define MAX_FREE_TASK_GROUPS 64
 static TaskGroup *freeTaskGroups[MAX_FREE_TASK_GROUPS];
 
+/* A task group is always synced, and so freed, by the thread that
+   allocated it, so each thread keeps a few free groups of its own in
+   front of the shared freeTaskGroups[] list.  With nested launches a
+   thread has one group live per level of nesting.
+ */
+#define MAX_THREAD_FREE_TASK_GROUPS 8
+struct ThreadFreeTaskGroups {
+    TaskGroup *groups[MAX_THREAD_FREE_TASK_GROUPS];
+    int count;
+
+    ThreadFreeTaskGroups() : count(0) {}
+    ~ThreadFreeTaskGroups() {
+        for (int i = 0; i < count; ++i)
+            delete groups[i];
+    }
+};
+static thread_local ThreadFreeTaskGroups threadFreeTaskGroups;
+
 static inline TaskGroup *AllocTaskGroup() {
+    if (threadFreeTaskGroups.count > 0)
+        return threadFreeTaskGroups.groups[--threadFreeTaskGroups.count];
+
     for (int i = 0; i < MAX_FREE_TASK_GROUPS; ++i) {
         TaskGroup *tg = freeTaskGroups[i];
         if (tg != nullptr) {
@@ -962,6 +1337,11 @@ static inline TaskGroup *AllocTaskGroup() {
 static inline void FreeTaskGroup(TaskGroup *tg) {
     tg->Reset();
 
+    if (threadFreeTaskGroups.count < MAX_THREAD_FREE_TASK_GROUPS) {
+        threadFreeTaskGroups.groups[threadFreeTaskGroups.count++] = tg;
+        return;
+    }
+
     for (int i = 0; i < MAX_FREE_TASK_GROUPS; ++i) {
         if (freeTaskGroups[i] == nullptr) {
             void *ptr = lAtomicCompareAndSwapPointer((void **)&freeTaskGroups[i], tg, nullptr);
@@ -1024,16 +1404,27 @@ void *ISPCAlloc(void **taskGroupPtr, int64_t size, int32_t alignment) {
 
 pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 
+// Set in the worker threads.  A launch made from inside a task running on
+// a worker isn't put on the live task queue: the worker would have to
+// wait in sync() for every other worker to pass that queue entry, and
+// they may in turn be waiting on it.  Such launches are run entirely by
+// the thread that syncs them instead.
+static thread_local bool lIsWorkerThread = false;
+
 // Small structure used to hold the data for each task
 struct Task {
   public:
     TaskFuncType func;
     void *data;
+    char *dataBlock; // arena block that data lives in
+    int64_t dataBlockSize;
     volatile int32_t taskIndex;
     int taskCount;
+    int taskCount3d[3];
 
     volatile int numDone;
-    int liveIndex; // index in live task queue
+    int liveIndex; // index in live task queue, or -1 if run by the syncing thread alone
+    Task *prevInGroup; // earlier launch from the same ispc function, if any
 
     inline int noMoreWork() { return taskIndex >= taskCount; }
     /*! given thread is done working on this task --> decrease num locks */
@@ -1047,15 +1438,22 @@ struct Task {
         liveIndex = idx;
     }
     inline void run(int idx, int threadIdx);
-    inline void markOneDone() { lAtomicAdd(&numDone, 1); }
+    inline void markOneDone() {
+        // Whoever finishes the last job wakes the thread parked in wait().
+        if (__sync_add_and_fetch(&numDone, 1) == taskCount)
+            lFutexWakeAll(&numDone);
+    }
     inline void wait() {
+        // Help out with the jobs nobody has started yet...
         while (!noMoreWork()) {
             int next = nextJob();
             if (next < numJobs())
                 run(next, 0);
         }
-        while (numDone != taskCount) {
-            usleep(1);
+        // ...then sleep until the ones other threads took are done.
+        int done;
+        while ((done = numDone) != taskCount) {
+            lFutexWait(&numDone, done);
         }
     }
 };
@@ -1069,12 +1467,16 @@ class TaskSys {
                                   down by every thread that sees this. this
                                   value is only valid when 'active' is set
                                   to true */
-        volatile int active; /*! workers will spin on this until it
+        volatile int active; /*! workers will sleep on this until it
                                  becomes active */
         Task *task;
 
-        inline void doneWithThis() { lAtomicAdd(&locks, -1); }
-        LiveTask() : active(0), locks(-1) {}
+        inline void doneWithThis() {
+            // The last worker past this task wakes the thread in sync().
+            if (__sync_sub_and_fetch(&locks, 1) == 1)
+                lFutexWakeAll(&locks);
+        }
+        LiveTask() : locks(-1), active(0) {}
     };
 
   public:
@@ -1101,9 +1503,10 @@ class TaskSys {
     inline Task *allocOne() {
         pthread_mutex_lock(&mutex);
         if (taskMem.empty()) {
-            fprintf(stderr, "Too many live tasks.  "
-                            "Change the value of MAX_LIVE_TASKS and recompile.\n");
-            exit(1);
+            Task *mem = new Task[MAX_LIVE_TASKS];
+            for (int i = 0; i < MAX_LIVE_TASKS; i++) {
+                taskMem.push(mem + i);
+            }
         }
         Task *task = taskMem.top();
         taskMem.pop();
@@ -1124,44 +1527,56 @@ class TaskSys {
     int nThreads;
     pthread_t *thread;
 
-    void threadFct();
+    void threadFct(int threadIdx);
 
     inline void schedule(Task *t) {
+        if (lIsWorkerThread) {
+            t->schedule(-1);
+            return;
+        }
         pthread_mutex_lock(&mutex);
         int liveIndex = nextScheduleIndex;
-        nextScheduleIndex = (nextScheduleIndex + 1) % MAX_LIVE_TASKS;
         if (taskQueue[liveIndex].active) {
-            fprintf(stderr, "Out of task queue resources.  "
-                            "Change the value of MAX_LIVE_TASKS and recompile.\n");
-            exit(1);
+            // Every entry of the live task queue is in use; rather than
+            // wait, have the syncing thread run this launch itself.
+            pthread_mutex_unlock(&mutex);
+            t->schedule(-1);
+            return;
         }
+        nextScheduleIndex = (nextScheduleIndex + 1) % MAX_LIVE_TASKS;
         taskQueue[liveIndex].task = t;
         t->schedule(liveIndex);
         taskQueue[liveIndex].locks = numThreadsRunning + 1; // num _worker_ threads plus creator
+        lMemFence();
         taskQueue[liveIndex].active = true;
         pthread_mutex_unlock(&mutex);
+        lFutexWakeAll(&taskQueue[liveIndex].active);
     }
 
     void sync(Task *task) {
         task->wait();
         int liveIndex = task->liveIndex;
-        while (taskQueue[liveIndex].locks > 1) {
-            usleep(1);
+        if (liveIndex >= 0) {
+            int locks;
+            while ((locks = taskQueue[liveIndex].locks) > 1) {
+                lFutexWait(&taskQueue[liveIndex].locks, locks);
+            }
         }
-        _mm_free(task->data);
+        lArenaFree(task->dataBlock, task->dataBlockSize);
         pthread_mutex_lock(&mutex);
         taskMem.push(task); // recycle task index
-        taskQueue[liveIndex].active = false;
+        if (liveIndex >= 0)
+            taskQueue[liveIndex].active = false;
         pthread_mutex_unlock(&mutex);
     }
 };
 
-void TaskSys::threadFct() {
+void TaskSys::threadFct(int threadIdx) {
+    lIsWorkerThread = true;
     int myIndex = 0; // lAtomicAdd(&threadIdx,1);
     while (1) {
         while (!taskQueue[myIndex].active) {
-            usleep(4);
-            continue;
+            lFutexWait(&taskQueue[myIndex].active, 0);
         }
 
         Task *mine = taskQueue[myIndex].task;
@@ -1169,7 +1584,7 @@ void TaskSys::threadFct() {
             int job = mine->nextJob();
             if (job >= mine->numJobs())
                 break;
-            mine->run(job, myIndex);
+            mine->run(job, threadIdx);
         }
         taskQueue[myIndex].doneWithThis();
         myIndex = (myIndex + 1) % MAX_LIVE_TASKS;
@@ -1177,22 +1592,82 @@ void TaskSys::threadFct() {
 }
 
 inline void Task::run(int idx, int threadIdx) {
-    (*this->func)(data, threadIdx, TaskSys::global->nThreads, idx, taskCount);
+    // Thread 0 is the thread that syncs; the workers are 1..nThreads.
+    (*this->func)(data, threadIdx, TaskSys::global->nThreads + 1, idx, taskCount, idx % taskCount3d[0],
+                  (idx / taskCount3d[0]) % taskCount3d[1], idx / (taskCount3d[0] * taskCount3d[1]), taskCount3d[0],
+                  taskCount3d[1], taskCount3d[2]);
     markOneDone();
 }
 
+struct ThreadArgs {
+    TaskSys *taskSys;
+    int threadIdx;
+};
+
 void *_threadFct(void *data) {
-    ((TaskSys *)data)->threadFct();
+    ThreadArgs *args = (ThreadArgs *)data;
+    args->taskSys->threadFct(args->threadIdx);
+    delete args;
     return nullptr;
 }
 
+// Parse a CPU list such as "0-3,8,10-11" into cpus.  Returns false if
+// the list is malformed.
+static bool lParseCpuList(const char *list, std::vector<int> &cpus) {
+    const char *p = list;
+    while (*p) {
+        char *end;
+        long first = strtol(p, &end, 10);
+        if (end == p || first < 0)
+            return false;
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            ++p;
+            last = strtol(p, &end, 10);
+            if (end == p || last < first)
+                return false;
+            p = end;
+        }
+        for (long cpu = first; cpu <= last; ++cpu)
+            cpus.push_back((int)cpu);
+        if (*p == ',')
+            ++p;
+        else if (*p != '\0')
+            return false;
+    }
+    return cpus.size() > 0;
+}
+
 void TaskSys::createThreads() {
     init();
-    int reserved = 4;
-    int minid = 2;
-    nThreads = sysconf(_SC_NPROCESSORS_ONLN) - reserved;
+    int numCores = sysconf(_SC_NPROCESSORS_ONLN);
+
+    // By default leave one core for the thread that launches and syncs,
+    // since it runs tasks itself while it waits.
+    int reserved = 1;
+    const char *reservedEnv = getenv("ISPC_RESERVED_CORES");
+    if (reservedEnv != nullptr)
+        reserved = std::max(0, atoi(reservedEnv));
+    nThreads = std::max(0, numCores - reserved);
+
+    std::vector<int> pinCpus;
+    const char *pinEnv = getenv("ISPC_PIN_CPUS");
+    if (pinEnv == nullptr) {
+        for (int i = 0; i < nThreads; ++i)
+            pinCpus.push_back(reserved + i);
+    } else if (strcmp(pinEnv, "none") != 0 && !lParseCpuList(pinEnv, pinCpus)) {
+        fprintf(stderr, "Ignoring malformed ISPC_PIN_CPUS \"%s\"\n", pinEnv);
+        pinCpus.clear();
+    }
 
-    thread = (pthread_t *)malloc(nThreads * sizeof(pthread_t));
+    // Threads pinned to a CPU we may not run on would fail to start.
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        pinCpus.clear();
+
+    thread = (pthread_t *)malloc(std::max(1, nThreads) * sizeof(pthread_t));
 
     numThreadsRunning = 0;
     for (int i = 0; i < nThreads; ++i) {
@@ -1200,18 +1675,28 @@ void TaskSys::createThreads() {
         pthread_attr_init(&attr);
         pthread_attr_setstacksize(&attr, 2 * 1024 * 1024);
 
-        int threadID = minid + i;
-        cpu_set_t cpuset;
-        CPU_ZERO(&cpuset);
-        CPU_SET(threadID, &cpuset);
-        int ret = pthread_attr_setaffinity_np(&attr, sizeof(cpuset), &cpuset);
+        int threadID = pinCpus.size() > 0 ? pinCpus[i % pinCpus.size()] : -1;
+        if (threadID >= CPU_SETSIZE || (threadID >= 0 && !CPU_ISSET(threadID, &allowed))) {
+            fprintf(stderr, "Not pinning ispc worker %d: CPU %d is not available\n", i, threadID);
+        } else if (threadID >= 0) {
+            cpu_set_t cpuset;
+            CPU_ZERO(&cpuset);
+            CPU_SET(threadID, &cpuset);
+            int ret = pthread_attr_setaffinity_np(&attr, sizeof(cpuset), &cpuset);
+            if (ret != 0)
+                fprintf(stderr, "Can't pin ispc worker %d to CPU %d: %s\n", i, threadID, strerror(ret));
+        }
 
-        int err = pthread_create(&thread[i], &attr, &_threadFct, this);
-        ++numThreadsRunning;
+        ThreadArgs *args = new ThreadArgs;
+        args->taskSys = this;
+        args->threadIdx = i + 1;
+        int err = pthread_create(&thread[i], &attr, &_threadFct, args);
+        pthread_attr_destroy(&attr);
         if (err != 0) {
             fprintf(stderr, "Error creating pthread %d: %s\n", i, strerror(err));
             exit(1);
         }
+        ++numThreadsRunning;
     }
 }
 
@@ -1220,26 +1705,37 @@ int TaskSys::numThreadsRunning = 0;
 
 ///////////////////////////////////////////////////////////////////////////
 
-void ISPCLaunch(void **taskGroupPtr, void *func, void *data, int count) {
+void ISPCLaunch(void **taskGroupPtr, void *func, void *data, int count0, int count1, int count2) {
     Task *ti = *(Task **)taskGroupPtr;
     ti->func = (TaskFuncType)func;
     ti->data = data;
     ti->taskIndex = 0;
-    ti->taskCount = count;
+    ti->taskCount = count0 * count1 * count2;
+    ti->taskCount3d[0] = count0;
+    ti->taskCount3d[1] = count1;
+    ti->taskCount3d[2] = count2;
     TaskSys::global->schedule(ti);
 }
 
 void ISPCSync(void *h) {
     Task *task = (Task *)h;
     assert(task);
-    TaskSys::global->sync(task);
+    // Each launch from the function got its own Task from ISPCAlloc().
+    while (task != nullptr) {
+        Task *prev = task->prevInGroup;
+        TaskSys::global->sync(task);
+        task = prev;
+    }
 }
 
 void *ISPCAlloc(void **taskGroupPtr, int64_t size, int32_t alignment) {
     TaskSys::init();
     Task *task = TaskSys::global->allocOne();
+    task->prevInGroup = (Task *)*taskGroupPtr;
     *taskGroupPtr = task;
-    task->data = _mm_malloc(size, alignment);
+    task->dataBlock = lArenaAlloc(size + alignment, &task->dataBlockSize);
+    intptr_t iptr = ((intptr_t)task->dataBlock + (alignment - 1)) & ~(intptr_t)(alignment - 1);
+    task->data = (void *)iptr;
     return task->data; //*taskGroupPtr;
 }
 
@@ -1,8 +1,10 @@
 #include <stdio.h>
 #include <algorithm>
+#include <vector>
 #include <getopt.h>
 
 #include "CycleTimer.h"
+#include "mandelbrotDeepZoom.h"
 
 extern void mandelbrotSerial(
     float x0, float y0, float x1, float y1,
@@ -16,7 +18,16 @@ extern void mandelbrotThread(
     float x0, float y0, float x1, float y1,
     int width, int height,
     int maxIterations,
-    int output[]);
+    int output[],
+    double busySeconds[]);
+
+extern void mandelbrotThreadPool(
+    int numThreads,
+    float x0, float y0, float x1, float y1,
+    int width, int height,
+    int maxIterations,
+    int output[],
+    double busySeconds[]);
 
 extern void writePPMImage(
     int* data,
@@ -41,11 +52,88 @@ scaleAndShift(float& x0, float& x1, float& y0, float& y1,
 
 }
 
+// Print how long each thread spent computing, and how far the busiest
+// thread was above the average.
+void printBusyTimes(const char* label, const std::vector<double>& busySeconds) {
+    double total = 0, busiest = 0;
+    printf("[%s busy ms]:\t", label);
+    for (size_t i = 0; i < busySeconds.size(); i++) {
+        printf(" %.1f", busySeconds[i] * 1000);
+        total += busySeconds[i];
+        busiest = std::max(busiest, busySeconds[i]);
+    }
+    printf("\t(max/mean %.2f)\n", busiest * busySeconds.size() / total);
+}
+
+// Render a deep zoom into seahorse valley by perturbation, then iterate
+// every 8th row (every 32nd below 1e-9, where each pixel takes longer)
+// directly in long double and compare.  Long double resolves pixels
+// down to about 1e-16, so that covers every scale the view ships at.
+// Pixels right on the boundary are chaotic and differ by rounding
+// alone: under 1% of them at 1e-6 and 1e-8, about 5% at 1e-12 with
+// 4096 iterations.  Those are the pixels whose long double count
+// changes when they move by a fraction of a pixel, so only mismatches
+// elsewhere count against the deep zoom; there should be next to none.
+int runDeepZoom(int numThreads, double scale, int maxIterations) {
+    const int width = 1600;
+    const int height = 1200;
+    const int rowStep = scale < 1e-9 ? 32 : 8;
+    const long double centerX = -0.743643887037158704752191506114774L;
+    const long double centerY = 0.131825904205311970493132056385139L;
+
+    std::vector<int> output(width * height);
+    DeepZoomStats stats;
+
+    double startTime = CycleTimer::currentSeconds();
+    mandelbrotDeepZoom(numThreads, centerX, centerY, scale, width, height,
+                       maxIterations, output.data(), &stats);
+    double deepTime = CycleTimer::currentSeconds() - startTime;
+
+    printf("[mandelbrot deep zoom]:\t\t[%.3f] ms\t(scale %g, %d iterations, %d threads)\n",
+           deepTime * 1000, scale, maxIterations, numThreads);
+    printf("\t\t\t\treference orbit %d, series skipped %d, %.1f iterations/pixel, %lld rebases\n",
+           stats.referenceLength, stats.skippedIterations,
+           (double)stats.iterations / (width * height), stats.rebases);
+    writePPMImage(output.data(), width, height, "mandelbrot-deepzoom.ppm", maxIterations);
+
+    std::vector<int> gold(width * height);
+    startTime = CycleTimer::currentSeconds();
+    mandelbrotDeepZoomBruteForce(centerX, centerY, scale, width, height, rowStep,
+                                 maxIterations, gold.data());
+    double bruteTime = (CycleTimer::currentSeconds() - startTime) * rowStep;
+
+    int checked = 0, mismatches = 0, stableMismatches = 0;
+    for (int j = 0; j < height; j += rowStep) {
+        for (int i = 0; i < width; i++) {
+            checked++;
+            if (gold[j * width + i] != output[j * width + i]) {
+                mismatches++;
+                if (mandelbrotDeepZoomStable(centerX, centerY, scale, width, height,
+                                             i, j, maxIterations))
+                    stableMismatches++;
+            }
+        }
+    }
+
+    printf("[mandelbrot long double]:\t[%.3f] ms\t(%.2fx speedup from deep zoom, estimated from 1/%d of the rows)\n",
+           bruteTime * 1000, bruteTime / deepTime, rowStep);
+    printf("\t\t\t\t%d of %d checked pixels differ, %d of them not chaotic\n",
+           mismatches, checked, stableMismatches);
+
+    if (stableMismatches > checked / 1000) {
+        printf ("Error : Deep zoom output does not match long double output\n");
+        return 1;
+    }
+    return 0;
+}
+
 void usage(const char* progname) {
     printf("Usage: %s [options]\n", progname);
     printf("Program Options:\n");
     printf("  -t  --threads <N>  Use N threads\n");
     printf("  -v  --view <INT>   Use specified view settings\n");
+    printf("  -z  --zoom <SCALE> Render a deep zoom at SCALE (e.g. 1e-12) by perturbation\n");
+    printf("  -i  --iterations <N>  Iteration limit for --zoom (default 4096)\n");
     printf("  -?  --help         This message\n");
 }
 
@@ -72,6 +160,8 @@ int main(int argc, char** argv) {
     const unsigned int height = 1200;
     const int maxIterations = 256;
     int numThreads = 2;
+    double zoomScale = 0;
+    int zoomIterations = 4096;
 
     float x0 = -2;
     float x1 = 1;
@@ -83,16 +173,22 @@ int main(int argc, char** argv) {
     static struct option long_options[] = {
         {"threads", 1, 0, 't'},
         {"view", 1, 0, 'v'},
+        {"zoom", 1, 0, 'z'},
+        {"iterations", 1, 0, 'i'},
         {"help", 0, 0, '?'},
         {0 ,0, 0, 0}
     };
 
-    while ((opt = getopt_long(argc, argv, "t:v:?", long_options, NULL)) != EOF) {
+    while ((opt = getopt_long(argc, argv, "t:v:z:i:?", long_options, NULL)) != EOF) {
 
         switch (opt) {
         case 't':
         {
             numThreads = atoi(optarg);
+            if (numThreads < 1) {
+                fprintf(stderr, "Invalid thread count\n");
+                return 1;
+            }
             break;
         }
         case 'v':
@@ -110,6 +206,12 @@ int main(int argc, char** argv) {
             }
             break;
         }
+        case 'z':
+            zoomScale = atof(optarg);
+            break;
+        case 'i':
+            zoomIterations = atoi(optarg);
+            break;
         case '?':
         default:
             usage(argv[0]);
@@ -118,6 +220,8 @@ int main(int argc, char** argv) {
     }
     // end parsing of commandline options
 
+    if (zoomScale > 0)
+        return runDeepZoom(numThreads, zoomScale, zoomIterations);
 
     int* output_serial = new int[width*height];
     int* output_thread = new int[width*height];
@@ -143,20 +247,51 @@ int main(int argc, char** argv) {
     // Run the threaded version
     //
 
+    std::vector<double> busySeconds(numThreads);
     double minThread = 1e30;
+    if (numThreads <= 32) {
+        for (int i = 0; i < 5; ++i) {
+          memset(output_thread, 0, width * height * sizeof(int));
+            double startTime = CycleTimer::currentSeconds();
+            mandelbrotThread(numThreads, x0, y0, x1, y1, width, height, maxIterations, output_thread, busySeconds.data());
+            double endTime = CycleTimer::currentSeconds();
+            minThread = std::min(minThread, endTime - startTime);
+        }
+
+        printf("[mandelbrot thread]:\t\t[%.3f] ms\n", minThread * 1000);
+        printBusyTimes("mandelbrot thread", busySeconds);
+        writePPMImage(output_thread, width, height, "mandelbrot-thread.ppm", maxIterations);
+
+        if (! verifyResult (output_serial, output_thread, width, height)) {
+            printf ("Error : Output from threads does not match serial output\n");
+
+            delete[] output_serial;
+            delete[] output_thread;
+
+            return 1;
+        }
+    } else {
+        printf("[mandelbrot thread]:\t\tskipped, more than 32 threads\n");
+    }
+
+    //
+    // Run the thread pool version
+    //
+
+    double minPool = 1e30;
     for (int i = 0; i < 5; ++i) {
       memset(output_thread, 0, width * height * sizeof(int));
         double startTime = CycleTimer::currentSeconds();
-        mandelbrotThread(numThreads, x0, y0, x1, y1, width, height, maxIterations, output_thread);
+        mandelbrotThreadPool(numThreads, x0, y0, x1, y1, width, height, maxIterations, output_thread, busySeconds.data());
         double endTime = CycleTimer::currentSeconds();
-        minThread = std::min(minThread, endTime - startTime);
+        minPool = std::min(minPool, endTime - startTime);
     }
 
-    printf("[mandelbrot thread]:\t\t[%.3f] ms\n", minThread * 1000);
-    writePPMImage(output_thread, width, height, "mandelbrot-thread.ppm", maxIterations);
+    printf("[mandelbrot thread pool]:\t[%.3f] ms\n", minPool * 1000);
+    printBusyTimes("mandelbrot thread pool", busySeconds);
 
     if (! verifyResult (output_serial, output_thread, width, height)) {
-        printf ("Error : Output from threads does not match serial output\n");
+        printf ("Error : Output from thread pool does not match serial output\n");
 
         delete[] output_serial;
         delete[] output_thread;
@@ -165,7 +300,9 @@ int main(int argc, char** argv) {
     }
 
     // compute speedup
-    printf("\t\t\t\t(%.2fx speedup from %d threads)\n", minSerial/minThread, numThreads);
+    if (numThreads <= 32)
+        printf("\t\t\t\t(%.2fx speedup from %d threads)\n", minSerial/minThread, numThreads);
+    printf("\t\t\t\t(%.2fx speedup from %d pool threads)\n", minSerial/minPool, numThreads);
 
     delete[] output_serial;
     delete[] output_thread;
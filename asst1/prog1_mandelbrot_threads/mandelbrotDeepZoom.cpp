@@ -0,0 +1,480 @@
+#include <limits.h>
+#include <math.h>
+#include <immintrin.h>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "ThreadPool.h"
+#include "mandelbrotDeepZoom.h"
+
+//
+// Deep zoom rendering by perturbation.
+//
+// In float, mandelbrotSerial() runs out of precision at around a 1e-6
+// zoom: neighbouring pixels map to the same complex number.  Here a
+// single reference orbit Z_n is computed at the center of the view in
+// long double, and every pixel c = C + dc only tracks its difference
+// from it, d_n = z_n - Z_n, in double:
+//
+//     d_{n+1} = 2 Z_n d_n + d_n^2 + dc
+//
+// d_n stays small, so double keeps plenty of relative precision even
+// when dc is 1e-15.  The view center is limited by long double to
+// about a 1e-16 zoom.
+//
+// When a pixel's orbit passes closer to 0 than the reference does
+// (|z_n| < |d_n|), or runs past the end of the reference orbit, it is
+// rebased: d becomes z, and the pixel continues against the reference
+// from Z_0 = 0.  This avoids the "glitches" perturbation otherwise
+// produces where the pixel and reference orbits diverge.
+//
+// Series approximation: for the first iterations d_n is very nearly a
+// polynomial in dc,
+//
+//     d_n ~= A_n dc + B_n dc^2 + C_n dc^3
+//
+// with coefficients that only depend on the reference orbit.  As long
+// as this holds across the view, all pixels can jump straight to
+// iteration n instead of iterating there one at a time.  At deep zooms
+// this skips most of the work.
+//
+// The reference orbit is indexed with Z_0 = 0, Z_1 = C, so mandel()'s
+// iteration i corresponds to reference index i + 1.
+//
+// Neither trick makes an iteration cheaper than long double's, and at
+// shallow zooms the series skips only a few dozen iterations; rebasing
+// is needed for correctness and costs only a compare.  The speed comes
+// from double vectorizing where long double (x87) cannot: with AVX2,
+// pixels are iterated four to a vector, two vectors at a time.
+//
+
+struct ReferenceOrbit {
+    std::vector<double> re, im;
+    int skip;                   // reference index pixels start at
+    double a_re, a_im, b_re, b_im, c_re, c_im;   // series at 'skip'
+};
+
+static void computeReference(long double centerX, long double centerY,
+                             double halfWidth, double halfHeight,
+                             int maxIterations, ReferenceOrbit* ref)
+{
+    ref->re.clear();
+    ref->im.clear();
+
+    long double z_re = 0, z_im = 0;
+    for (int n = 0; n <= maxIterations + 1; n++) {
+        ref->re.push_back((double)z_re);
+        ref->im.push_back((double)z_im);
+        if (z_re * z_re + z_im * z_im > 4)
+            break;
+        long double new_re = z_re * z_re - z_im * z_im;
+        long double new_im = 2 * z_re * z_im;
+        z_re = centerX + new_re;
+        z_im = centerY + new_im;
+    }
+
+    // Advance the series as long as it agrees with plain perturbation
+    // to near double precision at probe points on the edge of the view,
+    // where truncation error is largest; anything looser shows up as
+    // wrong counts on chaotic pixels near the boundary.  Also stop once,
+    // going by a bound on |d| over the whole view, some pixel could
+    // have escaped or needed a rebase.
+    const int NUM_PROBES = 8;
+    double probe_dc_re[NUM_PROBES], probe_dc_im[NUM_PROBES];
+    double probe_re[NUM_PROBES], probe_im[NUM_PROBES];
+    for (int k = 0; k < NUM_PROBES; k++) {
+        int p = k < 4 ? k : k + 1;      // 3x3 grid minus the center
+        probe_dc_re[k] = probe_re[k] = (p % 3 - 1) * halfWidth;
+        probe_dc_im[k] = probe_im[k] = (p / 3 - 1) * halfHeight;
+    }
+
+    double a_re = 1, a_im = 0, b_re = 0, b_im = 0, c_re = 0, c_im = 0;
+    int n = 1;
+    int last = (int)ref->re.size() - 1;
+    double radius = sqrt(halfWidth * halfWidth + halfHeight * halfHeight);
+    while (n + 1 < last && n < maxIterations) {
+        double Z_re = ref->re[n], Z_im = ref->im[n];
+
+        double na_re = 2 * (Z_re * a_re - Z_im * a_im) + 1;
+        double na_im = 2 * (Z_re * a_im + Z_im * a_re);
+        double nb_re = 2 * (Z_re * b_re - Z_im * b_im) + (a_re * a_re - a_im * a_im);
+        double nb_im = 2 * (Z_re * b_im + Z_im * b_re) + 2 * a_re * a_im;
+        double nc_re = 2 * (Z_re * c_re - Z_im * c_im) + 2 * (a_re * b_re - a_im * b_im);
+        double nc_im = 2 * (Z_re * c_im + Z_im * c_re) + 2 * (a_re * b_im + a_im * b_re);
+
+        double next_re = ref->re[n + 1], next_im = ref->im[n + 1];
+        double Z = sqrt(next_re * next_re + next_im * next_im);
+        double bound = (sqrt(na_re * na_re + na_im * na_im)
+                        + (sqrt(nb_re * nb_re + nb_im * nb_im)
+                           + sqrt(nc_re * nc_re + nc_im * nc_im) * radius) * radius) * radius;
+        bool accurate = Z + bound <= 2 && Z >= 2 * bound;
+
+        for (int k = 0; k < NUM_PROBES && accurate; k++) {
+            double dc_re = probe_dc_re[k], dc_im = probe_dc_im[k];
+            double d_re = probe_re[k], d_im = probe_im[k];
+            double t_re = 2 * Z_re + d_re;
+            double t_im = 2 * Z_im + d_im;
+            d_re = t_re * probe_re[k] - t_im * probe_im[k] + dc_re;
+            d_im = t_re * probe_im[k] + t_im * probe_re[k] + dc_im;
+            probe_re[k] = d_re;
+            probe_im[k] = d_im;
+
+            double dc2_re = dc_re * dc_re - dc_im * dc_im;
+            double dc2_im = 2 * dc_re * dc_im;
+            double dc3_re = dc2_re * dc_re - dc2_im * dc_im;
+            double dc3_im = dc2_re * dc_im + dc2_im * dc_re;
+            double s_re = na_re * dc_re - na_im * dc_im
+                        + nb_re * dc2_re - nb_im * dc2_im
+                        + nc_re * dc3_re - nc_im * dc3_im;
+            double s_im = na_re * dc_im + na_im * dc_re
+                        + nb_re * dc2_im + nb_im * dc2_re
+                        + nc_re * dc3_im + nc_im * dc3_re;
+
+            double err = sqrt((s_re - d_re) * (s_re - d_re) + (s_im - d_im) * (s_im - d_im));
+            if (err > 1e-12 * sqrt(d_re * d_re + d_im * d_im))
+                accurate = false;
+        }
+        if (!accurate)
+            break;
+
+        a_re = na_re; a_im = na_im;
+        b_re = nb_re; b_im = nb_im;
+        c_re = nc_re; c_im = nc_im;
+        n++;
+    }
+
+    ref->skip = n;
+    ref->a_re = a_re; ref->a_im = a_im;
+    ref->b_re = b_re; ref->b_im = b_im;
+    ref->c_re = c_re; ref->c_im = c_im;
+}
+
+// d_skip for the pixel at dc, from the series
+static inline void seriesOffset(const ReferenceOrbit& ref, double dc_re, double dc_im,
+                                double* d_re, double* d_im)
+{
+    double dc2_re = dc_re * dc_re - dc_im * dc_im;
+    double dc2_im = 2 * dc_re * dc_im;
+    double dc3_re = dc2_re * dc_re - dc2_im * dc_im;
+    double dc3_im = dc2_re * dc_im + dc2_im * dc_re;
+    *d_re = ref.a_re * dc_re - ref.a_im * dc_im
+          + ref.b_re * dc2_re - ref.b_im * dc2_im
+          + ref.c_re * dc3_re - ref.c_im * dc3_im;
+    *d_im = ref.a_re * dc_im + ref.a_im * dc_re
+          + ref.b_re * dc2_im + ref.b_im * dc2_re
+          + ref.c_re * dc3_im + ref.c_im * dc3_re;
+}
+
+static inline int perturb(const ReferenceOrbit& ref, double dc_re, double dc_im,
+                          int maxIterations, long long* iterations, long long* rebases)
+{
+    const double* Z_re = ref.re.data();
+    const double* Z_im = ref.im.data();
+    int last = (int)ref.re.size() - 1;
+
+    double d_re, d_im;
+    seriesOffset(ref, dc_re, dc_im, &d_re, &d_im);
+
+    int m = ref.skip;
+    int i = ref.skip - 1;
+    for (; i < maxIterations; ++i) {
+        double z_re = Z_re[m] + d_re;
+        double z_im = Z_im[m] + d_im;
+        double mag = z_re * z_re + z_im * z_im;
+        if (mag > 4.)
+            break;
+
+        if (mag < d_re * d_re + d_im * d_im || m == last) {
+            d_re = z_re;
+            d_im = z_im;
+            m = 0;
+            (*rebases)++;
+        }
+
+        double t_re = 2 * Z_re[m] + d_re;
+        double t_im = 2 * Z_im[m] + d_im;
+        double new_re = t_re * d_re - t_im * d_im + dc_re;
+        double new_im = t_re * d_im + t_im * d_re + dc_im;
+        d_re = new_re;
+        d_im = new_im;
+        m++;
+    }
+
+    *iterations += i - (ref.skip - 1);
+    return i;
+}
+
+//
+// perturbRowsAvx2 --
+//
+// perturb() for four pixels at a time, one per lane of an AVX2 vector,
+// on rows claimed from nextRow until there are none left.  Each lane
+// runs its own pixel, with its own reference index, and as soon as a
+// pixel is done the lane picks up the next one, as the lane-refilling
+// kernels in prog3 do.  Every lane does exactly perturb()'s arithmetic
+// (there is no FMA here), so the output is the same.
+//
+// A scalar iteration is one long chain of dependent operations, so
+// perturb() mostly waits on latency; it is also barely cheaper than a
+// long double iteration.  Two vectors in flight keep eight independent
+// chains going.
+__attribute__((target("avx2")))
+static void perturbRowsAvx2(const ReferenceOrbit& ref, double dx, double dy,
+                            double halfWidth, double halfHeight,
+                            int width, int height, int maxIterations, int output[],
+                            std::atomic<int>* nextRow,
+                            long long* iterations, long long* rebases)
+{
+    const int VECTORS = 2;
+    const int LANES = 4 * VECTORS;
+    const double* Z_re = ref.re.data();
+    const double* Z_im = ref.im.data();
+    int last = (int)ref.re.size() - 1;
+
+    alignas(32) double dcRe[LANES], dcIm[LANES], dRe[LANES], dIm[LANES];
+    alignas(16) int mIdx[LANES], iter[LANES];
+    int pixel[LANES];
+
+    int row = (*nextRow)++, col = 0;
+    long long myIterations = 0, myRebases = 0;
+
+    // Loads the next pixel into 'lane', or idles the lane if there are
+    // no pixels left.  An idle lane sits at dc = d = 0 with a count that
+    // never reaches maxIterations, so it never finishes.
+    auto refill = [&](int lane) {
+        if (col == width && row < height) {
+            row = (*nextRow)++;
+            col = 0;
+        }
+        if (row < height) {
+            pixel[lane] = row * width + col;
+            dcRe[lane] = col * dx - halfWidth;
+            dcIm[lane] = row * dy - halfHeight;
+            seriesOffset(ref, dcRe[lane], dcIm[lane], &dRe[lane], &dIm[lane]);
+            mIdx[lane] = ref.skip;
+            iter[lane] = ref.skip - 1;
+            col++;
+        } else {
+            pixel[lane] = -1;
+            dcRe[lane] = dcIm[lane] = dRe[lane] = dIm[lane] = 0;
+            mIdx[lane] = 0;
+            iter[lane] = INT_MIN;
+        }
+    };
+
+    for (int lane = 0; lane < LANES; lane++)
+        refill(lane);
+
+    // (a lambda would not inherit the avx2 target, hence the macro)
+    __m256d dc_re[VECTORS], dc_im[VECTORS], d_re[VECTORS], d_im[VECTORS];
+    __m128i m[VECTORS], count[VECTORS];
+#define LOAD_LANES(v) do { \
+        dc_re[v] = _mm256_load_pd(dcRe + 4 * (v)); \
+        dc_im[v] = _mm256_load_pd(dcIm + 4 * (v)); \
+        d_re[v] = _mm256_load_pd(dRe + 4 * (v)); \
+        d_im[v] = _mm256_load_pd(dIm + 4 * (v)); \
+        m[v] = _mm_load_si128((const __m128i*)(mIdx + 4 * (v))); \
+        count[v] = _mm_load_si128((const __m128i*)(iter + 4 * (v))); \
+    } while (0)
+    for (int v = 0; v < VECTORS; v++)
+        LOAD_LANES(v);
+
+    const __m256d four = _mm256_set1_pd(4.);
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+    const __m128i maxIter = _mm_set1_epi32(maxIterations - 1);
+    const __m128i lastIdx = _mm_set1_epi32(last);
+    const __m128i one = _mm_set1_epi32(1);
+
+    int live = 0;
+    for (int lane = 0; lane < LANES; lane++)
+        live += pixel[lane] >= 0;
+
+    while (live > 0) {
+        for (int v = 0; v < VECTORS; v++) {
+            __m256d Zr = _mm256_mask_i32gather_pd(zero, Z_re, m[v], all, 8);
+            __m256d Zi = _mm256_mask_i32gather_pd(zero, Z_im, m[v], all, 8);
+            __m256d z_re = _mm256_add_pd(Zr, d_re[v]);
+            __m256d z_im = _mm256_add_pd(Zi, d_im[v]);
+            __m256d mag = _mm256_add_pd(_mm256_mul_pd(z_re, z_re), _mm256_mul_pd(z_im, z_im));
+
+            // done: escaped, or at the iteration limit
+            __m256d atLimit = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm_cmpgt_epi32(count[v], maxIter)));
+            __m256d done = _mm256_or_pd(_mm256_cmp_pd(mag, four, _CMP_GT_OQ), atLimit);
+            int doneMask = _mm256_movemask_pd(done);
+            if (doneMask != 0) {
+                _mm_store_si128((__m128i*)(iter + 4 * v), count[v]);
+                _mm256_store_pd(dRe + 4 * v, d_re[v]);
+                _mm256_store_pd(dIm + 4 * v, d_im[v]);
+                _mm_store_si128((__m128i*)(mIdx + 4 * v), m[v]);
+                for (int mask = doneMask; mask != 0; mask &= mask - 1) {
+                    int lane = 4 * v + __builtin_ctz(mask);
+                    output[pixel[lane]] = iter[lane];
+                    myIterations += iter[lane] - (ref.skip - 1);
+                    refill(lane);
+                    if (pixel[lane] < 0)
+                        live--;
+                }
+                LOAD_LANES(v);
+                continue;
+            }
+
+            // rebase where the pixel is closer to 0 than to the
+            // reference, or the reference has run out; Z_0 is 0
+            __m256d dmag = _mm256_add_pd(_mm256_mul_pd(d_re[v], d_re[v]), _mm256_mul_pd(d_im[v], d_im[v]));
+            __m256d atLast = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm_cmpeq_epi32(m[v], lastIdx)));
+            __m256d rebase = _mm256_or_pd(_mm256_cmp_pd(mag, dmag, _CMP_LT_OQ), atLast);
+            int rebaseMask = _mm256_movemask_pd(rebase);
+            __m256d dr = d_re[v], di = d_im[v];
+            if (rebaseMask != 0) {
+                myRebases += __builtin_popcount(rebaseMask);
+                dr = _mm256_blendv_pd(dr, z_re, rebase);
+                di = _mm256_blendv_pd(di, z_im, rebase);
+                Zr = _mm256_blendv_pd(Zr, zero, rebase);
+                Zi = _mm256_blendv_pd(Zi, zero, rebase);
+                __m128i rebase32 = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(
+                    _mm256_castpd_si256(rebase), _mm256_setr_epi32(0, 2, 4, 6, 0, 0, 0, 0)));
+                m[v] = _mm_andnot_si128(rebase32, m[v]);
+            }
+
+            __m256d t_re = _mm256_add_pd(_mm256_add_pd(Zr, Zr), dr);
+            __m256d t_im = _mm256_add_pd(_mm256_add_pd(Zi, Zi), di);
+            d_re[v] = _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(t_re, dr), _mm256_mul_pd(t_im, di)), dc_re[v]);
+            d_im[v] = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(t_re, di), _mm256_mul_pd(t_im, dr)), dc_im[v]);
+            m[v] = _mm_add_epi32(m[v], one);
+            count[v] = _mm_add_epi32(count[v], one);
+        }
+    }
+
+#undef LOAD_LANES
+
+    *iterations += myIterations;
+    *rebases += myRebases;
+}
+
+static bool avx2Supported() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+//
+// mandelbrotDeepZoom --
+//
+// Renders the view centered at (centerX, centerY) spanning
+// 3*scale x 2*scale, the same shape as the default view at scale 1.
+// Pixel (i, j) is at dc = (i * dx - 1.5 * scale, j * dy - scale) from
+// the center.  Rows are handed out dynamically to numThreads threads of
+// a persistent pool (see ThreadPool.h).
+void mandelbrotDeepZoom(
+    int numThreads,
+    long double centerX, long double centerY, double scale,
+    int width, int height,
+    int maxIterations,
+    int output[],
+    DeepZoomStats* stats)
+{
+    double dx = 3 * scale / width;
+    double dy = 2 * scale / height;
+
+    ReferenceOrbit ref;
+    computeReference(centerX, centerY, 1.5 * scale, scale, maxIterations, &ref);
+
+    std::atomic<int> nextRow(0);
+    std::atomic<long long> iterations(0), rebases(0);
+
+    static const bool useAvx2 = avx2Supported();
+
+    static ThreadPool pool;
+    pool.run(numThreads, [&](int, int) {
+        long long myIterations = 0, myRebases = 0;
+        if (useAvx2) {
+            perturbRowsAvx2(ref, dx, dy, 1.5 * scale, scale, width, height, maxIterations,
+                            output, &nextRow, &myIterations, &myRebases);
+            iterations += myIterations;
+            rebases += myRebases;
+            return;
+        }
+        for (int j = nextRow++; j < height; j = nextRow++) {
+            double dc_im = j * dy - scale;
+            for (int i = 0; i < width; ++i) {
+                double dc_re = i * dx - 1.5 * scale;
+                output[j * width + i] = perturb(ref, dc_re, dc_im, maxIterations,
+                                                &myIterations, &myRebases);
+            }
+        }
+        iterations += myIterations;
+        rebases += myRebases;
+    });
+
+    if (stats) {
+        stats->referenceLength = (int)ref.re.size();
+        stats->skippedIterations = ref.skip - 1;
+        stats->iterations = iterations;
+        stats->rebases = rebases;
+    }
+}
+
+static int mandelLongDouble(long double c_re, long double c_im, int maxIterations)
+{
+    long double z_re = c_re, z_im = c_im;
+    int n;
+    for (n = 0; n < maxIterations; ++n) {
+        if (z_re * z_re + z_im * z_im > 4)
+            break;
+        long double new_re = z_re * z_re - z_im * z_im;
+        long double new_im = 2 * z_re * z_im;
+        z_re = c_re + new_re;
+        z_im = c_im + new_im;
+    }
+    return n;
+}
+
+//
+// mandelbrotDeepZoomBruteForce --
+//
+// The same view iterated directly in long double, for checking
+// mandelbrotDeepZoom().  Only every rowStep-th row is computed, since
+// this is slow.
+void mandelbrotDeepZoomBruteForce(
+    long double centerX, long double centerY, double scale,
+    int width, int height,
+    int rowStep,
+    int maxIterations,
+    int output[])
+{
+    double dx = 3 * scale / width;
+    double dy = 2 * scale / height;
+
+    for (int j = 0; j < height; j += rowStep) {
+        long double c_im = centerY + (long double)(j * dy - scale);
+        for (int i = 0; i < width; ++i) {
+            long double c_re = centerX + (long double)(i * dx - 1.5 * scale);
+            output[j * width + i] = mandelLongDouble(c_re, c_im, maxIterations);
+        }
+    }
+}
+
+//
+// mandelbrotDeepZoomStable --
+//
+// Whether pixel (i, j)'s long double count stays put when the pixel is
+// moved by a thousandth of its width, in x or in y.  Where it does not,
+// the pixel's orbit is chaotic at this precision: any rounding, long
+// double's or perturbation's, can change its count, so a mismatch there
+// says nothing about mandelbrotDeepZoom().
+bool mandelbrotDeepZoomStable(
+    long double centerX, long double centerY, double scale,
+    int width, int height,
+    int i, int j,
+    int maxIterations)
+{
+    double dx = 3 * scale / width;
+    double dy = 2 * scale / height;
+    long double c_re = centerX + (long double)(i * dx - 1.5 * scale);
+    long double c_im = centerY + (long double)(j * dy - scale);
+
+    int n = mandelLongDouble(c_re, c_im, maxIterations);
+    return mandelLongDouble(c_re + 1e-3 * dx, c_im, maxIterations) == n
+        && mandelLongDouble(c_re, c_im + 1e-3 * dy, maxIterations) == n;
+}
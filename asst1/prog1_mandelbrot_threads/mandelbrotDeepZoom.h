@@ -0,0 +1,35 @@
+#ifndef _MANDELBROT_DEEP_ZOOM_H_
+#define _MANDELBROT_DEEP_ZOOM_H_
+
+// Deep zoom rendering by perturbation, and the long double checks for
+// it; see mandelbrotDeepZoom.cpp.
+
+struct DeepZoomStats {
+    int referenceLength;        // entries of the reference orbit
+    int skippedIterations;      // iterations every pixel skips via the series
+    long long iterations;       // per-pixel iterations actually run
+    long long rebases;
+};
+
+void mandelbrotDeepZoom(
+    int numThreads,
+    long double centerX, long double centerY, double scale,
+    int width, int height,
+    int maxIterations,
+    int output[],
+    DeepZoomStats* stats);
+
+void mandelbrotDeepZoomBruteForce(
+    long double centerX, long double centerY, double scale,
+    int width, int height,
+    int rowStep,
+    int maxIterations,
+    int output[]);
+
+bool mandelbrotDeepZoomStable(
+    long double centerX, long double centerY, double scale,
+    int width, int height,
+    int i, int j,
+    int maxIterations);
+
+#endif // _MANDELBROT_DEEP_ZOOM_H_
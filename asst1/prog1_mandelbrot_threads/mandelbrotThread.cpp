@@ -1,7 +1,10 @@
 #include <stdio.h>
+#include <algorithm>
+#include <atomic>
 #include <thread>
 
 #include "CycleTimer.h"
+#include "ThreadPool.h"
 
 typedef struct {
     float x0, x1;
@@ -12,6 +15,7 @@ typedef struct {
     int* output;
     int threadId;
     int numThreads;
+    double busySeconds;
 } WorkerArgs;
 
 
@@ -45,21 +49,24 @@ void workerThreadStart(WorkerArgs * const args) {
         (height - startRow) : (height / args->numThreads);
     int maxIterations = args->maxIterations;
     int *output = args->output;
+    double startTime = CycleTimer::currentSeconds();
     mandelbrotSerial(x0, y0, x1, y1, width, height, startRow, numRows, maxIterations, output);
-
-    printf("Hello world from thread %d\n", args->threadId);
+    args->busySeconds = CycleTimer::currentSeconds() - startTime;
 }
 
 //
 // MandelbrotThread --
 //
 // Multi-threaded implementation of mandelbrot set image generation.
-// Threads of execution are created by spawning std::threads.
+// Threads of execution are created by spawning std::threads.  If
+// busySeconds is non-NULL, it receives the time each thread spent
+// computing.
 void mandelbrotThread(
     int numThreads,
     float x0, float y0, float x1, float y1,
     int width, int height,
-    int maxIterations, int output[])
+    int maxIterations, int output[],
+    double busySeconds[])
 {
     static constexpr int MAX_THREADS = 32;
 
@@ -105,5 +112,43 @@ void mandelbrotThread(
     for (int i=1; i<numThreads; i++) {
         workers[i].join();
     }
+
+    if (busySeconds) {
+        for (int i=0; i<numThreads; i++)
+            busySeconds[i] = args[i].busySeconds;
+    }
+}
+
+//
+// mandelbrotThreadPool --
+//
+// Same as mandelbrotThread(), but rows are balanced dynamically across a
+// persistent pool of threads (see ThreadPool.h), and there's no limit on
+// numThreads.
+void mandelbrotThreadPool(
+    int numThreads,
+    float x0, float y0, float x1, float y1,
+    int width, int height,
+    int maxIterations, int output[],
+    double busySeconds[])
+{
+    static ThreadPool pool;
+
+    // Rows are handed out ROWS_PER_CLAIM at a time from an atomic
+    // counter, so threads that land on cheap rows just claim more of them.
+    const int ROWS_PER_CLAIM = 2;
+    std::atomic<int> nextRow(0);
+
+    pool.run(numThreads, [&](int threadId, int numThreads) {
+        double startTime = CycleTimer::currentSeconds();
+        int startRow;
+        while ((startRow = nextRow.fetch_add(ROWS_PER_CLAIM)) < height) {
+            int numRows = std::min(ROWS_PER_CLAIM, height - startRow);
+            mandelbrotSerial(x0, y0, x1, y1, width, height,
+                             startRow, numRows, maxIterations, output);
+        }
+        if (busySeconds)
+            busySeconds[threadId] = CycleTimer::currentSeconds() - startTime;
+    });
 }
 
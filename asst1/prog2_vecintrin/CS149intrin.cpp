@@ -5,255 +5,417 @@
 //* Implementation *
 //******************
 
-__cs149_mask _cs149_init_ones(int first) {
-  __cs149_mask mask;
-  for (int i=0; i<VECTOR_WIDTH; i++) {
+// The native backend defines everything but addUserLog() inline
+#ifndef CS149_NATIVE_SIMD
+
+template <int W>
+__cs149_mask_w<W> _cs149_init_ones(int first) {
+  __cs149_mask_w<W> mask;
+  for (int i=0; i<W; i++) {
     mask.value[i] = (i<first) ? true : false;
   }
   return mask;
 }
 
-__cs149_mask _cs149_mask_not(__cs149_mask &maska) {
-  __cs149_mask resultMask;
-  for (int i=0; i<VECTOR_WIDTH; i++) {
+template <int W>
+__cs149_mask_w<W> _cs149_mask_not(__cs149_mask_w<W> &maska) {
+  __cs149_mask_w<W> resultMask;
+  for (int i=0; i<W; i++) {
     resultMask.value[i] = !maska.value[i];
   }
-  CS149Logger.addLog("masknot", _cs149_init_ones(), VECTOR_WIDTH);
+  CS149Logger.addLog("masknot", _cs149_init_ones<W>(), W, 0, &maska);
   return resultMask;
 }
 
-__cs149_mask _cs149_mask_or(__cs149_mask &maska, __cs149_mask &maskb) {
-  __cs149_mask resultMask;
-  for (int i=0; i<VECTOR_WIDTH; i++) {
+template <int W>
+__cs149_mask_w<W> _cs149_mask_or(__cs149_mask_w<W> &maska, __cs149_mask_w<W> &maskb) {
+  __cs149_mask_w<W> resultMask;
+  for (int i=0; i<W; i++) {
     resultMask.value[i] = maska.value[i] | maskb.value[i];
   }
-  CS149Logger.addLog("maskor", _cs149_init_ones(), VECTOR_WIDTH);
+  CS149Logger.addLog("maskor", _cs149_init_ones<W>(), W, 0, &maska, &maskb);
   return resultMask;
 }
 
-__cs149_mask _cs149_mask_and(__cs149_mask &maska, __cs149_mask &maskb) {
-  __cs149_mask resultMask;
-  for (int i=0; i<VECTOR_WIDTH; i++) {
+template <int W>
+__cs149_mask_w<W> _cs149_mask_and(__cs149_mask_w<W> &maska, __cs149_mask_w<W> &maskb) {
+  __cs149_mask_w<W> resultMask;
+  for (int i=0; i<W; i++) {
     resultMask.value[i] = maska.value[i] && maskb.value[i];
   }
-  CS149Logger.addLog("maskand", _cs149_init_ones(), VECTOR_WIDTH);
+  CS149Logger.addLog("maskand", _cs149_init_ones<W>(), W, 0, &maska, &maskb);
   return resultMask;
 }
 
-int _cs149_cntbits(__cs149_mask &maska) {
+template <int W>
+int _cs149_cntbits(__cs149_mask_w<W> &maska) {
   int count = 0;
-  for (int i=0; i<VECTOR_WIDTH; i++) {
+  for (int i=0; i<W; i++) {
     if (maska.value[i]) count++;
   }
-  CS149Logger.addLog("cntbits", _cs149_init_ones(), VECTOR_WIDTH);
+  CS149Logger.addLog("cntbits", _cs149_init_ones<W>(), W, 0, &maska);
   return count;
 }
 
-template <typename T>
-void _cs149_vset(__cs149_vec<T> &vecResult, T value, __cs149_mask &mask) {
-  for (int i=0; i<VECTOR_WIDTH; i++) {
+template <typename T, int W>
+void _cs149_vset(__cs149_vec<T, W> &vecResult, T value, __cs149_mask_w<W> &mask) {
+  for (int i=0; i<W; i++) {
     vecResult.value[i] = mask.value[i] ? value : vecResult.value[i];
   }
-  CS149Logger.addLog("vset", mask, VECTOR_WIDTH);
+  CS149Logger.addLog("vset", mask, W, &vecResult, &mask);
 }
 
-template void _cs149_vset<float>(__cs149_vec_float &vecResult, float value, __cs149_mask &mask);
-template void _cs149_vset<int>(__cs149_vec_int &vecResult, int value, __cs149_mask &mask);
-
-void _cs149_vset_float(__cs149_vec_float &vecResult, float value, __cs149_mask &mask) { _cs149_vset<float>(vecResult, value, mask); }
-void _cs149_vset_int(__cs149_vec_int &vecResult, int value, __cs149_mask &mask) { _cs149_vset<int>(vecResult, value, mask); }
+template <int W>
+void _cs149_vset_float(__cs149_vec<float, W> &vecResult, float value, __cs149_mask_w<W> &mask) { _cs149_vset<float, W>(vecResult, value, mask); }
+template <int W>
+void _cs149_vset_int(__cs149_vec<int, W> &vecResult, int value, __cs149_mask_w<W> &mask) { _cs149_vset<int, W>(vecResult, value, mask); }
 
-__cs149_vec_float _cs149_vset_float(float value) {
-  __cs149_vec_float vecResult;
-  __cs149_mask mask = _cs149_init_ones();
+template <int W>
+__cs149_vec<float, W> _cs149_vset_float(float value) {
+  __cs149_vec<float, W> vecResult;
+  __cs149_mask_w<W> mask = _cs149_init_ones<W>();
   _cs149_vset_float(vecResult, value, mask);
   return vecResult;
 }
-__cs149_vec_int _cs149_vset_int(int value) {
-  __cs149_vec_int vecResult;
-  __cs149_mask mask = _cs149_init_ones();
+template <int W>
+__cs149_vec<int, W> _cs149_vset_int(int value) {
+  __cs149_vec<int, W> vecResult;
+  __cs149_mask_w<W> mask = _cs149_init_ones<W>();
   _cs149_vset_int(vecResult, value, mask);
   return vecResult;
 }
 
-template <typename T>
-void _cs149_vmove(__cs149_vec<T> &dest, __cs149_vec<T> &src, __cs149_mask &mask) {
-    for (int i = 0; i < VECTOR_WIDTH; i++) {
+template <typename T, int W>
+void _cs149_vmove(__cs149_vec<T, W> &dest, __cs149_vec<T, W> &src, __cs149_mask_w<W> &mask) {
+    for (int i = 0; i < W; i++) {
         dest.value[i] = mask.value[i] ? src.value[i] : dest.value[i];
     }
-    CS149Logger.addLog("vmove", mask, VECTOR_WIDTH);
+    CS149Logger.addLog("vmove", mask, W, &dest, &src, &mask);
 }
 
-template void _cs149_vmove<float>(__cs149_vec_float &dest, __cs149_vec_float &src, __cs149_mask &mask);
-template void _cs149_vmove<int>(__cs149_vec_int &dest, __cs149_vec_int &src, __cs149_mask &mask);
-
-void _cs149_vmove_float(__cs149_vec_float &dest, __cs149_vec_float &src, __cs149_mask &mask) { _cs149_vmove<float>(dest, src, mask); }
-void _cs149_vmove_int(__cs149_vec_int &dest, __cs149_vec_int &src, __cs149_mask &mask) { _cs149_vmove<int>(dest, src, mask); }
+template <int W>
+void _cs149_vmove_float(__cs149_vec<float, W> &dest, __cs149_vec<float, W> &src, __cs149_mask_w<W> &mask) { _cs149_vmove<float, W>(dest, src, mask); }
+template <int W>
+void _cs149_vmove_int(__cs149_vec<int, W> &dest, __cs149_vec<int, W> &src, __cs149_mask_w<W> &mask) { _cs149_vmove<int, W>(dest, src, mask); }
 
-template <typename T>
-void _cs149_vload(__cs149_vec<T> &dest, T* src, __cs149_mask &mask) {
-  for (int i=0; i<VECTOR_WIDTH; i++) {
+template <typename T, int W>
+void _cs149_vload(__cs149_vec<T, W> &dest, T* src, __cs149_mask_w<W> &mask) {
+  for (int i=0; i<W; i++) {
     dest.value[i] = mask.value[i] ? src[i] : dest.value[i];
   }
-  CS149Logger.addLog("vload", mask, VECTOR_WIDTH);
+  CS149Logger.addLog("vload", mask, W, &dest, src, &mask);
 }
 
-template void _cs149_vload<float>(__cs149_vec_float &dest, float* src, __cs149_mask &mask);
-template void _cs149_vload<int>(__cs149_vec_int &dest, int* src, __cs149_mask &mask);
+template <int W>
+void _cs149_vload_float(__cs149_vec<float, W> &dest, float* src, __cs149_mask_w<W> &mask) { _cs149_vload<float, W>(dest, src, mask); }
+template <int W>
+void _cs149_vload_int(__cs149_vec<int, W> &dest, int* src, __cs149_mask_w<W> &mask) { _cs149_vload<int, W>(dest, src, mask); }
 
-void _cs149_vload_float(__cs149_vec_float &dest, float* src, __cs149_mask &mask) { _cs149_vload<float>(dest, src, mask); }
-void _cs149_vload_int(__cs149_vec_int &dest, int* src, __cs149_mask &mask) { _cs149_vload<int>(dest, src, mask); }
-
-template <typename T>
-void _cs149_vstore(T* dest, __cs149_vec<T> &src, __cs149_mask &mask) {
-  for (int i=0; i<VECTOR_WIDTH; i++) {
+template <typename T, int W>
+void _cs149_vstore(T* dest, __cs149_vec<T, W> &src, __cs149_mask_w<W> &mask) {
+  for (int i=0; i<W; i++) {
     dest[i] = mask.value[i] ? src.value[i] : dest[i];
   }
-  CS149Logger.addLog("vstore", mask, VECTOR_WIDTH);
+  CS149Logger.addLog("vstore", mask, W, dest, &src, &mask);
 }
 
-template void _cs149_vstore<float>(float* dest, __cs149_vec_float &src, __cs149_mask &mask);
-template void _cs149_vstore<int>(int* dest, __cs149_vec_int &src, __cs149_mask &mask);
-
-void _cs149_vstore_float(float* dest, __cs149_vec_float &src, __cs149_mask &mask) { _cs149_vstore<float>(dest, src, mask); }
-void _cs149_vstore_int(int* dest, __cs149_vec_int &src, __cs149_mask &mask) { _cs149_vstore<int>(dest, src, mask); }
+template <int W>
+void _cs149_vstore_float(float* dest, __cs149_vec<float, W> &src, __cs149_mask_w<W> &mask) { _cs149_vstore<float, W>(dest, src, mask); }
+template <int W>
+void _cs149_vstore_int(int* dest, __cs149_vec<int, W> &src, __cs149_mask_w<W> &mask) { _cs149_vstore<int, W>(dest, src, mask); }
 
-template <typename T>
-void _cs149_vadd(__cs149_vec<T> &vecResult, __cs149_vec<T> &veca, __cs149_vec<T> &vecb, __cs149_mask &mask) {
-  for (int i=0; i<VECTOR_WIDTH; i++) {
+template <typename T, int W>
+void _cs149_vadd(__cs149_vec<T, W> &vecResult, __cs149_vec<T, W> &veca, __cs149_vec<T, W> &vecb, __cs149_mask_w<W> &mask) {
+  for (int i=0; i<W; i++) {
     vecResult.value[i] = mask.value[i] ? (veca.value[i] + vecb.value[i]) : vecResult.value[i];
   }
-  CS149Logger.addLog("vadd", mask, VECTOR_WIDTH);
+  CS149Logger.addLog("vadd", mask, W, &vecResult, &veca, &vecb, &mask);
 }
 
-template void _cs149_vadd<float>(__cs149_vec_float &vecResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask);
-template void _cs149_vadd<int>(__cs149_vec_int &vecResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask);
-
-void _cs149_vadd_float(__cs149_vec_float &vecResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask) { _cs149_vadd<float>(vecResult, veca, vecb, mask); }
-void _cs149_vadd_int(__cs149_vec_int &vecResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask) { _cs149_vadd<int>(vecResult, veca, vecb, mask); }
+template <int W>
+void _cs149_vadd_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask) { _cs149_vadd<float, W>(vecResult, veca, vecb, mask); }
+template <int W>
+void _cs149_vadd_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask) { _cs149_vadd<int, W>(vecResult, veca, vecb, mask); }
 
-template <typename T>
-void _cs149_vsub(__cs149_vec<T> &vecResult, __cs149_vec<T> &veca, __cs149_vec<T> &vecb, __cs149_mask &mask) {
-  for (int i=0; i<VECTOR_WIDTH; i++) {
+template <typename T, int W>
+void _cs149_vsub(__cs149_vec<T, W> &vecResult, __cs149_vec<T, W> &veca, __cs149_vec<T, W> &vecb, __cs149_mask_w<W> &mask) {
+  for (int i=0; i<W; i++) {
     vecResult.value[i] = mask.value[i] ? (veca.value[i] - vecb.value[i]) : vecResult.value[i];
   }
-  CS149Logger.addLog("vsub", mask, VECTOR_WIDTH);
+  CS149Logger.addLog("vsub", mask, W, &vecResult, &veca, &vecb, &mask);
 }
 
-template void _cs149_vsub<float>(__cs149_vec_float &vecResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask);
-template void _cs149_vsub<int>(__cs149_vec_int &vecResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask);
+template <int W>
+void _cs149_vsub_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask) { _cs149_vsub<float, W>(vecResult, veca, vecb, mask); }
+template <int W>
+void _cs149_vsub_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask) { _cs149_vsub<int, W>(vecResult, veca, vecb, mask); }
 
-void _cs149_vsub_float(__cs149_vec_float &vecResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask) { _cs149_vsub<float>(vecResult, veca, vecb, mask); }
-void _cs149_vsub_int(__cs149_vec_int &vecResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask) { _cs149_vsub<int>(vecResult, veca, vecb, mask); }
-
-template <typename T>
-void _cs149_vmult(__cs149_vec<T> &vecResult, __cs149_vec<T> &veca, __cs149_vec<T> &vecb, __cs149_mask &mask) {
-  for (int i=0; i<VECTOR_WIDTH; i++) {
+template <typename T, int W>
+void _cs149_vmult(__cs149_vec<T, W> &vecResult, __cs149_vec<T, W> &veca, __cs149_vec<T, W> &vecb, __cs149_mask_w<W> &mask) {
+  for (int i=0; i<W; i++) {
     vecResult.value[i] = mask.value[i] ? (veca.value[i] * vecb.value[i]) : vecResult.value[i];
   }
-  CS149Logger.addLog("vmult", mask, VECTOR_WIDTH);
+  CS149Logger.addLog("vmult", mask, W, &vecResult, &veca, &vecb, &mask);
 }
 
-template void _cs149_vmult<float>(__cs149_vec_float &vecResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask);
-template void _cs149_vmult<int>(__cs149_vec_int &vecResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask);
-
-void _cs149_vmult_float(__cs149_vec_float &vecResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask) { _cs149_vmult<float>(vecResult, veca, vecb, mask); }
-void _cs149_vmult_int(__cs149_vec_int &vecResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask) { _cs149_vmult<int>(vecResult, veca, vecb, mask); }
+template <int W>
+void _cs149_vmult_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask) { _cs149_vmult<float, W>(vecResult, veca, vecb, mask); }
+template <int W>
+void _cs149_vmult_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask) { _cs149_vmult<int, W>(vecResult, veca, vecb, mask); }
 
-template <typename T>
-void _cs149_vdiv(__cs149_vec<T> &vecResult, __cs149_vec<T> &veca, __cs149_vec<T> &vecb, __cs149_mask &mask) {
-  for (int i=0; i<VECTOR_WIDTH; i++) {
+template <typename T, int W>
+void _cs149_vdiv(__cs149_vec<T, W> &vecResult, __cs149_vec<T, W> &veca, __cs149_vec<T, W> &vecb, __cs149_mask_w<W> &mask) {
+  for (int i=0; i<W; i++) {
     vecResult.value[i] = mask.value[i] ? (veca.value[i] / vecb.value[i]) : vecResult.value[i];
   }
-  CS149Logger.addLog("vdiv", mask, VECTOR_WIDTH);
+  CS149Logger.addLog("vdiv", mask, W, &vecResult, &veca, &vecb, &mask);
 }
 
-template void _cs149_vdiv<float>(__cs149_vec_float &vecResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask);
-template void _cs149_vdiv<int>(__cs149_vec_int &vecResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask);
-
-void _cs149_vdiv_float(__cs149_vec_float &vecResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask) { _cs149_vdiv<float>(vecResult, veca, vecb, mask); }
-void _cs149_vdiv_int(__cs149_vec_int &vecResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask) { _cs149_vdiv<int>(vecResult, veca, vecb, mask); }
+template <int W>
+void _cs149_vdiv_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask) { _cs149_vdiv<float, W>(vecResult, veca, vecb, mask); }
+template <int W>
+void _cs149_vdiv_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask) { _cs149_vdiv<int, W>(vecResult, veca, vecb, mask); }
 
-template <typename T>
-void _cs149_vabs(__cs149_vec<T> &vecResult, __cs149_vec<T> &veca, __cs149_mask &mask) {
-  for (int i=0; i<VECTOR_WIDTH; i++) {
+template <typename T, int W>
+void _cs149_vabs(__cs149_vec<T, W> &vecResult, __cs149_vec<T, W> &veca, __cs149_mask_w<W> &mask) {
+  for (int i=0; i<W; i++) {
     vecResult.value[i] = mask.value[i] ? (abs(veca.value[i])) : vecResult.value[i];
   }
-  CS149Logger.addLog("vabs", mask, VECTOR_WIDTH);
+  CS149Logger.addLog("vabs", mask, W, &vecResult, &veca, &mask);
 }
 
-template void _cs149_vabs<float>(__cs149_vec_float &vecResult, __cs149_vec_float &veca, __cs149_mask &mask);
-template void _cs149_vabs<int>(__cs149_vec_int &vecResult, __cs149_vec_int &veca, __cs149_mask &mask);
+template <int W>
+void _cs149_vabs_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &veca, __cs149_mask_w<W> &mask) { _cs149_vabs<float, W>(vecResult, veca, mask); }
+template <int W>
+void _cs149_vabs_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &veca, __cs149_mask_w<W> &mask) { _cs149_vabs<int, W>(vecResult, veca, mask); }
 
-void _cs149_vabs_float(__cs149_vec_float &vecResult, __cs149_vec_float &veca, __cs149_mask &mask) { _cs149_vabs<float>(vecResult, veca, mask); }
-void _cs149_vabs_int(__cs149_vec_int &vecResult, __cs149_vec_int &veca, __cs149_mask &mask) { _cs149_vabs<int>(vecResult, veca, mask); }
-
-template <typename T>
-void _cs149_vgt(__cs149_mask &maskResult, __cs149_vec<T> &veca, __cs149_vec<T> &vecb, __cs149_mask &mask) {
-  for (int i=0; i<VECTOR_WIDTH; i++) {
+template <typename T, int W>
+void _cs149_vgt(__cs149_mask_w<W> &maskResult, __cs149_vec<T, W> &veca, __cs149_vec<T, W> &vecb, __cs149_mask_w<W> &mask) {
+  for (int i=0; i<W; i++) {
     maskResult.value[i] = mask.value[i] ? (veca.value[i] > vecb.value[i]) : maskResult.value[i];
   }
-  CS149Logger.addLog("vgt", mask, VECTOR_WIDTH);
+  CS149Logger.addLog("vgt", mask, W, &maskResult, &veca, &vecb, &mask);
 }
 
-template void _cs149_vgt<float>(__cs149_mask &maskResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask);
-template void _cs149_vgt<int>(__cs149_mask &maskResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask);
-
-void _cs149_vgt_float(__cs149_mask &maskResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask) { _cs149_vgt<float>(maskResult, veca, vecb, mask); }
-void _cs149_vgt_int(__cs149_mask &maskResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask) { _cs149_vgt<int>(maskResult, veca, vecb, mask); }
+template <int W>
+void _cs149_vgt_float(__cs149_mask_w<W> &maskResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask) { _cs149_vgt<float, W>(maskResult, veca, vecb, mask); }
+template <int W>
+void _cs149_vgt_int(__cs149_mask_w<W> &maskResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask) { _cs149_vgt<int, W>(maskResult, veca, vecb, mask); }
 
-template <typename T>
-void _cs149_vlt(__cs149_mask &maskResult, __cs149_vec<T> &veca, __cs149_vec<T> &vecb, __cs149_mask &mask) {
-  for (int i=0; i<VECTOR_WIDTH; i++) {
+template <typename T, int W>
+void _cs149_vlt(__cs149_mask_w<W> &maskResult, __cs149_vec<T, W> &veca, __cs149_vec<T, W> &vecb, __cs149_mask_w<W> &mask) {
+  for (int i=0; i<W; i++) {
     maskResult.value[i] = mask.value[i] ? (veca.value[i] < vecb.value[i]) : maskResult.value[i];
   }
-  CS149Logger.addLog("vlt", mask, VECTOR_WIDTH);
+  CS149Logger.addLog("vlt", mask, W, &maskResult, &veca, &vecb, &mask);
 }
 
-template void _cs149_vlt<float>(__cs149_mask &maskResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask);
-template void _cs149_vlt<int>(__cs149_mask &maskResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask);
+template <int W>
+void _cs149_vlt_float(__cs149_mask_w<W> &maskResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask) { _cs149_vlt<float, W>(maskResult, veca, vecb, mask); }
+template <int W>
+void _cs149_vlt_int(__cs149_mask_w<W> &maskResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask) { _cs149_vlt<int, W>(maskResult, veca, vecb, mask); }
 
-void _cs149_vlt_float(__cs149_mask &maskResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask) { _cs149_vlt<float>(maskResult, veca, vecb, mask); }
-void _cs149_vlt_int(__cs149_mask &maskResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask) { _cs149_vlt<int>(maskResult, veca, vecb, mask); }
-
-template <typename T>
-void _cs149_veq(__cs149_mask &maskResult, __cs149_vec<T> &veca, __cs149_vec<T> &vecb, __cs149_mask &mask) {
-  for (int i=0; i<VECTOR_WIDTH; i++) {
+template <typename T, int W>
+void _cs149_veq(__cs149_mask_w<W> &maskResult, __cs149_vec<T, W> &veca, __cs149_vec<T, W> &vecb, __cs149_mask_w<W> &mask) {
+  for (int i=0; i<W; i++) {
     maskResult.value[i] = mask.value[i] ? (veca.value[i] == vecb.value[i]) : maskResult.value[i];
   }
-  CS149Logger.addLog("veq", mask, VECTOR_WIDTH);
+  CS149Logger.addLog("veq", mask, W, &maskResult, &veca, &vecb, &mask);
+}
+
+template <int W>
+void _cs149_veq_float(__cs149_mask_w<W> &maskResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask) { _cs149_veq<float, W>(maskResult, veca, vecb, mask); }
+template <int W>
+void _cs149_veq_int(__cs149_mask_w<W> &maskResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask) { _cs149_veq<int, W>(maskResult, veca, vecb, mask); }
+
+template <typename T, int W>
+void _cs149_vgather(__cs149_vec<T, W> &dest, T* base, __cs149_vec<int, W> &index, __cs149_mask_w<W> &mask) {
+  for (int i=0; i<W; i++) {
+    dest.value[i] = mask.value[i] ? base[index.value[i]] : dest.value[i];
+  }
+  CS149Logger.addLog("vgather", mask, W, &dest, base, &index, &mask);
+}
+
+template <int W>
+void _cs149_vgather_float(__cs149_vec<float, W> &dest, float* base, __cs149_vec<int, W> &index, __cs149_mask_w<W> &mask) { _cs149_vgather<float, W>(dest, base, index, mask); }
+template <int W>
+void _cs149_vgather_int(__cs149_vec<int, W> &dest, int* base, __cs149_vec<int, W> &index, __cs149_mask_w<W> &mask) { _cs149_vgather<int, W>(dest, base, index, mask); }
+
+template <typename T, int W>
+void _cs149_vscatter(T* base, __cs149_vec<int, W> &index, __cs149_vec<T, W> &src, __cs149_mask_w<W> &mask) {
+  for (int i=0; i<W; i++) {
+    if (mask.value[i]) base[index.value[i]] = src.value[i];
+  }
+  CS149Logger.addLog("vscatter", mask, W, base, &index, &src, &mask);
+}
+
+template <int W>
+void _cs149_vscatter_float(float* base, __cs149_vec<int, W> &index, __cs149_vec<float, W> &src, __cs149_mask_w<W> &mask) { _cs149_vscatter<float, W>(base, index, src, mask); }
+template <int W>
+void _cs149_vscatter_int(int* base, __cs149_vec<int, W> &index, __cs149_vec<int, W> &src, __cs149_mask_w<W> &mask) { _cs149_vscatter<int, W>(base, index, src, mask); }
+
+template <typename T, int W>
+void _cs149_vpermute(__cs149_vec<T, W> &vecResult, __cs149_vec<T, W> &vec, __cs149_vec<int, W> &index, __cs149_mask_w<W> &mask) {
+  __cs149_vec<T, W> src = vec;
+  for (int i=0; i<W; i++) {
+    vecResult.value[i] = mask.value[i] ? src.value[index.value[i]] : vecResult.value[i];
+  }
+  CS149Logger.addLog("vpermute", mask, W, &vecResult, &vec, &index, &mask);
 }
 
-template void _cs149_veq<float>(__cs149_mask &maskResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask);
-template void _cs149_veq<int>(__cs149_mask &maskResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask);
+template <int W>
+void _cs149_vpermute_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &vec, __cs149_vec<int, W> &index, __cs149_mask_w<W> &mask) { _cs149_vpermute<float, W>(vecResult, vec, index, mask); }
+template <int W>
+void _cs149_vpermute_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &vec, __cs149_vec<int, W> &index, __cs149_mask_w<W> &mask) { _cs149_vpermute<int, W>(vecResult, vec, index, mask); }
 
-void _cs149_veq_float(__cs149_mask &maskResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask) { _cs149_veq<float>(maskResult, veca, vecb, mask); }
-void _cs149_veq_int(__cs149_mask &maskResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask) { _cs149_veq<int>(maskResult, veca, vecb, mask); }
+template <int W>
+void _cs149_vfma_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_vec<float, W> &vecc, __cs149_mask_w<W> &mask) {
+  for (int i=0; i<W; i++) {
+    vecResult.value[i] = mask.value[i] ? fmaf(veca.value[i], vecb.value[i], vecc.value[i]) : vecResult.value[i];
+  }
+  CS149Logger.addLog("vfma", mask, W, &vecResult, &veca, &vecb, &vecc, &mask);
+}
 
-template <typename T>
-void _cs149_hadd(__cs149_vec<T> &vecResult, __cs149_vec<T> &vec) {
-  for (int i=0; i<VECTOR_WIDTH/2; i++) {
+template <typename T, int W>
+void _cs149_vmin(__cs149_vec<T, W> &vecResult, __cs149_vec<T, W> &veca, __cs149_vec<T, W> &vecb, __cs149_mask_w<W> &mask) {
+  for (int i=0; i<W; i++) {
+    vecResult.value[i] = mask.value[i] ? (veca.value[i] < vecb.value[i] ? veca.value[i] : vecb.value[i]) : vecResult.value[i];
+  }
+  CS149Logger.addLog("vmin", mask, W, &vecResult, &veca, &vecb, &mask);
+}
+
+template <int W>
+void _cs149_vmin_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask) { _cs149_vmin<float, W>(vecResult, veca, vecb, mask); }
+template <int W>
+void _cs149_vmin_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask) { _cs149_vmin<int, W>(vecResult, veca, vecb, mask); }
+
+template <typename T, int W>
+void _cs149_vmax(__cs149_vec<T, W> &vecResult, __cs149_vec<T, W> &veca, __cs149_vec<T, W> &vecb, __cs149_mask_w<W> &mask) {
+  for (int i=0; i<W; i++) {
+    vecResult.value[i] = mask.value[i] ? (veca.value[i] > vecb.value[i] ? veca.value[i] : vecb.value[i]) : vecResult.value[i];
+  }
+  CS149Logger.addLog("vmax", mask, W, &vecResult, &veca, &vecb, &mask);
+}
+
+template <int W>
+void _cs149_vmax_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask) { _cs149_vmax<float, W>(vecResult, veca, vecb, mask); }
+template <int W>
+void _cs149_vmax_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask) { _cs149_vmax<int, W>(vecResult, veca, vecb, mask); }
+
+template <typename T, int W>
+void _cs149_vcompress(__cs149_vec<T, W> &vecResult, __cs149_vec<T, W> &vec, __cs149_mask_w<W> &mask) {
+  __cs149_vec<T, W> src = vec;
+  int j = 0;
+  for (int i=0; i<W; i++) {
+    if (mask.value[i]) vecResult.value[j++] = src.value[i];
+  }
+  CS149Logger.addLog("vcompress", mask, W, &vecResult, &vec, &mask);
+}
+
+template <int W>
+void _cs149_vcompress_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &vec, __cs149_mask_w<W> &mask) { _cs149_vcompress<float, W>(vecResult, vec, mask); }
+template <int W>
+void _cs149_vcompress_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &vec, __cs149_mask_w<W> &mask) { _cs149_vcompress<int, W>(vecResult, vec, mask); }
+
+template <typename T, int W>
+void _cs149_vexpand(__cs149_vec<T, W> &vecResult, __cs149_vec<T, W> &vec, __cs149_mask_w<W> &mask) {
+  __cs149_vec<T, W> src = vec;
+  int j = 0;
+  for (int i=0; i<W; i++) {
+    if (mask.value[i]) vecResult.value[i] = src.value[j++];
+  }
+  CS149Logger.addLog("vexpand", mask, W, &vecResult, &vec, &mask);
+}
+
+template <int W>
+void _cs149_vexpand_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &vec, __cs149_mask_w<W> &mask) { _cs149_vexpand<float, W>(vecResult, vec, mask); }
+template <int W>
+void _cs149_vexpand_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &vec, __cs149_mask_w<W> &mask) { _cs149_vexpand<int, W>(vecResult, vec, mask); }
+
+template <typename T, int W>
+void _cs149_hadd(__cs149_vec<T, W> &vecResult, __cs149_vec<T, W> &vec) {
+  for (int i=0; i<W/2; i++) {
     T result = vec.value[2*i] + vec.value[2*i+1];
     vecResult.value[2 * i] = result;
     vecResult.value[2 * i + 1] = result;
   }
 }
 
-template void _cs149_hadd<float>(__cs149_vec_float &vecResult, __cs149_vec_float &vec);
+template <int W>
+void _cs149_hadd_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &vec) { _cs149_hadd<float, W>(vecResult, vec); }
 
-void _cs149_hadd_float(__cs149_vec_float &vecResult, __cs149_vec_float &vec) { _cs149_hadd<float>(vecResult, vec); }
-
-template <typename T>
-void _cs149_interleave(__cs149_vec<T> &vecResult, __cs149_vec<T> &vec) {
-  for (int i=0; i<VECTOR_WIDTH; i++) {
-    int index = i < VECTOR_WIDTH/2 ? (2 * i) : (2 * (i - VECTOR_WIDTH/2) + 1);
+template <typename T, int W>
+void _cs149_interleave(__cs149_vec<T, W> &vecResult, __cs149_vec<T, W> &vec) {
+  for (int i=0; i<W; i++) {
+    int index = i < W/2 ? (2 * i) : (2 * (i - W/2) + 1);
     vecResult.value[i] = vec.value[index];
   }
 }
 
-template void _cs149_interleave<float>(__cs149_vec_float &vecResult, __cs149_vec_float &vec);
-
-void _cs149_interleave_float(__cs149_vec_float &vecResult, __cs149_vec_float &vec) { _cs149_interleave<float>(vecResult, vec); }
+template <int W>
+void _cs149_interleave_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &vec) { _cs149_interleave<float, W>(vecResult, vec); }
+
+// Instantiate everything above for vector width W
+#define CS149_INSTANTIATE(W) \
+  template __cs149_mask_w<W> _cs149_init_ones<W>(int first); \
+  template __cs149_mask_w<W> _cs149_mask_not<W>(__cs149_mask_w<W> &maska); \
+  template __cs149_mask_w<W> _cs149_mask_or<W>(__cs149_mask_w<W> &maska, __cs149_mask_w<W> &maskb); \
+  template __cs149_mask_w<W> _cs149_mask_and<W>(__cs149_mask_w<W> &maska, __cs149_mask_w<W> &maskb); \
+  template int _cs149_cntbits<W>(__cs149_mask_w<W> &maska); \
+  template void _cs149_vset_float<W>(__cs149_vec<float, W> &vecResult, float value, __cs149_mask_w<W> &mask); \
+  template void _cs149_vset_int<W>(__cs149_vec<int, W> &vecResult, int value, __cs149_mask_w<W> &mask); \
+  template __cs149_vec<float, W> _cs149_vset_float<W>(float value); \
+  template __cs149_vec<int, W> _cs149_vset_int<W>(int value); \
+  template void _cs149_vmove_float<W>(__cs149_vec<float, W> &dest, __cs149_vec<float, W> &src, __cs149_mask_w<W> &mask); \
+  template void _cs149_vmove_int<W>(__cs149_vec<int, W> &dest, __cs149_vec<int, W> &src, __cs149_mask_w<W> &mask); \
+  template void _cs149_vload_float<W>(__cs149_vec<float, W> &dest, float* src, __cs149_mask_w<W> &mask); \
+  template void _cs149_vload_int<W>(__cs149_vec<int, W> &dest, int* src, __cs149_mask_w<W> &mask); \
+  template void _cs149_vstore_float<W>(float* dest, __cs149_vec<float, W> &src, __cs149_mask_w<W> &mask); \
+  template void _cs149_vstore_int<W>(int* dest, __cs149_vec<int, W> &src, __cs149_mask_w<W> &mask); \
+  CS149_INSTANTIATE_BINARY(W, vadd) \
+  CS149_INSTANTIATE_BINARY(W, vsub) \
+  CS149_INSTANTIATE_BINARY(W, vmult) \
+  CS149_INSTANTIATE_BINARY(W, vdiv) \
+  template void _cs149_vabs_float<W>(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &veca, __cs149_mask_w<W> &mask); \
+  template void _cs149_vabs_int<W>(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &veca, __cs149_mask_w<W> &mask); \
+  CS149_INSTANTIATE_COMPARE(W, vgt) \
+  CS149_INSTANTIATE_COMPARE(W, vlt) \
+  CS149_INSTANTIATE_COMPARE(W, veq) \
+  CS149_INSTANTIATE_GATHER(W, float) \
+  CS149_INSTANTIATE_GATHER(W, int) \
+  template void _cs149_vfma_float<W>(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_vec<float, W> &vecc, __cs149_mask_w<W> &mask); \
+  CS149_INSTANTIATE_BINARY(W, vmin) \
+  CS149_INSTANTIATE_BINARY(W, vmax) \
+  template void _cs149_hadd_float<W>(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &vec); \
+  template void _cs149_interleave_float<W>(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &vec);
+
+#define CS149_INSTANTIATE_GATHER(W, T) \
+  template void _cs149_vgather_##T<W>(__cs149_vec<T, W> &dest, T* base, __cs149_vec<int, W> &index, __cs149_mask_w<W> &mask); \
+  template void _cs149_vscatter_##T<W>(T* base, __cs149_vec<int, W> &index, __cs149_vec<T, W> &src, __cs149_mask_w<W> &mask); \
+  template void _cs149_vpermute_##T<W>(__cs149_vec<T, W> &vecResult, __cs149_vec<T, W> &vec, __cs149_vec<int, W> &index, __cs149_mask_w<W> &mask); \
+  template void _cs149_vcompress_##T<W>(__cs149_vec<T, W> &vecResult, __cs149_vec<T, W> &vec, __cs149_mask_w<W> &mask); \
+  template void _cs149_vexpand_##T<W>(__cs149_vec<T, W> &vecResult, __cs149_vec<T, W> &vec, __cs149_mask_w<W> &mask);
+
+#define CS149_INSTANTIATE_BINARY(W, op) \
+  template void _cs149_##op##_float<W>(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask); \
+  template void _cs149_##op##_int<W>(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask);
+
+#define CS149_INSTANTIATE_COMPARE(W, op) \
+  template void _cs149_##op##_float<W>(__cs149_mask_w<W> &maskResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask); \
+  template void _cs149_##op##_int<W>(__cs149_mask_w<W> &maskResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask);
+
+CS149_INSTANTIATE(2)
+CS149_INSTANTIATE(4)
+CS149_INSTANTIATE(8)
+CS149_INSTANTIATE(16)
+CS149_INSTANTIATE(32)
+CS149_INSTANTIATE(64)
+#if VECTOR_WIDTH != 2 && VECTOR_WIDTH != 4 && VECTOR_WIDTH != 8 && \
+    VECTOR_WIDTH != 16 && VECTOR_WIDTH != 32 && VECTOR_WIDTH != 64
+CS149_INSTANTIATE(VECTOR_WIDTH)
+#endif
+
+#endif // CS149_NATIVE_SIMD
 
 void addUserLog(const char * logStr) {
   CS149Logger.addLog(logStr, _cs149_init_ones(), 0);
@@ -1,9 +1,17 @@
 // Define vector unit width here
+#ifndef VECTOR_WIDTH
 #define VECTOR_WIDTH 4
+#endif
 
 #ifndef CS149INTRIN_H_
 #define CS149INTRIN_H_
 
+// Building with CS149_NATIVE_SIMD swaps the emulated vector unit for
+// real SSE/AVX2/AVX-512 instructions; see CS149intrin_simd.h
+#ifdef CS149_NATIVE_SIMD
+#include "CS149intrin_simd.h"
+#else
+
 #include <cstdlib>
 #include <cmath>
 #include "logger.h"
@@ -14,13 +22,32 @@
 
 extern Logger CS149Logger;
 
-template <typename T>
+// Vector registers and masks take their width as a template parameter,
+// so one program can run the same kernel at several widths (see the
+// width sweep in main.cpp).  Code that leaves the width out gets
+// VECTOR_WIDTH.  The emulated unit is instantiated for the power of two
+// widths from 2 to 64 and for VECTOR_WIDTH itself.
+template <typename T, int W = VECTOR_WIDTH>
 struct __cs149_vec {
-  T value[VECTOR_WIDTH];
+  T value[W];
+};
+
+template <int W>
+struct __cs149_mask_w : __cs149_vec<bool, W> {
+  static_assert(W >= 1 && W <= MAX_LANES, "vector width must be between 1 and 64");
+
+  // Returns the mask with bit i set for active lane i
+  unsigned long long lanes() const {
+    unsigned long long bits = 0;
+    for (int i=0; i<W; i++) {
+      if (this->value[i]) bits |= ((unsigned long long)1)<<i;
+    }
+    return bits;
+  }
 };
 
 // Declare a mask with __cs149_mask
-struct __cs149_mask : __cs149_vec<bool> {};
+typedef __cs149_mask_w<VECTOR_WIDTH> __cs149_mask;
 
 // Declare a floating point vector register with __cs149_vec_float
 #define __cs149_vec_float __cs149_vec<float>
@@ -33,94 +60,182 @@ struct __cs149_mask : __cs149_vec<bool> {};
 //***********************
 
 // Return a mask initialized to 1 in the first N lanes and 0 in the others
-__cs149_mask _cs149_init_ones(int first = VECTOR_WIDTH);
+template <int W = VECTOR_WIDTH>
+__cs149_mask_w<W> _cs149_init_ones(int first = W);
 
 // Return the inverse of maska
-__cs149_mask _cs149_mask_not(__cs149_mask &maska);
+template <int W>
+__cs149_mask_w<W> _cs149_mask_not(__cs149_mask_w<W> &maska);
 
 // Return (maska | maskb)
-__cs149_mask _cs149_mask_or(__cs149_mask &maska, __cs149_mask &maskb);
+template <int W>
+__cs149_mask_w<W> _cs149_mask_or(__cs149_mask_w<W> &maska, __cs149_mask_w<W> &maskb);
 
 // Return (maska & maskb)
-__cs149_mask _cs149_mask_and(__cs149_mask &maska, __cs149_mask &maskb);
+template <int W>
+__cs149_mask_w<W> _cs149_mask_and(__cs149_mask_w<W> &maska, __cs149_mask_w<W> &maskb);
 
 // Count the number of 1s in maska
-int _cs149_cntbits(__cs149_mask &maska);
+template <int W>
+int _cs149_cntbits(__cs149_mask_w<W> &maska);
 
 // Set register to value if vector lane is active
 //  otherwise keep the old value
-void _cs149_vset_float(__cs149_vec_float &vecResult, float value, __cs149_mask &mask);
-void _cs149_vset_int(__cs149_vec_int &vecResult, int value, __cs149_mask &mask);
+template <int W>
+void _cs149_vset_float(__cs149_vec<float, W> &vecResult, float value, __cs149_mask_w<W> &mask);
+template <int W>
+void _cs149_vset_int(__cs149_vec<int, W> &vecResult, int value, __cs149_mask_w<W> &mask);
 // For user's convenience, returns a vector register with all lanes initialized to value
-__cs149_vec_float _cs149_vset_float(float value);
-__cs149_vec_int _cs149_vset_int(int value);
+template <int W = VECTOR_WIDTH>
+__cs149_vec<float, W> _cs149_vset_float(float value);
+template <int W = VECTOR_WIDTH>
+__cs149_vec<int, W> _cs149_vset_int(int value);
 
 // Copy values from vector register src to vector register dest if vector lane active
 // otherwise keep the old value
-void _cs149_vmove_float(__cs149_vec_float &dest, __cs149_vec_float &src, __cs149_mask &mask);
-void _cs149_vmove_int(__cs149_vec_int &dest, __cs149_vec_int &src, __cs149_mask &mask);
+template <int W>
+void _cs149_vmove_float(__cs149_vec<float, W> &dest, __cs149_vec<float, W> &src, __cs149_mask_w<W> &mask);
+template <int W>
+void _cs149_vmove_int(__cs149_vec<int, W> &dest, __cs149_vec<int, W> &src, __cs149_mask_w<W> &mask);
 
 // Load values from array src to vector register dest if vector lane active
 //  otherwise keep the old value
-void _cs149_vload_float(__cs149_vec_float &dest, float* src, __cs149_mask &mask);
-void _cs149_vload_int(__cs149_vec_int &dest, int* src, __cs149_mask &mask);
+template <int W>
+void _cs149_vload_float(__cs149_vec<float, W> &dest, float* src, __cs149_mask_w<W> &mask);
+template <int W>
+void _cs149_vload_int(__cs149_vec<int, W> &dest, int* src, __cs149_mask_w<W> &mask);
 
 // Store values from vector register src to array dest if vector lane active
 //  otherwise keep the old value
-void _cs149_vstore_float(float* dest, __cs149_vec_float &src, __cs149_mask &mask);
-void _cs149_vstore_int(int* dest, __cs149_vec_int &src, __cs149_mask &mask);
+template <int W>
+void _cs149_vstore_float(float* dest, __cs149_vec<float, W> &src, __cs149_mask_w<W> &mask);
+template <int W>
+void _cs149_vstore_int(int* dest, __cs149_vec<int, W> &src, __cs149_mask_w<W> &mask);
 
 // Return calculation of (veca + vecb) if vector lane active
 //  otherwise keep the old value
-void _cs149_vadd_float(__cs149_vec_float &vecResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask);
-void _cs149_vadd_int(__cs149_vec_int &vecResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask);
+template <int W>
+void _cs149_vadd_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask);
+template <int W>
+void _cs149_vadd_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask);
 
 // Return calculation of (veca - vecb) if vector lane active
 //  otherwise keep the old value
-void _cs149_vsub_float(__cs149_vec_float &vecResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask);
-void _cs149_vsub_int(__cs149_vec_int &vecResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask);
+template <int W>
+void _cs149_vsub_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask);
+template <int W>
+void _cs149_vsub_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask);
 
 // Return calculation of (veca * vecb) if vector lane active
 //  otherwise keep the old value
-void _cs149_vmult_float(__cs149_vec_float &vecResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask);
-void _cs149_vmult_int(__cs149_vec_int &vecResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask);
+template <int W>
+void _cs149_vmult_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask);
+template <int W>
+void _cs149_vmult_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask);
 
 // Return calculation of (veca / vecb) if vector lane active
 //  otherwise keep the old value
-void _cs149_vdiv_float(__cs149_vec_float &vecResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask);
-void _cs149_vdiv_int(__cs149_vec_int &vecResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask);
+template <int W>
+void _cs149_vdiv_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask);
+template <int W>
+void _cs149_vdiv_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask);
 
 
 // Return calculation of absolute value abs(veca) if vector lane active
 //  otherwise keep the old value
-void _cs149_vabs_float(__cs149_vec_float &vecResult, __cs149_vec_float &veca, __cs149_mask &mask);
-void _cs149_vabs_int(__cs149_vec_int &vecResult, __cs149_vec_int &veca, __cs149_mask &mask);
+template <int W>
+void _cs149_vabs_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &veca, __cs149_mask_w<W> &mask);
+template <int W>
+void _cs149_vabs_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &veca, __cs149_mask_w<W> &mask);
 
 // Return a mask of (veca > vecb) if vector lane active
 //  otherwise keep the old value
-void _cs149_vgt_float(__cs149_mask &vecResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask);
-void _cs149_vgt_int(__cs149_mask &vecResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask);
+template <int W>
+void _cs149_vgt_float(__cs149_mask_w<W> &vecResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask);
+template <int W>
+void _cs149_vgt_int(__cs149_mask_w<W> &vecResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask);
 
 // Return a mask of (veca < vecb) if vector lane active
 //  otherwise keep the old value
-void _cs149_vlt_float(__cs149_mask &vecResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask);
-void _cs149_vlt_int(__cs149_mask &vecResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask);
+template <int W>
+void _cs149_vlt_float(__cs149_mask_w<W> &vecResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask);
+template <int W>
+void _cs149_vlt_int(__cs149_mask_w<W> &vecResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask);
 
 // Return a mask of (veca == vecb) if vector lane active
 //  otherwise keep the old value
-void _cs149_veq_float(__cs149_mask &vecResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask);
-void _cs149_veq_int(__cs149_mask &vecResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask);
+template <int W>
+void _cs149_veq_float(__cs149_mask_w<W> &vecResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask);
+template <int W>
+void _cs149_veq_int(__cs149_mask_w<W> &vecResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask);
+
+// Load base[index[i]] into lane i of dest if vector lane active
+//  otherwise keep the old value
+template <int W>
+void _cs149_vgather_float(__cs149_vec<float, W> &dest, float* base, __cs149_vec<int, W> &index, __cs149_mask_w<W> &mask);
+template <int W>
+void _cs149_vgather_int(__cs149_vec<int, W> &dest, int* base, __cs149_vec<int, W> &index, __cs149_mask_w<W> &mask);
+
+// Store lane i of src to base[index[i]] if vector lane active; when
+//  active lanes share an index, the highest lane wins
+template <int W>
+void _cs149_vscatter_float(float* base, __cs149_vec<int, W> &index, __cs149_vec<float, W> &src, __cs149_mask_w<W> &mask);
+template <int W>
+void _cs149_vscatter_int(int* base, __cs149_vec<int, W> &index, __cs149_vec<int, W> &src, __cs149_mask_w<W> &mask);
+
+// Return lane index[i] of vec (0 <= index[i] < W) in lane i if vector lane active
+//  otherwise keep the old value
+template <int W>
+void _cs149_vpermute_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &vec, __cs149_vec<int, W> &index, __cs149_mask_w<W> &mask);
+template <int W>
+void _cs149_vpermute_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &vec, __cs149_vec<int, W> &index, __cs149_mask_w<W> &mask);
+
+// Return calculation of (veca * vecb + vecc), rounded once, if vector lane active
+//  otherwise keep the old value
+template <int W>
+void _cs149_vfma_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_vec<float, W> &vecc, __cs149_mask_w<W> &mask);
+
+// Return min(veca, vecb) / max(veca, vecb) if vector lane active
+//  otherwise keep the old value
+template <int W>
+void _cs149_vmin_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask);
+template <int W>
+void _cs149_vmin_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask);
+template <int W>
+void _cs149_vmax_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask);
+template <int W>
+void _cs149_vmax_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask);
+
+// Packs the active lanes of vec into the lowest lanes of vecResult, in
+//  order; the remaining lanes keep the old value, so
+//  vec [a b c d], mask [1 0 1 1] -> [a c d old]
+template <int W>
+void _cs149_vcompress_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &vec, __cs149_mask_w<W> &mask);
+template <int W>
+void _cs149_vcompress_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &vec, __cs149_mask_w<W> &mask);
+
+// The inverse: spreads the lowest lanes of vec, in order, over the
+//  active lanes of vecResult; inactive lanes keep the old value, so
+//  vec [a b c d], mask [1 0 1 1] -> [a old b c]
+template <int W>
+void _cs149_vexpand_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &vec, __cs149_mask_w<W> &mask);
+template <int W>
+void _cs149_vexpand_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &vec, __cs149_mask_w<W> &mask);
 
 // Adds up adjacent pairs of elements, so
 //  [0 1 2 3] -> [0+1 0+1 2+3 2+3]
-void _cs149_hadd_float(__cs149_vec_float &vecResult, __cs149_vec_float &vec);
+template <int W>
+void _cs149_hadd_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &vec);
 
 // Performs an even-odd interleaving where all even-indexed elements move to front half
 //  of the array and odd-indexed to the back half, so
 //  [0 1 2 3 4 5 6 7] -> [0 2 4 6 1 3 5 7]
-void _cs149_interleave_float(__cs149_vec_float &vecResult, __cs149_vec_float &vec);
+template <int W>
+void _cs149_interleave_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &vec);
 
 // Add a customized log to help debugging
 void addUserLog(const char * logStr);
 
+#endif // CS149_NATIVE_SIMD
+
 #endif
@@ -0,0 +1,601 @@
+// Native SIMD backend for the CS149 intrinsics.  Included by
+// CS149intrin.h when CS149_NATIVE_SIMD is defined (see 'make SIMD=...').
+//
+// Vector registers map onto SSE (VECTOR_WIDTH 4), AVX2 (8) or AVX-512
+// (16) registers and masks are bitmasks, one bit per lane.  Every
+// operation is inline and has the same semantics as the emulated
+// version in CS149intrin.cpp: inactive lanes keep their old value, and
+// masked loads and stores never touch memory for inactive lanes.
+//
+// The .value[] arrays stay accessible for code that reads lanes
+// directly.  Instructions are only logged when built with
+// CS149_LOGGING=1, since logging would dominate the run time.
+
+#ifndef CS149INTRIN_SIMD_H_
+#define CS149INTRIN_SIMD_H_
+
+#include <immintrin.h>
+#include <cmath>
+#include "logger.h"
+
+//*******************
+//* Type Definition *
+//*******************
+
+extern Logger CS149Logger;
+
+namespace cs149simd {
+
+// Lane-by-lane fallbacks for operations a width has no instruction for.
+// Only active lanes are touched, so inactive lanes may hold any index.
+template <typename R, typename T>
+union Lanes {
+  R reg;
+  T value[VECTOR_WIDTH];
+};
+
+template <typename R, typename I, typename T>
+inline R laneGather(R old, const T* base, I index, unsigned int bits) {
+  Lanes<R, T> r = {old};
+  Lanes<I, int> idx = {index};
+  for (int i = 0; i < VECTOR_WIDTH; i++)
+    if (bits & (1u << i)) r.value[i] = base[idx.value[i]];
+  return r.reg;
+}
+
+template <typename R, typename I, typename T>
+inline void laneScatter(T* base, I index, R src, unsigned int bits) {
+  Lanes<R, T> v = {src};
+  Lanes<I, int> idx = {index};
+  for (int i = 0; i < VECTOR_WIDTH; i++)
+    if (bits & (1u << i)) base[idx.value[i]] = v.value[i];
+}
+
+template <typename T, typename R, typename I>
+inline R lanePermute(R old, R vec, I index, unsigned int bits) {
+  Lanes<R, T> r = {old}, v = {vec};
+  Lanes<I, int> idx = {index};
+  for (int i = 0; i < VECTOR_WIDTH; i++)
+    if (bits & (1u << i)) r.value[i] = v.value[idx.value[i]];
+  return r.reg;
+}
+
+template <typename T, typename R>
+inline R laneCompress(R old, R vec, unsigned int bits) {
+  Lanes<R, T> r = {old}, v = {vec};
+  int j = 0;
+  for (int i = 0; i < VECTOR_WIDTH; i++)
+    if (bits & (1u << i)) r.value[j++] = v.value[i];
+  return r.reg;
+}
+
+template <typename T, typename R>
+inline R laneExpand(R old, R vec, unsigned int bits) {
+  Lanes<R, T> r = {old}, v = {vec};
+  int j = 0;
+  for (int i = 0; i < VECTOR_WIDTH; i++)
+    if (bits & (1u << i)) r.value[i] = v.value[j++];
+  return r.reg;
+}
+
+template <typename R>
+inline R laneFma(R a, R b, R c) {
+  Lanes<R, float> va = {a}, vb = {b}, vc = {c};
+  for (int i = 0; i < VECTOR_WIDTH; i++)
+    va.value[i] = fmaf(va.value[i], vb.value[i], vc.value[i]);
+  return va.reg;
+}
+
+#if VECTOR_WIDTH == 4
+
+#if !defined(__SSE4_1__)
+#error "VECTOR_WIDTH 4 needs SSE4.1 (compile with -msse4.1)"
+#endif
+
+typedef __m128 freg;
+typedef __m128i ireg;
+const unsigned int ALL = 0xf;
+
+inline ireg lanes(unsigned int bits) {
+  const __m128i bit = _mm_setr_epi32(1, 2, 4, 8);
+  return _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(bits), bit), bit);
+}
+
+inline freg set1(float value) { return _mm_set1_ps(value); }
+inline ireg set1(int value) { return _mm_set1_epi32(value); }
+inline freg blend(freg old, freg src, unsigned int bits) { return _mm_blendv_ps(old, src, _mm_castsi128_ps(lanes(bits))); }
+inline ireg blend(ireg old, ireg src, unsigned int bits) { return _mm_blendv_epi8(old, src, lanes(bits)); }
+
+inline freg add(freg a, freg b) { return _mm_add_ps(a, b); }
+inline ireg add(ireg a, ireg b) { return _mm_add_epi32(a, b); }
+inline freg sub(freg a, freg b) { return _mm_sub_ps(a, b); }
+inline ireg sub(ireg a, ireg b) { return _mm_sub_epi32(a, b); }
+inline freg mul(freg a, freg b) { return _mm_mul_ps(a, b); }
+inline ireg mul(ireg a, ireg b) { return _mm_mullo_epi32(a, b); }
+inline freg div(freg a, freg b) { return _mm_div_ps(a, b); }
+inline freg abs(freg a) { return _mm_andnot_ps(_mm_set1_ps(-0.f), a); }
+inline ireg abs(ireg a) { return _mm_abs_epi32(a); }
+
+inline unsigned int gt(freg a, freg b) { return _mm_movemask_ps(_mm_cmpgt_ps(a, b)); }
+inline unsigned int gt(ireg a, ireg b) { return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(a, b))); }
+inline unsigned int lt(freg a, freg b) { return _mm_movemask_ps(_mm_cmplt_ps(a, b)); }
+inline unsigned int lt(ireg a, ireg b) { return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(a, b))); }
+inline unsigned int eq(freg a, freg b) { return _mm_movemask_ps(_mm_cmpeq_ps(a, b)); }
+inline unsigned int eq(ireg a, ireg b) { return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(a, b))); }
+
+// SSE has no masked loads and stores; partial masks go lane by lane
+inline freg load(freg old, const float* src, unsigned int bits) {
+  if (bits == ALL)
+    return _mm_loadu_ps(src);
+  alignas(16) float tmp[4];
+  _mm_store_ps(tmp, old);
+  for (int i = 0; i < 4; i++)
+    if (bits & (1u << i)) tmp[i] = src[i];
+  return _mm_load_ps(tmp);
+}
+inline ireg load(ireg old, const int* src, unsigned int bits) {
+  if (bits == ALL)
+    return _mm_loadu_si128((const __m128i*)src);
+  alignas(16) int tmp[4];
+  _mm_store_si128((__m128i*)tmp, old);
+  for (int i = 0; i < 4; i++)
+    if (bits & (1u << i)) tmp[i] = src[i];
+  return _mm_load_si128((const __m128i*)tmp);
+}
+inline void store(float* dest, freg src, unsigned int bits) {
+  if (bits == ALL) {
+    _mm_storeu_ps(dest, src);
+    return;
+  }
+  alignas(16) float tmp[4];
+  _mm_store_ps(tmp, src);
+  for (int i = 0; i < 4; i++)
+    if (bits & (1u << i)) dest[i] = tmp[i];
+}
+inline void store(int* dest, ireg src, unsigned int bits) {
+  if (bits == ALL) {
+    _mm_storeu_si128((__m128i*)dest, src);
+    return;
+  }
+  alignas(16) int tmp[4];
+  _mm_store_si128((__m128i*)tmp, src);
+  for (int i = 0; i < 4; i++)
+    if (bits & (1u << i)) dest[i] = tmp[i];
+}
+
+inline freg swapPairs(freg a) { return _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)); }
+inline freg evensThenOdds(freg a) { return _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 1, 2, 0)); }
+
+inline freg min(freg a, freg b) { return _mm_min_ps(a, b); }
+inline ireg min(ireg a, ireg b) { return _mm_min_epi32(a, b); }
+inline freg max(freg a, freg b) { return _mm_max_ps(a, b); }
+inline ireg max(ireg a, ireg b) { return _mm_max_epi32(a, b); }
+#ifdef __FMA__
+inline freg fma(freg a, freg b, freg c) { return _mm_fmadd_ps(a, b, c); }
+#else
+inline freg fma(freg a, freg b, freg c) { return laneFma(a, b, c); }
+#endif
+
+// SSE has no gather, scatter, variable permute, compress or expand
+inline freg gather(freg old, const float* base, ireg index, unsigned int bits) { return laneGather(old, base, index, bits); }
+inline ireg gather(ireg old, const int* base, ireg index, unsigned int bits) { return laneGather(old, base, index, bits); }
+inline void scatter(float* base, ireg index, freg src, unsigned int bits) { laneScatter(base, index, src, bits); }
+inline void scatter(int* base, ireg index, ireg src, unsigned int bits) { laneScatter(base, index, src, bits); }
+inline freg permute(freg old, freg vec, ireg index, unsigned int bits) { return lanePermute<float>(old, vec, index, bits); }
+inline ireg permute(ireg old, ireg vec, ireg index, unsigned int bits) { return lanePermute<int>(old, vec, index, bits); }
+inline freg compress(freg old, freg vec, unsigned int bits) { return laneCompress<float>(old, vec, bits); }
+inline ireg compress(ireg old, ireg vec, unsigned int bits) { return laneCompress<int>(old, vec, bits); }
+inline freg expand(freg old, freg vec, unsigned int bits) { return laneExpand<float>(old, vec, bits); }
+inline ireg expand(ireg old, ireg vec, unsigned int bits) { return laneExpand<int>(old, vec, bits); }
+
+#elif VECTOR_WIDTH == 8
+
+#if !defined(__AVX2__)
+#error "VECTOR_WIDTH 8 needs AVX2 (compile with -mavx2)"
+#endif
+
+typedef __m256 freg;
+typedef __m256i ireg;
+const unsigned int ALL = 0xff;
+
+inline ireg lanes(unsigned int bits) {
+  const __m256i bit = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+  return _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(bits), bit), bit);
+}
+
+inline freg set1(float value) { return _mm256_set1_ps(value); }
+inline ireg set1(int value) { return _mm256_set1_epi32(value); }
+inline freg blend(freg old, freg src, unsigned int bits) { return _mm256_blendv_ps(old, src, _mm256_castsi256_ps(lanes(bits))); }
+inline ireg blend(ireg old, ireg src, unsigned int bits) { return _mm256_blendv_epi8(old, src, lanes(bits)); }
+
+inline freg add(freg a, freg b) { return _mm256_add_ps(a, b); }
+inline ireg add(ireg a, ireg b) { return _mm256_add_epi32(a, b); }
+inline freg sub(freg a, freg b) { return _mm256_sub_ps(a, b); }
+inline ireg sub(ireg a, ireg b) { return _mm256_sub_epi32(a, b); }
+inline freg mul(freg a, freg b) { return _mm256_mul_ps(a, b); }
+inline ireg mul(ireg a, ireg b) { return _mm256_mullo_epi32(a, b); }
+inline freg div(freg a, freg b) { return _mm256_div_ps(a, b); }
+inline freg abs(freg a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), a); }
+inline ireg abs(ireg a) { return _mm256_abs_epi32(a); }
+
+inline unsigned int gt(freg a, freg b) { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GT_OQ)); }
+inline unsigned int gt(ireg a, ireg b) { return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(a, b))); }
+inline unsigned int lt(freg a, freg b) { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LT_OQ)); }
+inline unsigned int lt(ireg a, ireg b) { return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(b, a))); }
+inline unsigned int eq(freg a, freg b) { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_EQ_OQ)); }
+inline unsigned int eq(ireg a, ireg b) { return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(a, b))); }
+
+inline freg load(freg old, const float* src, unsigned int bits) {
+  if (bits == ALL)
+    return _mm256_loadu_ps(src);
+  return blend(old, _mm256_maskload_ps(src, lanes(bits)), bits);
+}
+inline ireg load(ireg old, const int* src, unsigned int bits) {
+  if (bits == ALL)
+    return _mm256_loadu_si256((const __m256i*)src);
+  return blend(old, _mm256_maskload_epi32(src, lanes(bits)), bits);
+}
+inline void store(float* dest, freg src, unsigned int bits) { _mm256_maskstore_ps(dest, lanes(bits), src); }
+inline void store(int* dest, ireg src, unsigned int bits) { _mm256_maskstore_epi32(dest, lanes(bits), src); }
+
+inline freg swapPairs(freg a) { return _mm256_permute_ps(a, _MM_SHUFFLE(2, 3, 0, 1)); }
+inline freg evensThenOdds(freg a) { return _mm256_permutevar8x32_ps(a, _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7)); }
+
+inline freg min(freg a, freg b) { return _mm256_min_ps(a, b); }
+inline ireg min(ireg a, ireg b) { return _mm256_min_epi32(a, b); }
+inline freg max(freg a, freg b) { return _mm256_max_ps(a, b); }
+inline ireg max(ireg a, ireg b) { return _mm256_max_epi32(a, b); }
+#ifdef __FMA__
+inline freg fma(freg a, freg b, freg c) { return _mm256_fmadd_ps(a, b, c); }
+#else
+inline freg fma(freg a, freg b, freg c) { return laneFma(a, b, c); }
+#endif
+
+inline freg gather(freg old, const float* base, ireg index, unsigned int bits) {
+  return _mm256_mask_i32gather_ps(old, base, index, _mm256_castsi256_ps(lanes(bits)), 4);
+}
+inline ireg gather(ireg old, const int* base, ireg index, unsigned int bits) {
+  return _mm256_mask_i32gather_epi32(old, base, index, lanes(bits), 4);
+}
+inline freg permute(freg old, freg vec, ireg index, unsigned int bits) { return blend(old, _mm256_permutevar8x32_ps(vec, index), bits); }
+inline ireg permute(ireg old, ireg vec, ireg index, unsigned int bits) { return blend(old, _mm256_permutevar8x32_epi32(vec, index), bits); }
+
+// AVX2 has no scatter, compress or expand
+inline void scatter(float* base, ireg index, freg src, unsigned int bits) { laneScatter(base, index, src, bits); }
+inline void scatter(int* base, ireg index, ireg src, unsigned int bits) { laneScatter(base, index, src, bits); }
+inline freg compress(freg old, freg vec, unsigned int bits) { return laneCompress<float>(old, vec, bits); }
+inline ireg compress(ireg old, ireg vec, unsigned int bits) { return laneCompress<int>(old, vec, bits); }
+inline freg expand(freg old, freg vec, unsigned int bits) { return laneExpand<float>(old, vec, bits); }
+inline ireg expand(ireg old, ireg vec, unsigned int bits) { return laneExpand<int>(old, vec, bits); }
+
+#elif VECTOR_WIDTH == 16
+
+#if !defined(__AVX512F__)
+#error "VECTOR_WIDTH 16 needs AVX-512F (compile with -mavx512f)"
+#endif
+
+typedef __m512 freg;
+typedef __m512i ireg;
+const unsigned int ALL = 0xffff;
+
+inline freg set1(float value) { return _mm512_set1_ps(value); }
+inline ireg set1(int value) { return _mm512_set1_epi32(value); }
+inline freg blend(freg old, freg src, unsigned int bits) { return _mm512_mask_blend_ps((__mmask16)bits, old, src); }
+inline ireg blend(ireg old, ireg src, unsigned int bits) { return _mm512_mask_blend_epi32((__mmask16)bits, old, src); }
+
+inline freg add(freg a, freg b) { return _mm512_add_ps(a, b); }
+inline ireg add(ireg a, ireg b) { return _mm512_add_epi32(a, b); }
+inline freg sub(freg a, freg b) { return _mm512_sub_ps(a, b); }
+inline ireg sub(ireg a, ireg b) { return _mm512_sub_epi32(a, b); }
+inline freg mul(freg a, freg b) { return _mm512_mul_ps(a, b); }
+inline ireg mul(ireg a, ireg b) { return _mm512_mullo_epi32(a, b); }
+inline freg div(freg a, freg b) { return _mm512_div_ps(a, b); }
+inline freg abs(freg a) { return _mm512_abs_ps(a); }
+inline ireg abs(ireg a) { return _mm512_abs_epi32(a); }
+
+inline unsigned int gt(freg a, freg b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+inline unsigned int gt(ireg a, ireg b) { return _mm512_cmpgt_epi32_mask(a, b); }
+inline unsigned int lt(freg a, freg b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+inline unsigned int lt(ireg a, ireg b) { return _mm512_cmplt_epi32_mask(a, b); }
+inline unsigned int eq(freg a, freg b) { return _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ); }
+inline unsigned int eq(ireg a, ireg b) { return _mm512_cmpeq_epi32_mask(a, b); }
+
+inline freg load(freg old, const float* src, unsigned int bits) { return _mm512_mask_loadu_ps(old, (__mmask16)bits, src); }
+inline ireg load(ireg old, const int* src, unsigned int bits) { return _mm512_mask_loadu_epi32(old, (__mmask16)bits, src); }
+inline void store(float* dest, freg src, unsigned int bits) { _mm512_mask_storeu_ps(dest, (__mmask16)bits, src); }
+inline void store(int* dest, ireg src, unsigned int bits) { _mm512_mask_storeu_epi32(dest, (__mmask16)bits, src); }
+
+inline freg swapPairs(freg a) { return _mm512_permute_ps(a, _MM_SHUFFLE(2, 3, 0, 1)); }
+inline freg evensThenOdds(freg a) {
+  return _mm512_permutexvar_ps(_mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15), a);
+}
+
+inline freg min(freg a, freg b) { return _mm512_min_ps(a, b); }
+inline ireg min(ireg a, ireg b) { return _mm512_min_epi32(a, b); }
+inline freg max(freg a, freg b) { return _mm512_max_ps(a, b); }
+inline ireg max(ireg a, ireg b) { return _mm512_max_epi32(a, b); }
+inline freg fma(freg a, freg b, freg c) { return _mm512_fmadd_ps(a, b, c); }
+
+inline freg gather(freg old, const float* base, ireg index, unsigned int bits) {
+  return _mm512_mask_i32gather_ps(old, (__mmask16)bits, index, base, 4);
+}
+inline ireg gather(ireg old, const int* base, ireg index, unsigned int bits) {
+  return _mm512_mask_i32gather_epi32(old, (__mmask16)bits, index, base, 4);
+}
+// overlapping lanes are written from lowest to highest, so the highest wins
+inline void scatter(float* base, ireg index, freg src, unsigned int bits) {
+  _mm512_mask_i32scatter_ps(base, (__mmask16)bits, index, src, 4);
+}
+inline void scatter(int* base, ireg index, ireg src, unsigned int bits) {
+  _mm512_mask_i32scatter_epi32(base, (__mmask16)bits, index, src, 4);
+}
+inline freg permute(freg old, freg vec, ireg index, unsigned int bits) { return _mm512_mask_permutexvar_ps(old, (__mmask16)bits, index, vec); }
+inline ireg permute(ireg old, ireg vec, ireg index, unsigned int bits) { return _mm512_mask_permutexvar_epi32(old, (__mmask16)bits, index, vec); }
+inline freg compress(freg old, freg vec, unsigned int bits) { return _mm512_mask_compress_ps(old, (__mmask16)bits, vec); }
+inline ireg compress(ireg old, ireg vec, unsigned int bits) { return _mm512_mask_compress_epi32(old, (__mmask16)bits, vec); }
+inline freg expand(freg old, freg vec, unsigned int bits) { return _mm512_mask_expand_ps(old, (__mmask16)bits, vec); }
+inline ireg expand(ireg old, ireg vec, unsigned int bits) { return _mm512_mask_expand_epi32(old, (__mmask16)bits, vec); }
+
+#else
+#error "The native SIMD backend supports VECTOR_WIDTH 4 (SSE), 8 (AVX2) and 16 (AVX-512)"
+#endif
+
+// No SIMD integer divide on x86; active lanes divide one at a time
+inline ireg div(ireg a, ireg b, unsigned int bits) {
+  alignas(64) int va[VECTOR_WIDTH], vb[VECTOR_WIDTH];
+  store(va, a, ALL);
+  store(vb, b, ALL);
+  for (int i = 0; i < VECTOR_WIDTH; i++)
+    if (bits & (1u << i)) va[i] /= vb[i];
+  return load(a, va, ALL);
+}
+
+}
+
+// Only VECTOR_WIDTH exists natively; the width parameter is there so
+// code written against the templated emulated API still compiles
+template <typename T, int W = VECTOR_WIDTH>
+struct __cs149_vec;
+
+template <>
+struct __cs149_vec<float, VECTOR_WIDTH> {
+  union {
+    cs149simd::freg reg;
+    float value[VECTOR_WIDTH];
+  };
+};
+
+template <>
+struct __cs149_vec<int, VECTOR_WIDTH> {
+  union {
+    cs149simd::ireg reg;
+    int value[VECTOR_WIDTH];
+  };
+};
+
+template <int W>
+struct __cs149_mask_w;
+
+template <>
+struct __cs149_mask_w<VECTOR_WIDTH> {
+  unsigned int bits;
+
+  unsigned long long lanes() const { return bits; }
+};
+
+// Declare a mask with __cs149_mask; bit i is lane i
+typedef __cs149_mask_w<VECTOR_WIDTH> __cs149_mask;
+
+// Declare a floating point vector register with __cs149_vec_float
+#define __cs149_vec_float __cs149_vec<float>
+
+// Declare an integer vector register with __cs149_vec_int
+#define __cs149_vec_int   __cs149_vec<int>
+
+inline void _cs149_log(const char * instruction, const __cs149_mask &mask,
+                       const void * dest = 0, const void * src1 = 0,
+                       const void * src2 = 0, const void * src3 = 0,
+                       const void * src4 = 0) {
+  CS149Logger.addLog(instruction, mask, VECTOR_WIDTH, dest, src1, src2, src3, src4);
+}
+
+//***********************
+//* Function Definition *
+//***********************
+
+template <int W = VECTOR_WIDTH>
+inline __cs149_mask _cs149_init_ones(int first = VECTOR_WIDTH) {
+  static_assert(W == VECTOR_WIDTH, "the native unit only has VECTOR_WIDTH lanes");
+  __cs149_mask mask;
+  mask.bits = first >= VECTOR_WIDTH ? cs149simd::ALL : first <= 0 ? 0 : (1u << first) - 1;
+  return mask;
+}
+
+inline __cs149_mask _cs149_mask_not(__cs149_mask &maska) {
+  __cs149_mask resultMask = { ~maska.bits & cs149simd::ALL };
+  _cs149_log("masknot", _cs149_init_ones(), 0, &maska);
+  return resultMask;
+}
+
+inline __cs149_mask _cs149_mask_or(__cs149_mask &maska, __cs149_mask &maskb) {
+  __cs149_mask resultMask = { maska.bits | maskb.bits };
+  _cs149_log("maskor", _cs149_init_ones(), 0, &maska, &maskb);
+  return resultMask;
+}
+
+inline __cs149_mask _cs149_mask_and(__cs149_mask &maska, __cs149_mask &maskb) {
+  __cs149_mask resultMask = { maska.bits & maskb.bits };
+  _cs149_log("maskand", _cs149_init_ones(), 0, &maska, &maskb);
+  return resultMask;
+}
+
+inline int _cs149_cntbits(__cs149_mask &maska) {
+  _cs149_log("cntbits", _cs149_init_ones(), 0, &maska);
+  return __builtin_popcount(maska.bits);
+}
+
+inline void _cs149_vset_float(__cs149_vec_float &vecResult, float value, __cs149_mask &mask) {
+  vecResult.reg = cs149simd::blend(vecResult.reg, cs149simd::set1(value), mask.bits);
+  _cs149_log("vset", mask, &vecResult, &mask);
+}
+inline void _cs149_vset_int(__cs149_vec_int &vecResult, int value, __cs149_mask &mask) {
+  vecResult.reg = cs149simd::blend(vecResult.reg, cs149simd::set1(value), mask.bits);
+  _cs149_log("vset", mask, &vecResult, &mask);
+}
+template <int W = VECTOR_WIDTH>
+inline __cs149_vec_float _cs149_vset_float(float value) {
+  static_assert(W == VECTOR_WIDTH, "the native unit only has VECTOR_WIDTH lanes");
+  __cs149_vec_float vecResult;
+  vecResult.reg = cs149simd::set1(value);
+  _cs149_log("vset", _cs149_init_ones(), &vecResult);
+  return vecResult;
+}
+template <int W = VECTOR_WIDTH>
+inline __cs149_vec_int _cs149_vset_int(int value) {
+  static_assert(W == VECTOR_WIDTH, "the native unit only has VECTOR_WIDTH lanes");
+  __cs149_vec_int vecResult;
+  vecResult.reg = cs149simd::set1(value);
+  _cs149_log("vset", _cs149_init_ones(), &vecResult);
+  return vecResult;
+}
+
+inline void _cs149_vmove_float(__cs149_vec_float &dest, __cs149_vec_float &src, __cs149_mask &mask) {
+  dest.reg = cs149simd::blend(dest.reg, src.reg, mask.bits);
+  _cs149_log("vmove", mask, &dest, &src, &mask);
+}
+inline void _cs149_vmove_int(__cs149_vec_int &dest, __cs149_vec_int &src, __cs149_mask &mask) {
+  dest.reg = cs149simd::blend(dest.reg, src.reg, mask.bits);
+  _cs149_log("vmove", mask, &dest, &src, &mask);
+}
+
+inline void _cs149_vload_float(__cs149_vec_float &dest, float* src, __cs149_mask &mask) {
+  dest.reg = cs149simd::load(dest.reg, src, mask.bits);
+  _cs149_log("vload", mask, &dest, src, &mask);
+}
+inline void _cs149_vload_int(__cs149_vec_int &dest, int* src, __cs149_mask &mask) {
+  dest.reg = cs149simd::load(dest.reg, src, mask.bits);
+  _cs149_log("vload", mask, &dest, src, &mask);
+}
+
+inline void _cs149_vstore_float(float* dest, __cs149_vec_float &src, __cs149_mask &mask) {
+  cs149simd::store(dest, src.reg, mask.bits);
+  _cs149_log("vstore", mask, dest, &src, &mask);
+}
+inline void _cs149_vstore_int(int* dest, __cs149_vec_int &src, __cs149_mask &mask) {
+  cs149simd::store(dest, src.reg, mask.bits);
+  _cs149_log("vstore", mask, dest, &src, &mask);
+}
+
+#define CS149_SIMD_BINARY(name, op, type)                                              \
+  inline void _cs149_##name##_##type(__cs149_vec_##type &vecResult, __cs149_vec_##type &veca, \
+                                     __cs149_vec_##type &vecb, __cs149_mask &mask) {    \
+    vecResult.reg = cs149simd::blend(vecResult.reg, cs149simd::op(veca.reg, vecb.reg), mask.bits); \
+    _cs149_log(#name, mask, &vecResult, &veca, &vecb, &mask);                          \
+  }
+
+CS149_SIMD_BINARY(vadd, add, float)
+CS149_SIMD_BINARY(vadd, add, int)
+CS149_SIMD_BINARY(vsub, sub, float)
+CS149_SIMD_BINARY(vsub, sub, int)
+CS149_SIMD_BINARY(vmult, mul, float)
+CS149_SIMD_BINARY(vmult, mul, int)
+CS149_SIMD_BINARY(vdiv, div, float)
+CS149_SIMD_BINARY(vmin, min, float)
+CS149_SIMD_BINARY(vmin, min, int)
+CS149_SIMD_BINARY(vmax, max, float)
+CS149_SIMD_BINARY(vmax, max, int)
+
+inline void _cs149_vdiv_int(__cs149_vec_int &vecResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask) {
+  vecResult.reg = cs149simd::blend(vecResult.reg, cs149simd::div(veca.reg, vecb.reg, mask.bits), mask.bits);
+  _cs149_log("vdiv", mask, &vecResult, &veca, &vecb, &mask);
+}
+
+#undef CS149_SIMD_BINARY
+
+inline void _cs149_vabs_float(__cs149_vec_float &vecResult, __cs149_vec_float &veca, __cs149_mask &mask) {
+  vecResult.reg = cs149simd::blend(vecResult.reg, cs149simd::abs(veca.reg), mask.bits);
+  _cs149_log("vabs", mask, &vecResult, &veca, &mask);
+}
+inline void _cs149_vabs_int(__cs149_vec_int &vecResult, __cs149_vec_int &veca, __cs149_mask &mask) {
+  vecResult.reg = cs149simd::blend(vecResult.reg, cs149simd::abs(veca.reg), mask.bits);
+  _cs149_log("vabs", mask, &vecResult, &veca, &mask);
+}
+
+#define CS149_SIMD_COMPARE(name, op, type)                                             \
+  inline void _cs149_##name##_##type(__cs149_mask &maskResult, __cs149_vec_##type &veca, \
+                                     __cs149_vec_##type &vecb, __cs149_mask &mask) {    \
+    maskResult.bits = (cs149simd::op(veca.reg, vecb.reg) & mask.bits) | (maskResult.bits & ~mask.bits); \
+    _cs149_log(#name, mask, &maskResult, &veca, &vecb, &mask);                         \
+  }
+
+CS149_SIMD_COMPARE(vgt, gt, float)
+CS149_SIMD_COMPARE(vgt, gt, int)
+CS149_SIMD_COMPARE(vlt, lt, float)
+CS149_SIMD_COMPARE(vlt, lt, int)
+CS149_SIMD_COMPARE(veq, eq, float)
+CS149_SIMD_COMPARE(veq, eq, int)
+
+#undef CS149_SIMD_COMPARE
+
+inline void _cs149_vgather_float(__cs149_vec_float &dest, float* base, __cs149_vec_int &index, __cs149_mask &mask) {
+  dest.reg = cs149simd::gather(dest.reg, base, index.reg, mask.bits);
+  _cs149_log("vgather", mask, &dest, base, &index, &mask);
+}
+inline void _cs149_vgather_int(__cs149_vec_int &dest, int* base, __cs149_vec_int &index, __cs149_mask &mask) {
+  dest.reg = cs149simd::gather(dest.reg, base, index.reg, mask.bits);
+  _cs149_log("vgather", mask, &dest, base, &index, &mask);
+}
+
+inline void _cs149_vscatter_float(float* base, __cs149_vec_int &index, __cs149_vec_float &src, __cs149_mask &mask) {
+  cs149simd::scatter(base, index.reg, src.reg, mask.bits);
+  _cs149_log("vscatter", mask, base, &index, &src, &mask);
+}
+inline void _cs149_vscatter_int(int* base, __cs149_vec_int &index, __cs149_vec_int &src, __cs149_mask &mask) {
+  cs149simd::scatter(base, index.reg, src.reg, mask.bits);
+  _cs149_log("vscatter", mask, base, &index, &src, &mask);
+}
+
+inline void _cs149_vpermute_float(__cs149_vec_float &vecResult, __cs149_vec_float &vec, __cs149_vec_int &index, __cs149_mask &mask) {
+  vecResult.reg = cs149simd::permute(vecResult.reg, vec.reg, index.reg, mask.bits);
+  _cs149_log("vpermute", mask, &vecResult, &vec, &index, &mask);
+}
+inline void _cs149_vpermute_int(__cs149_vec_int &vecResult, __cs149_vec_int &vec, __cs149_vec_int &index, __cs149_mask &mask) {
+  vecResult.reg = cs149simd::permute(vecResult.reg, vec.reg, index.reg, mask.bits);
+  _cs149_log("vpermute", mask, &vecResult, &vec, &index, &mask);
+}
+
+inline void _cs149_vfma_float(__cs149_vec_float &vecResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_vec_float &vecc, __cs149_mask &mask) {
+  vecResult.reg = cs149simd::blend(vecResult.reg, cs149simd::fma(veca.reg, vecb.reg, vecc.reg), mask.bits);
+  _cs149_log("vfma", mask, &vecResult, &veca, &vecb, &vecc, &mask);
+}
+
+inline void _cs149_vcompress_float(__cs149_vec_float &vecResult, __cs149_vec_float &vec, __cs149_mask &mask) {
+  vecResult.reg = cs149simd::compress(vecResult.reg, vec.reg, mask.bits);
+  _cs149_log("vcompress", mask, &vecResult, &vec, &mask);
+}
+inline void _cs149_vcompress_int(__cs149_vec_int &vecResult, __cs149_vec_int &vec, __cs149_mask &mask) {
+  vecResult.reg = cs149simd::compress(vecResult.reg, vec.reg, mask.bits);
+  _cs149_log("vcompress", mask, &vecResult, &vec, &mask);
+}
+
+inline void _cs149_vexpand_float(__cs149_vec_float &vecResult, __cs149_vec_float &vec, __cs149_mask &mask) {
+  vecResult.reg = cs149simd::expand(vecResult.reg, vec.reg, mask.bits);
+  _cs149_log("vexpand", mask, &vecResult, &vec, &mask);
+}
+inline void _cs149_vexpand_int(__cs149_vec_int &vecResult, __cs149_vec_int &vec, __cs149_mask &mask) {
+  vecResult.reg = cs149simd::expand(vecResult.reg, vec.reg, mask.bits);
+  _cs149_log("vexpand", mask, &vecResult, &vec, &mask);
+}
+
+inline void _cs149_hadd_float(__cs149_vec_float &vecResult, __cs149_vec_float &vec) {
+  vecResult.reg = cs149simd::add(vec.reg, cs149simd::swapPairs(vec.reg));
+}
+
+inline void _cs149_interleave_float(__cs149_vec_float &vecResult, __cs149_vec_float &vec) {
+  vecResult.reg = cs149simd::evensThenOdds(vec.reg);
+}
+
+// Add a customized log to help debugging
+void addUserLog(const char * logStr);
+
+#endif
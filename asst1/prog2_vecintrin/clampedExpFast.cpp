@@ -0,0 +1,104 @@
+#include <immintrin.h>
+
+// Optimized clamped exponent kernels for the benchmark in main.cpp
+// ('myexp -e').  Computing x^y by repeated multiplication takes y
+// steps, so a vector runs as long as its largest exponent while lanes
+// with small ones sit idle.  Exponentiation by squaring takes one step
+// per bit of y instead:
+//
+//     x^13 = x^8 * x^4 * x^1        (13 = 0b1101)
+//
+// which both shortens the work and narrows the gap between lanes.
+// Every vector loop stops as soon as all of its lanes are done.
+//
+// This file is always built with optimization (see the Makefile), and
+// the AVX2 versions use a per-function target attribute, so the
+// benchmark compares like with like in any build.  Squaring rounds
+// differently from repeated multiplication, so results agree to a
+// relative error of about y * 2^-24, not exactly.
+
+#define CLAMP_MAX 9.999999f
+
+// The same as clampedExpSerial() in main.cpp
+void clampedExpScalar(float* values, int* exponents, float* output, int N) {
+  for (int i = 0; i < N; i++) {
+    float x = values[i];
+    float result = 1.f;
+    for (int y = exponents[i]; y > 0; y--)
+      result *= x;
+    output[i] = result > CLAMP_MAX ? CLAMP_MAX : result;
+  }
+}
+
+// The same as clampedExpSquaringSerial() in main.cpp
+void clampedExpSquaringScalar(float* values, int* exponents, float* output, int N) {
+  for (int i = 0; i < N; i++) {
+    float base = values[i];
+    float result = 1.f;
+    for (int y = exponents[i]; y > 0; y >>= 1) {
+      if (y & 1)
+        result *= base;
+      base *= base;
+    }
+    output[i] = result > CLAMP_MAX ? CLAMP_MAX : result;
+  }
+}
+
+// Lanes past N get exponent 0 and are not stored
+__attribute__((target("avx2")))
+static inline __m256i tailMask(int remaining) {
+  __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  return _mm256_cmpgt_epi32(_mm256_set1_epi32(remaining), lane);
+}
+
+__attribute__((target("avx2")))
+void clampedExpAvx2(float* values, int* exponents, float* output, int N) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256 clamp = _mm256_set1_ps(CLAMP_MAX);
+
+  for (int i = 0; i < N; i += 8) {
+    __m256i inRange = tailMask(N - i);
+    __m256 x = _mm256_maskload_ps(values + i, inRange);
+    __m256i y = _mm256_maskload_epi32(exponents + i, inRange);
+    __m256 result = _mm256_set1_ps(1.f);
+
+    __m256i active = _mm256_cmpgt_epi32(y, zero);
+    while (_mm256_movemask_ps(_mm256_castsi256_ps(active)) != 0) {
+      result = _mm256_blendv_ps(result, _mm256_mul_ps(result, x), _mm256_castsi256_ps(active));
+      y = _mm256_add_epi32(y, active);         // active lanes are -1
+      active = _mm256_cmpgt_epi32(y, zero);
+    }
+
+    _mm256_maskstore_ps(output + i, inRange, _mm256_min_ps(result, clamp));
+  }
+}
+
+__attribute__((target("avx2")))
+void clampedExpSquaringAvx2(float* values, int* exponents, float* output, int N) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256 clamp = _mm256_set1_ps(CLAMP_MAX);
+
+  for (int i = 0; i < N; i += 8) {
+    __m256i inRange = tailMask(N - i);
+    __m256 base = _mm256_maskload_ps(values + i, inRange);
+    __m256i y = _mm256_maskload_epi32(exponents + i, inRange);
+    __m256 result = _mm256_set1_ps(1.f);
+
+    __m256i active = _mm256_cmpgt_epi32(y, zero);
+    while (_mm256_movemask_ps(_mm256_castsi256_ps(active)) != 0) {
+      __m256i odd = _mm256_cmpeq_epi32(_mm256_and_si256(y, one), one);
+      result = _mm256_blendv_ps(result, _mm256_mul_ps(result, base), _mm256_castsi256_ps(odd));
+      base = _mm256_mul_ps(base, base);
+      y = _mm256_srli_epi32(y, 1);
+      active = _mm256_cmpgt_epi32(y, zero);
+    }
+
+    _mm256_maskstore_ps(output + i, inRange, _mm256_min_ps(result, clamp));
+  }
+}
+
+bool clampedExpAvx2Supported() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "costmodel.h"
+
+static const char* unitNames[NUM_UNITS] = {"alu", "mul", "div", "load", "store", "mask"};
+
+// Rough figures for a recent x86 core
+static const OpcodeCost defaultCosts[] = {
+  {"vset",     1, 1, 0, UNIT_ALU},
+  {"vmove",    1, 1, 0, UNIT_ALU},
+  {"vload",    5, 1, 2, UNIT_LOAD},
+  {"vstore",   4, 1, 2, UNIT_STORE},
+  {"vadd",     4, 1, 0, UNIT_ALU},
+  {"vsub",     4, 1, 0, UNIT_ALU},
+  {"vmult",    4, 1, 0, UNIT_MUL},
+  {"vdiv",    14, 5, 0, UNIT_DIV},
+  {"vabs",     1, 1, 0, UNIT_ALU},
+  {"vgt",      3, 1, 0, UNIT_ALU},
+  {"vlt",      3, 1, 0, UNIT_ALU},
+  {"veq",      3, 1, 0, UNIT_ALU},
+  {"masknot",  1, 1, 0, UNIT_MASK},
+  {"maskor",   1, 1, 0, UNIT_MASK},
+  {"maskand",  1, 1, 0, UNIT_MASK},
+  {"cntbits",  4, 1, 0, UNIT_MASK},   // mask to scalar, then popcount
+  {"vgather", 20, 5, 0, UNIT_LOAD},   // one load per lane
+  {"vscatter",12, 8, 0, UNIT_STORE},
+  {"vpermute", 3, 1, 0, UNIT_ALU},
+  {"vfma",     4, 1, 0, UNIT_MUL},
+  {"vmin",     4, 1, 0, UNIT_ALU},
+  {"vmax",     4, 1, 0, UNIT_ALU},
+  {"vcompress",6, 2, 0, UNIT_ALU},
+  {"vexpand",  6, 2, 0, UNIT_ALU},
+};
+
+// used for opcodes missing from the table, e.g. user logs
+static const OpcodeCost unknownCost = {"", 1, 1, 0, UNIT_ALU};
+
+CostModel::CostModel() : num_costs(0) {
+  for (const OpcodeCost& cost : defaultCosts)
+    setCost(cost.instruction, cost.latency, cost.interval, cost.masked_penalty, cost.unit);
+  reset();
+}
+
+void CostModel::reset() {
+  memset(registers, 0, sizeof(registers));
+  memset(unit_free, 0, sizeof(unit_free));
+  next_issue = 0;
+  finish = 0;
+  critical = 0;
+}
+
+const OpcodeCost* CostModel::findCost(const char * instruction) const {
+  for (int i=0; i<num_costs; i++) {
+    if (strcmp(costs[i].instruction, instruction) == 0)
+      return &costs[i];
+  }
+  return &unknownCost;
+}
+
+void CostModel::setCost(const char * instruction, int latency, int interval,
+                        int maskedPenalty, ExecUnit unit) {
+  OpcodeCost* cost = 0;
+  for (int i=0; i<num_costs && !cost; i++) {
+    if (strcmp(costs[i].instruction, instruction) == 0)
+      cost = &costs[i];
+  }
+  if (!cost) {
+    if (num_costs == MAX_COST_ENTRIES)
+      return;
+    cost = &costs[num_costs++];
+    strncpy(cost->instruction, instruction, COST_NAME_LEN-1);
+    cost->instruction[COST_NAME_LEN-1] = '\0';
+  }
+  cost->latency = latency;
+  cost->interval = interval > 0 ? interval : 1;
+  cost->masked_penalty = maskedPenalty;
+  cost->unit = unit;
+}
+
+bool CostModel::loadCosts(const char * path) {
+  FILE* f = fopen(path, "r");
+  if (!f)
+    return false;
+
+  char line[256];
+  int lineNumber = 0;
+  bool ok = true;
+  while (fgets(line, sizeof(line), f)) {
+    lineNumber++;
+    char* comment = strchr(line, '#');
+    if (comment)
+      *comment = '\0';
+
+    char name[COST_NAME_LEN], unitName[16];
+    int latency, interval, penalty;
+    int fields = sscanf(line, "%31s %d %d %d %15s", name, &latency, &interval, &penalty, unitName);
+    if (fields <= 0)
+      continue;
+
+    int unit = 0;
+    while (fields == 5 && unit < NUM_UNITS && strcmp(unitNames[unit], unitName) != 0)
+      unit++;
+    if (fields != 5 || unit == NUM_UNITS) {
+      printf("%s:%d: expected \"opcode latency interval penalty unit\"\n", path, lineNumber);
+      ok = false;
+      continue;
+    }
+    setCost(name, latency, interval, penalty, (ExecUnit)unit);
+  }
+  fclose(f);
+  return ok;
+}
+
+CostModel::RegisterTiming* CostModel::lookup(const void * reg) {
+  uintptr_t key = (uintptr_t)reg;
+  return &registers[((key >> 2) * 2654435761u) % REGISTER_TABLE_SIZE];
+}
+
+void CostModel::issue(const char * instruction, bool partialMask, const void * dest,
+                      const void * const * srcs, int numSrcs) {
+  issue(findCost(instruction), partialMask, dest, srcs, numSrcs);
+}
+
+void CostModel::issue(const OpcodeCost* cost, bool partialMask, const void * dest,
+                      const void * const * srcs, int numSrcs) {
+
+  // inactive lanes keep the old value, so a partial mask reads dest too
+  unsigned long long ready = 0, depth = 0;
+  for (int i=0; i<=numSrcs; i++) {
+    const void * reg = i < numSrcs ? srcs[i] : (partialMask ? dest : 0);
+    if (!reg)
+      continue;
+    RegisterTiming* timing = lookup(reg);
+    if (timing->reg != reg)
+      continue;
+    if (timing->ready > ready) ready = timing->ready;
+    if (timing->depth > depth) depth = timing->depth;
+  }
+
+  unsigned long long start = next_issue;
+  if (ready > start) start = ready;
+  if (unit_free[cost->unit] > start) start = unit_free[cost->unit];
+
+  int latency = cost->latency + (partialMask ? cost->masked_penalty : 0);
+  next_issue = start + 1;
+  unit_free[cost->unit] = start + cost->interval;
+  if (start + latency > finish) finish = start + latency;
+  if (depth + latency > critical) critical = depth + latency;
+
+  if (dest) {
+    RegisterTiming* timing = lookup(dest);
+    timing->reg = dest;
+    timing->ready = start + latency;
+    timing->depth = depth + latency;
+  }
+}
+
+void CostModel::printCosts() {
+  printf(" Instruction | Latency | Interval | Masked | Unit\n");
+  for (int i=0; i<num_costs; i++) {
+    printf("%12s | %7d | %8d | %6d | %s\n", costs[i].instruction, costs[i].latency,
+           costs[i].interval, costs[i].masked_penalty, unitNames[costs[i].unit]);
+  }
+}
@@ -0,0 +1,86 @@
+#ifndef COSTMODEL_H_
+#define COSTMODEL_H_
+
+#define MAX_COST_ENTRIES 32
+#define COST_NAME_LEN 32
+#define REGISTER_TABLE_SIZE 1024
+
+// Estimates how long a stream of vector instructions takes.
+//
+// Each opcode has a latency (cycles until its result can be used), an
+// issue interval (cycles before its execution unit takes another
+// instruction) and a penalty added to the latency when only some lanes
+// are active, as masked loads and stores cost extra on real hardware.
+//
+// Instructions issue in program order, at most one per cycle, once
+// their operands are ready and their unit is free.  Operands are
+// identified by address: vector registers and masks by the address of
+// the variable, memory by the address loaded from or stored to.  The
+// critical path is the longest chain of dependent latencies, ignoring
+// issue order and units; it bounds the run time from below no matter
+// how the instructions are scheduled.
+//
+// Results returned by value (the mask_* ops and _cs149_vset_*(value))
+// are not tracked, so instructions using them start new chains.
+
+enum ExecUnit {
+  UNIT_ALU,
+  UNIT_MUL,
+  UNIT_DIV,
+  UNIT_LOAD,
+  UNIT_STORE,
+  UNIT_MASK,
+  NUM_UNITS
+};
+
+struct OpcodeCost {
+  char instruction[COST_NAME_LEN];
+  int latency;
+  int interval;
+  int masked_penalty;
+  ExecUnit unit;
+};
+
+class CostModel {
+  private:
+    struct RegisterTiming {
+      const void * reg;
+      unsigned long long ready;     // cycle the value is available
+      unsigned long long depth;     // latency of the chain producing it
+    };
+
+    OpcodeCost costs[MAX_COST_ENTRIES];
+    int num_costs;
+    // direct-mapped; a collision just forgets the older register
+    RegisterTiming registers[REGISTER_TABLE_SIZE];
+    unsigned long long unit_free[NUM_UNITS];
+    unsigned long long next_issue;
+    unsigned long long finish;
+    unsigned long long critical;
+
+    RegisterTiming* lookup(const void * reg);
+
+  public:
+    CostModel();
+    // Clears the timing state, keeping the cost table
+    void reset();
+    void setCost(const char * instruction, int latency, int interval,
+                 int maskedPenalty, ExecUnit unit);
+    // Reads "opcode latency interval penalty unit" lines, where unit is
+    // one of alu, mul, div, load, store or mask; '#' starts a comment
+    bool loadCosts(const char * path);
+    void issue(const char * instruction, bool partialMask, const void * dest,
+               const void * const * srcs, int numSrcs);
+    // The cost of an opcode, for callers that look it up once and then
+    // issue it many times.  The pointer stays valid, though setCost()
+    // for an opcode not in the table yet is only seen by later lookups.
+    const OpcodeCost* findCost(const char * instruction) const;
+    void issue(const OpcodeCost* cost, bool partialMask, const void * dest,
+               const void * const * srcs, int numSrcs);
+    void printCosts();
+
+    unsigned long long cycles() const { return finish; }
+    unsigned long long criticalPath() const { return critical; }
+};
+
+#endif
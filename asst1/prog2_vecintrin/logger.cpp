@@ -1,40 +1,137 @@
 #include "logger.h"
 #include "CS149intrin.h"
 
-void Logger::addLog(const char * instruction, __cs149_mask mask, int N) {
-  Log newLog;
-  strcpy(newLog.instruction, instruction);
-  newLog.mask = 0;
-  for (int i=0; i<N; i++) {
-    if (mask.value[i]) {
-      newLog.mask |= (((unsigned long long)1)<<i);
-      stats.utilized_lane++;
-    }
+Logger::Logger() : mode(LOG_STATS) {
+  reset();
+}
+
+void Logger::reset() {
+  memset(&stats, 0, sizeof(stats));
+  memset(lanes_histogram, 0, sizeof(lanes_histogram));
+  width = VECTOR_WIDTH;
+  num_opcodes = 0;
+  memset(opcode_cache, 0, sizeof(opcode_cache));
+  logged = 0;
+  cost_model.reset();
+  if (mode == LOG_TRACE)
+    log.clear();
+}
+
+void Logger::setMode(LogMode newMode, int ringSize) {
+  mode = newMode;
+  log.clear();
+  logged = 0;
+  if (mode == LOG_RING)
+    log.resize(ringSize > 0 ? ringSize : 1);
+}
+
+OpcodeStatistics* Logger::findOpcode(const char * instruction) {
+  for (int i=0; i<num_opcodes; i++) {
+    if (strcmp(opcodes[i].instruction, instruction) == 0)
+      return &opcodes[i];
+  }
+  // once the table is full, further opcodes share its last entry
+  if (num_opcodes == MAX_OPCODES) {
+    strcpy(opcodes[MAX_OPCODES-1].instruction, "(other)");
+    return &opcodes[MAX_OPCODES-1];
   }
+  OpcodeStatistics* op = &opcodes[num_opcodes++];
+  strncpy(op->instruction, instruction, MAX_INST_LEN-1);
+  op->instruction[MAX_INST_LEN-1] = '\0';
+  op->count = op->utilized_lane = op->total_lane = 0;
+  return op;
+}
+
+void Logger::record(const char * instruction, unsigned long long mask, int N,
+                    const void * dest, const void * const * srcs) {
+  if (N < MAX_LANES)
+    mask &= (((unsigned long long)1)<<N) - 1;
+  int active = __builtin_popcountll(mask);
+  stats.utilized_lane += active;
   stats.total_lane += N;
   stats.total_instructions += (N>0);
-  log.push_back(newLog);
+
+  // user logs (N == 0) only show up in the trace
+  if (N > 0) {
+    width = N;
+    uintptr_t key = (uintptr_t)instruction;
+    OpcodeCacheEntry& entry = opcode_cache[(key ^ (key >> 6)) & (OPCODE_CACHE_SIZE-1)];
+    if (entry.instruction != instruction) {
+      entry.instruction = instruction;
+      entry.op = findOpcode(instruction);
+      entry.cost = cost_model.findCost(instruction);
+    }
+    OpcodeStatistics* op = entry.op;
+    op->count++;
+    op->utilized_lane += active;
+    op->total_lane += N;
+    lanes_histogram[active]++;
+    cost_model.issue(entry.cost, active < N, dest, srcs, 4);
+  }
+
+  if (mode == LOG_STATS)
+    return;
+
+  Log newLog;
+  strncpy(newLog.instruction, instruction, MAX_INST_LEN-1);
+  newLog.instruction[MAX_INST_LEN-1] = '\0';
+  newLog.mask = mask;
+  if (mode == LOG_TRACE) {
+    log.push_back(newLog);
+  } else {
+    log[logged % log.size()] = newLog;
+    logged++;
+  }
 }
 
 void Logger::printStats() {
   printf("****************** Printing Vector Unit Statistics *******************\n");
-  printf("Vector Width:              %d\n", VECTOR_WIDTH);
+  printf("Vector Width:              %d\n", width);
   printf("Total Vector Instructions: %lld\n", stats.total_instructions);
-  printf("Vector Utilization:        %.1f%%\n", (double)stats.utilized_lane/stats.total_lane*100);
+  printf("Vector Utilization:        %.1f%%\n", stats.total_lane ? (double)stats.utilized_lane/stats.total_lane*100 : 0.0);
   printf("Utilized Vector Lanes:     %lld\n", stats.utilized_lane);
   printf("Total Vector Lanes:        %lld\n", stats.total_lane);
+  printf("Estimated Cycles:          %lld\n", cost_model.cycles());
+  printf("Critical Path:             %lld cycles\n", cost_model.criticalPath());
+  if (num_opcodes == 0)
+    return;
+
+  printf(" Instruction |        Count | Utilization\n");
+  for (int i=0; i<num_opcodes; i++) {
+    printf("%12s | %12lld | %10.1f%%\n", opcodes[i].instruction, opcodes[i].count,
+           (double)opcodes[i].utilized_lane/opcodes[i].total_lane*100);
+  }
+  printf("Active Lanes |        Count\n");
+  for (int i=0; i<=MAX_LANES; i++) {
+    if (lanes_histogram[i])
+      printf("%12d | %12lld\n", i, lanes_histogram[i]);
+  }
 }
 
 
 
 void Logger::printLog() {
   printf("***************** Printing Vector Unit Execution Log *****************\n");
+  if (mode == LOG_STATS) {
+    printf("(not recorded: the logger is in stats-only mode)\n");
+    return;
+  }
+
+  size_t first = 0, count = log.size();
+  if (mode == LOG_RING) {
+    count = logged < log.size() ? logged : log.size();
+    first = logged - count;
+    if (first > 0)
+      printf("(%lld earlier instructions dropped from the ring buffer)\n", (unsigned long long)first);
+  }
+
   printf(" Instruction | Vector Lane Occupancy ('*' for active, '_' for inactive)\n");
   printf("------------- --------------------------------------------------------\n");
-  for (int i=0; i<log.size(); i++) {
-    printf("%12s | ", log[i].instruction);
-    for (int j=0; j<VECTOR_WIDTH; j++) {
-      if (log[i].mask & (((unsigned long long)1)<<j)) {
+  for (size_t k=first; k<first+count; k++) {
+    const Log& entry = log[k % log.size()];
+    printf("%12s | ", entry.instruction);
+    for (int j=0; j<width; j++) {
+      if (entry.mask & (((unsigned long long)1)<<j)) {
         printf("*");
       } else {
         printf("_");
@@ -43,4 +140,3 @@ void Logger::printLog() {
     printf("\n");
   }
 }
-
@@ -1,14 +1,29 @@
 #ifndef LOGGER_H_
 #define LOGGER_H_
 
+#include <stdint.h>
 #include <stdio.h>
 #include <vector>
 #include <string.h>
+#include "costmodel.h"
 using namespace std;
 
 #define MAX_INST_LEN 32
+#define MAX_OPCODES 32
+#define MAX_LANES 64
+#define DEFAULT_RING_SIZE 4096
+#define OPCODE_CACHE_SIZE 64  // power of two, above MAX_OPCODES
 
-struct __cs149_mask;
+// Build with -DCS149_LOGGING=0 to compile every addLog() call out.
+// Logging is on by default, except with the native SIMD backend where
+// it would dominate the run time.
+#ifndef CS149_LOGGING
+#ifdef CS149_NATIVE_SIMD
+#define CS149_LOGGING 0
+#else
+#define CS149_LOGGING 1
+#endif
+#endif
 
 struct Log {
   char instruction[MAX_INST_LEN];
@@ -21,13 +36,72 @@ struct Statistics {
   unsigned long long total_instructions;
 };
 
+struct OpcodeStatistics {
+  char instruction[MAX_INST_LEN];
+  unsigned long long count;
+  unsigned long long utilized_lane;
+  unsigned long long total_lane;
+};
+
+// LOG_STATS keeps only fixed-size counters, LOG_TRACE also records
+// every instruction, and LOG_RING records the most recent ones in a
+// fixed-size ring buffer.
+enum LogMode {
+  LOG_STATS,
+  LOG_TRACE,
+  LOG_RING
+};
+
 class Logger {
   private:
+    LogMode mode;
     vector<Log> log;
+    unsigned long long logged;      // entries ever written to the ring
     Statistics stats;
+    int width;                      // lanes of the last vector instruction
+    OpcodeStatistics opcodes[MAX_OPCODES];
+    int num_opcodes;
+    unsigned long long lanes_histogram[MAX_LANES + 1];   // by active lanes
+    CostModel cost_model;
+
+    // Instruction names are string literals, so the name's address
+    // identifies the opcode without comparing strings.  A direct-mapped
+    // cache from address to opcode entry and cost means each call site
+    // pays for the string lookup once per reset(); the same name at
+    // another address only costs one more lookup.
+    struct OpcodeCacheEntry {
+      const char * instruction;
+      OpcodeStatistics * op;
+      const OpcodeCost * cost;
+    };
+    OpcodeCacheEntry opcode_cache[OPCODE_CACHE_SIZE];
+
+    void record(const char * instruction, unsigned long long mask, int N,
+                const void * dest, const void * const * srcs);
+    OpcodeStatistics* findOpcode(const char * instruction);
 
   public:
-    void addLog(const char * instruction, __cs149_mask mask, int N = 0);
+    static constexpr bool enabled = CS149_LOGGING != 0;
+
+    Logger();
+    void setMode(LogMode newMode, int ringSize = DEFAULT_RING_SIZE);
+    // Masks of any width work; mask.lanes() gives the active lanes as
+    // bits.  dest and src1..4 are the addresses of the operands, which
+    // the cost model uses to track dependencies.
+    template <typename Mask>
+    inline void addLog(const char * instruction, const Mask &mask, int N = 0,
+                       const void * dest = 0, const void * src1 = 0,
+                       const void * src2 = 0, const void * src3 = 0,
+                       const void * src4 = 0) {
+      if (enabled) {
+        const void * srcs[4] = {src1, src2, src3, src4};
+        record(instruction, mask.lanes(), N, dest, srcs);
+      }
+    }
+    // Clears the statistics and the trace, keeping the mode
+    void reset();
+    const Statistics& getStats() const { return stats; }
+    CostModel& costModel() { return cost_model; }
     void printStats();
     void printLog();
 };
@@ -4,6 +4,7 @@
 #include <math.h>
 #include "CS149intrin.h"
 #include "logger.h"
+#include "CycleTimer.h"
 using namespace std;
 
 #define EXP_MAX 10
@@ -13,27 +14,52 @@ Logger CS149Logger;
 void usage(const char* progname);
 void initValue(float* values, int* exponents, float* output, float* gold, unsigned int N);
 void absSerial(float* values, float* output, int N);
+template <int W = VECTOR_WIDTH>
 void absVector(float* values, float* output, int N);
 void clampedExpSerial(float* values, int* exponents, float* output, int N);
+template <int W = VECTOR_WIDTH>
 void clampedExpVector(float* values, int* exponents, float* output, int N);
+void clampedExpSquaringSerial(float* values, int* exponents, float* output, int N);
+template <int W = VECTOR_WIDTH>
+void clampedExpSquaringVector(float* values, int* exponents, float* output, int N);
 float arraySumSerial(float* values, int N);
+template <int W = VECTOR_WIDTH>
 float arraySumVector(float* values, int N);
 bool verifyResult(float* values, int* exponents, float* output, float* gold, int N);
+void widthSweep(float* values, int* exponents, int N);
+void costReport(float* values, int* exponents, float* output, int N);
+bool runExamples(float* values, int* exponents, int N);
+bool expBenchmark(int N);
+
+// default workload size of the exponent benchmark, which times real
+// kernels and so needs far more than the default N to measure anything
+#define EXP_BENCH_N (1 << 20)
 
 int main(int argc, char * argv[]) {
   int N = 16;
+  bool sizeGiven = false;
   bool printLog = false;
+  int ringSize = 0;
+  bool sweep = false;
+  const char* costFile = NULL;
+  bool examples = false;
+  bool expBench = false;
 
   // parse commandline options ////////////////////////////////////////////
   int opt;
   static struct option long_options[] = {
     {"size", 1, 0, 's'},
     {"log", 0, 0, 'l'},
+    {"ring", 1, 0, 'r'},
+    {"sweep", 0, 0, 'w'},
+    {"costs", 1, 0, 'c'},
+    {"examples", 0, 0, 'x'},
+    {"exp-bench", 0, 0, 'e'},
     {"help", 0, 0, '?'},
     {0 ,0, 0, 0}
   };
 
-  while ((opt = getopt_long(argc, argv, "s:l?", long_options, NULL)) != EOF) {
+  while ((opt = getopt_long(argc, argv, "s:lr:wc:xe?", long_options, NULL)) != EOF) {
 
     switch (opt) {
       case 's':
@@ -42,10 +68,27 @@ int main(int argc, char * argv[]) {
           printf("Error: Workload size is set to %d (<0).\n", N);
           return -1;
         }
+        sizeGiven = true;
         break;
       case 'l':
         printLog = true;
         break;
+      case 'r':
+        printLog = true;
+        ringSize = atoi(optarg);
+        break;
+      case 'w':
+        sweep = true;
+        break;
+      case 'c':
+        costFile = optarg;
+        break;
+      case 'x':
+        examples = true;
+        break;
+      case 'e':
+        expBench = true;
+        break;
       case '?':
       default:
         usage(argv[0]);
@@ -54,14 +97,53 @@ int main(int argc, char * argv[]) {
   }
 
 
-  float* values = new float[N+VECTOR_WIDTH];
-  int* exponents = new int[N+VECTOR_WIDTH];
-  float* output = new float[N+VECTOR_WIDTH];
-  float* gold = new float[N+VECTOR_WIDTH];
+  // the benchmark's most skewed distribution puts one outlier in every
+  // 64 elements
+  if (expBench && sizeGiven && N < 64) {
+    printf("Error: the exponent benchmark needs a workload size of at least 64.\n");
+    return -1;
+  }
+
+  if (costFile && !CS149Logger.costModel().loadCosts(costFile)) {
+    printf("Error: could not load instruction costs from %s\n", costFile);
+    return -1;
+  }
+
+  // keep only counters unless a trace was asked for
+  if (ringSize > 0)
+    CS149Logger.setMode(LOG_RING, ringSize);
+  else if (printLog)
+    CS149Logger.setMode(LOG_TRACE);
+
+  // padded for the widest vector in the width sweep
+  float* values = new float[N+MAX_LANES];
+  int* exponents = new int[N+MAX_LANES];
+  float* output = new float[N+MAX_LANES];
+  float* gold = new float[N+MAX_LANES];
   initValue(values, exponents, output, gold, N);
 
+  if (sweep || examples || expBench) {
+    bool ok = true;
+    if (sweep)
+      widthSweep(values, exponents, N);
+    if (examples)
+      ok = runExamples(values, exponents, N);
+    if (expBench)
+      ok &= expBenchmark(sizeGiven ? N : EXP_BENCH_N);
+    delete [] values;
+    delete [] exponents;
+    delete [] output;
+    delete [] gold;
+    return ok ? 0 : 1;
+  }
+
+  double startTime = CycleTimer::currentSeconds();
   clampedExpSerial(values, exponents, gold, N);
+  double serialTime = CycleTimer::currentSeconds() - startTime;
+
+  startTime = CycleTimer::currentSeconds();
   clampedExpVector(values, exponents, output, N);
+  double vectorTime = CycleTimer::currentSeconds() - startTime;
 
   //absSerial(values, gold, N);
   //absVector(values, output, N);
@@ -70,6 +152,8 @@ int main(int argc, char * argv[]) {
   bool clampedCorrect = verifyResult(values, exponents, output, gold, N);
   if (printLog) CS149Logger.printLog();
   CS149Logger.printStats();
+  printf("Serial: %.3f ms, vector: %.3f ms (%.2fx)\n",
+         serialTime * 1000, vectorTime * 1000, serialTime / vectorTime);
 
   printf("************************ Result Verification *************************\n");
   if (!clampedCorrect) {
@@ -94,6 +178,9 @@ int main(int argc, char * argv[]) {
     printf("Must have N %% VECTOR_WIDTH == 0 for this problem (VECTOR_WIDTH is %d)\n", VECTOR_WIDTH);
   }
 
+  if (Logger::enabled)
+    costReport(values, exponents, output, N);
+
   delete [] values;
   delete [] exponents;
   delete [] output;
@@ -107,12 +194,18 @@ void usage(const char* progname) {
   printf("Program Options:\n");
   printf("  -s  --size <N>     Use workload size N (Default = 16)\n");
   printf("  -l  --log          Print vector unit execution log\n");
+  printf("  -r  --ring <K>     Print only the last K instructions of the log\n");
+  printf("  -w  --sweep        Run the kernels at vector widths 2 to 64 and compare\n");
+  printf("  -c  --costs <file>  Read instruction latencies for the cost model from file\n");
+  printf("  -x  --examples     Run the sparse matrix-vector and histogram examples\n");
+  printf("  -e  --exp-bench    Compare repeated multiplication with squaring on skewed exponents\n");
+  printf("                     (at N = %d unless -s is given, which must be at least 64)\n", EXP_BENCH_N);
   printf("  -?  --help         This message\n");
 }
 
 void initValue(float* values, int* exponents, float* output, float* gold, unsigned int N) {
 
-  for (unsigned int i=0; i<N+VECTOR_WIDTH; i++)
+  for (unsigned int i=0; i<N+MAX_LANES; i++)
   {
     // random input values
     values[i] = -1.f + 4.f * static_cast<float>(rand()) / RAND_MAX;
@@ -177,22 +270,23 @@ void absSerial(float* values, float* output, int N) {
 
 
 // implementation of absSerial() above, but it is vectorized using CS149 intrinsics
+template <int W>
 void absVector(float* values, float* output, int N) {
-  __cs149_vec_float x;
-  __cs149_vec_float result;
-  __cs149_vec_float zero = _cs149_vset_float(0.f);
-  __cs149_mask maskAll, maskIsNegative, maskIsNotNegative;
+  __cs149_vec<float, W> x;
+  __cs149_vec<float, W> result;
+  __cs149_vec<float, W> zero = _cs149_vset_float<W>(0.f);
+  __cs149_mask_w<W> maskAll, maskIsNegative, maskIsNotNegative;
 
 //  Note: Take a careful look at this loop indexing.  This example
 //  code is not guaranteed to work when (N % VECTOR_WIDTH) != 0.
 //  Why is that the case?
-  for (int i=0; i<N; i+=VECTOR_WIDTH) {
+  for (int i=0; i<N; i+=W) {
 
     // All ones
-    maskAll = _cs149_init_ones();
+    maskAll = _cs149_init_ones<W>();
 
     // All zeros
-    maskIsNegative = _cs149_init_ones(0);
+    maskIsNegative = _cs149_init_ones<W>(0);
 
     // Load vector of values from contiguous memory addresses
     _cs149_vload_float(x, values+i, maskAll);               // x = values[i];
@@ -240,6 +334,7 @@ void clampedExpSerial(float* values, int* exponents, float* output, int N) {
   }
 }
 
+template <int W>
 void clampedExpVector(float* values, int* exponents, float* output, int N) {
 
   //
@@ -250,11 +345,11 @@ void clampedExpVector(float* values, int* exponents, float* output, int N) {
   // N and VECTOR_WIDTH, not just when VECTOR_WIDTH divides N
   //
   
-  for (int i=0; i<N; i+=VECTOR_WIDTH) {
-    __cs149_vec_float vec_x, vec_z, vec_max;
-    __cs149_vec_int vec_y, vec_zero, vec_ones;
-    __cs149_mask mask_all = _cs149_init_ones();
-    __cs149_mask mask_z = _cs149_init_ones(0);
+  for (int i=0; i<N; i+=W) {
+    __cs149_vec<float, W> vec_x, vec_z, vec_max;
+    __cs149_vec<int, W> vec_y, vec_zero, vec_ones;
+    __cs149_mask_w<W> mask_all = _cs149_init_ones<W>();
+    __cs149_mask_w<W> mask_z = _cs149_init_ones<W>(0);
 
     // initialize the vectors
     _cs149_vload_float(vec_x, values+i, mask_all);
@@ -288,6 +383,67 @@ void clampedExpVector(float* values, int* exponents, float* output, int N) {
   }
 }
 
+// clampedExpSerial() by exponentiation by squaring: for each bit of y,
+// from the lowest, multiply the result by the base if the bit is set
+// and square the base.  This takes log2(y) steps instead of y.
+void clampedExpSquaringSerial(float* values, int* exponents, float* output, int N) {
+  for (int i=0; i<N; i++) {
+    float base = values[i];
+    float result = 1.f;
+    for (int y = exponents[i]; y > 0; y >>= 1) {
+      if (y & 1)
+        result *= base;
+      base *= base;
+    }
+    if (result > 9.999999f) {
+      result = 9.999999f;
+    }
+    output[i] = result;
+  }
+}
+
+// Vector version of clampedExpSquaringSerial().  A vector still runs
+// until its largest exponent is done, but that is now log2(y) steps.
+// There are no bitwise intrinsics, so the low bit of y is found by
+// halving y and checking whether doubling the half gives y back.
+template <int W>
+void clampedExpSquaringVector(float* values, int* exponents, float* output, int N) {
+  __cs149_vec<int, W> zero = _cs149_vset_int<W>(0);
+  __cs149_vec<int, W> two = _cs149_vset_int<W>(2);
+  __cs149_vec<float, W> maxValue = _cs149_vset_float<W>(9.999999f);
+  __cs149_vec<float, W> base, result;
+  __cs149_vec<int, W> y, half, twice;
+
+  for (int i=0; i<N; i+=W) {
+    __cs149_mask_w<W> mask = _cs149_init_ones<W>(N - i);
+    __cs149_mask_w<W> active = _cs149_init_ones<W>(0);
+    __cs149_mask_w<W> even = _cs149_init_ones<W>(0);
+    __cs149_mask_w<W> over = _cs149_init_ones<W>(0);
+    __cs149_mask_w<W> odd;
+
+    _cs149_vload_float(base, values+i, mask);
+    _cs149_vload_int(y, exponents+i, mask);
+    _cs149_vset_float(result, 1.f, mask);
+
+    _cs149_vgt_int(active, y, zero, mask);
+    while (_cs149_cntbits(active) > 0) {
+      _cs149_vdiv_int(half, y, two, active);
+      _cs149_vmult_int(twice, half, two, active);
+      _cs149_veq_int(even, twice, y, active);
+      odd = _cs149_mask_not(even);
+      odd = _cs149_mask_and(odd, active);
+      _cs149_vmult_float(result, result, base, odd);
+      _cs149_vmult_float(base, base, base, active);
+      _cs149_vmove_int(y, half, active);
+      _cs149_vgt_int(active, y, zero, active);
+    }
+
+    _cs149_vgt_float(over, result, maxValue, mask);
+    _cs149_vmove_float(result, maxValue, over);
+    _cs149_vstore_float(output+i, result, mask);
+  }
+}
+
 // returns the sum of all elements in values
 float arraySumSerial(float* values, int N) {
   float sum = 0;
@@ -301,6 +457,7 @@ float arraySumSerial(float* values, int N) {
 // returns the sum of all elements in values
 // You can assume N is a multiple of VECTOR_WIDTH
 // You can assume VECTOR_WIDTH is a power of 2
+template <int W>
 float arraySumVector(float* values, int N) {
   
   //
@@ -308,19 +465,399 @@ float arraySumVector(float* values, int N) {
   //
 
   float sum = 0;
-  __cs149_vec_float sum_array, array;
-  __cs149_mask maskall = _cs149_init_ones();
+  __cs149_vec<float, W> sum_array, array;
+  __cs149_mask_w<W> maskall = _cs149_init_ones<W>();
   _cs149_vset_float(sum_array, 0, maskall);
 
-  for (int i=0; i<N; i+=VECTOR_WIDTH) {
+  for (int i=0; i<N; i+=W) {
     _cs149_vload_float(array, values+i, maskall);
     _cs149_vadd_float(sum_array, sum_array, array, maskall);
   }
 
-  for(int i=0; i<VECTOR_WIDTH; i++) {
+  for(int i=0; i<W; i++) {
     sum += sum_array.value[i];
   }
 
   return sum;
 }
 
+
+// prints the cost model's estimate for the instructions logged since
+// the last reset
+static void printCostRow(const char* kernel) {
+  const Statistics& stats = CS149Logger.getStats();
+  printf("%16s | %12lld | %10.1f%% | %12lld | %13lld\n", kernel, stats.total_instructions,
+         stats.total_lane ? (double)stats.utilized_lane/stats.total_lane*100 : 0.0,
+         CS149Logger.costModel().cycles(), CS149Logger.costModel().criticalPath());
+  CS149Logger.reset();
+}
+
+// Runs each vector kernel on its own and reports the cost model's
+// estimated cycles and critical path, so different vectorizations can
+// be compared on estimated time rather than instruction count.
+void costReport(float* values, int* exponents, float* output, int N) {
+  printf("\n\e[1;31mCOST MODEL\e[0m\n");
+  printf("          Kernel | Instructions | Utilization |       Cycles | Critical Path\n");
+  CS149Logger.reset();
+  absVector(values, output, N);
+  printCostRow("absVector");
+  clampedExpVector(values, exponents, output, N);
+  printCostRow("clampedExpVector");
+  if (N % VECTOR_WIDTH == 0) {
+    arraySumVector(values, N);
+    printCostRow("arraySumVector");
+  }
+}
+
+// y = A x for an N x N sparse matrix in CSR format
+void spmvSerial(int rows, int* rowStart, int* cols, float* vals, float* x, float* y) {
+  for (int r=0; r<rows; r++) {
+    float sum = 0.f;
+    for (int k=rowStart[r]; k<rowStart[r+1]; k++) {
+      sum += vals[k] * x[cols[k]];
+    }
+    y[r] = sum;
+  }
+}
+
+// Each lane takes one row and walks its nonzeros, gathering the
+// column index, the matrix value and the matching element of x.
+// Lanes whose row is done sit idle until the longest row of the
+// vector is finished.
+template <int W = VECTOR_WIDTH>
+void spmvVector(int rows, int* rowStart, int* cols, float* vals, float* x, float* y) {
+  __cs149_vec<int, W> ones = _cs149_vset_int<W>(1);
+  __cs149_vec<int, W> ptr, end, col;
+  __cs149_vec<float, W> a, xv;
+
+  for (int r=0; r<rows; r+=W) {
+    __cs149_mask_w<W> maskRows = _cs149_init_ones<W>(rows - r);
+    __cs149_mask_w<W> active = _cs149_init_ones<W>(0);
+    __cs149_vec<float, W> sum = _cs149_vset_float<W>(0.f);
+
+    _cs149_vload_int(ptr, rowStart + r, maskRows);
+    _cs149_vload_int(end, rowStart + r + 1, maskRows);
+    _cs149_vlt_int(active, ptr, end, maskRows);
+    while (_cs149_cntbits(active) > 0) {
+      _cs149_vgather_int(col, cols, ptr, active);
+      _cs149_vgather_float(a, vals, ptr, active);
+      _cs149_vgather_float(xv, x, col, active);
+      _cs149_vfma_float(sum, a, xv, sum, active);
+      _cs149_vadd_int(ptr, ptr, ones, active);
+      _cs149_vlt_int(active, ptr, end, active);
+    }
+    _cs149_vstore_float(y + r, sum, maskRows);
+  }
+}
+
+// Counts how often each exponent occurs.  When two lanes hit the same
+// bin, a scatter keeps only one of their increments, so every lane
+// counts into its own copy of the bins (slot bin * W + lane) and the
+// copies are added up at the end.
+template <int W = VECTOR_WIDTH>
+void histogramVector(int* exponents, int N, int* bins) {
+  int counts[EXP_MAX * W];
+  int laneIds[W];
+  for (int i=0; i<EXP_MAX * W; i++) counts[i] = 0;
+  for (int i=0; i<W; i++) laneIds[i] = i;
+
+  __cs149_mask_w<W> maskAll = _cs149_init_ones<W>();
+  __cs149_vec<int, W> lane, e, slot, count;
+  __cs149_vec<int, W> zero = _cs149_vset_int<W>(0);
+  __cs149_vec<int, W> one = _cs149_vset_int<W>(1);
+  __cs149_vec<int, W> lastBin = _cs149_vset_int<W>(EXP_MAX - 1);
+  __cs149_vec<int, W> width = _cs149_vset_int<W>(W);
+  _cs149_vload_int(lane, laneIds, maskAll);
+
+  for (int i=0; i<N; i+=W) {
+    __cs149_mask_w<W> mask = _cs149_init_ones<W>(N - i);
+    _cs149_vload_int(e, exponents + i, mask);
+    // keep out-of-range exponents in the end bins
+    _cs149_vmax_int(e, e, zero, mask);
+    _cs149_vmin_int(e, e, lastBin, mask);
+    _cs149_vmult_int(slot, e, width, mask);
+    _cs149_vadd_int(slot, slot, lane, mask);
+    _cs149_vgather_int(count, counts, slot, mask);
+    _cs149_vadd_int(count, count, one, mask);
+    _cs149_vscatter_int(counts, slot, count, mask);
+  }
+
+  for (int b=0; b<EXP_MAX; b++) {
+    bins[b] = 0;
+    for (int l=0; l<W; l++) bins[b] += counts[b * W + l];
+  }
+}
+
+// Runs spmvVector on a random N x N matrix whose rows have 0 to 15
+// nonzeros, with every 16th row 64 long, and histogramVector on the
+// exponents, checking both against serial code.
+bool runExamples(float* values, int* exponents, int N) {
+  int* rowStart = new int[N+1];
+  rowStart[0] = 0;
+  for (int r=0; r<N; r++)
+    rowStart[r+1] = rowStart[r] + (r % 16 == 15 ? 64 : rand() % 16);
+  int nnz = rowStart[N];
+  int* cols = new int[nnz];
+  float* vals = new float[nnz];
+  for (int k=0; k<nnz; k++) {
+    cols[k] = rand() % N;
+    vals[k] = -1.f + 2.f * static_cast<float>(rand()) / RAND_MAX;
+  }
+  float* gold = new float[N];
+  float* y = new float[N];
+
+  printf("\e[1;31mSPARSE MATRIX-VECTOR\e[0m (%d nonzeros)\n", nnz);
+  CS149Logger.reset();
+  spmvSerial(N, rowStart, cols, vals, values, gold);
+  spmvVector(N, rowStart, cols, vals, values, y);
+  // the vector version fuses each multiply-add, so allow for rounding
+  bool spmvCorrect = true;
+  for (int r=0; r<N; r++) {
+    if (abs(y[r] - gold[r]) > 1e-4f * (1.f + abs(gold[r]))) {
+      printf("Wrong result in row %d: expected %f, got %f\n", r, gold[r], y[r]);
+      spmvCorrect = false;
+      break;
+    }
+  }
+  if (Logger::enabled) {
+    printf("          Kernel | Instructions | Utilization |       Cycles | Critical Path\n");
+    printCostRow("spmvVector");
+  }
+  printf(spmvCorrect ? "Passed!!!\n" : "@@@ Failed!!!\n");
+
+  printf("\n\e[1;31mHISTOGRAM\e[0m\n");
+  int binsGold[EXP_MAX] = {0}, bins[EXP_MAX];
+  for (int i=0; i<N; i++)
+    binsGold[min(max(exponents[i], 0), EXP_MAX - 1)]++;
+  histogramVector(exponents, N, bins);
+  bool histogramCorrect = true;
+  for (int b=0; b<EXP_MAX; b++) {
+    if (bins[b] != binsGold[b]) {
+      printf("Wrong count in bin %d: expected %d, got %d\n", b, binsGold[b], bins[b]);
+      histogramCorrect = false;
+    }
+  }
+  if (Logger::enabled) {
+    printf("          Kernel | Instructions | Utilization |       Cycles | Critical Path\n");
+    printCostRow("histogramVector");
+  }
+  printf(histogramCorrect ? "Passed!!!\n" : "@@@ Failed!!!\n");
+
+  delete [] rowStart;
+  delete [] cols;
+  delete [] vals;
+  delete [] gold;
+  delete [] y;
+  return spmvCorrect && histogramCorrect;
+}
+
+// prints one kernel's instruction count and utilization since the
+// last reset of the logger
+static void printSweepCell(bool ran, bool correct) {
+  const Statistics& stats = CS149Logger.getStats();
+  if (!ran) {
+    printf(" %12s %7s %4s |", "-", "-", "-");
+    return;
+  }
+  printf(" %12lld %6.1f%% %4s |", stats.total_instructions,
+         stats.total_lane ? (double)stats.utilized_lane/stats.total_lane*100 : 0.0,
+         correct ? "ok" : "FAIL");
+  CS149Logger.reset();
+}
+
+// optimized kernels, in clampedExpFast.cpp
+void clampedExpScalar(float* values, int* exponents, float* output, int N);
+void clampedExpSquaringScalar(float* values, int* exponents, float* output, int N);
+void clampedExpAvx2(float* values, int* exponents, float* output, int N);
+void clampedExpSquaringAvx2(float* values, int* exponents, float* output, int N);
+bool clampedExpAvx2Supported();
+
+typedef void (*ExpKernel)(float* values, int* exponents, float* output, int N);
+
+// exponent distributions for the benchmark, from even to heavily skewed
+static int uniformExponent(int) { return rand() % EXP_MAX; }
+static int skewedExponent(int) { return rand() % 8 == 0 ? 16 + rand() % 112 : rand() % 4; }
+static int outlierExponent(int i) { return i % 64 == 63 ? 1000 : rand() % EXP_MAX; }
+
+static const struct {
+  const char* name;
+  int (*exponent)(int i);
+} expDistributions[] = {
+  {"uniform 0-9", uniformExponent},
+  {"skewed 1/8 big", skewedExponent},
+  {"1000 every 64", outlierExponent},
+};
+
+// best of three runs, in ms
+static double timeExpKernel(ExpKernel kernel, float* values, int* exponents, float* output, int N) {
+  double best = 1e30;
+  for (int run=0; run<3; run++) {
+    double startTime = CycleTimer::currentSeconds();
+    kernel(values, exponents, output, N);
+    best = min(best, CycleTimer::currentSeconds() - startTime);
+  }
+  return best * 1000;
+}
+
+// Squaring rounds differently, and the error of both methods grows
+// with the exponent, so this is looser than verifyResult()
+static bool expMatches(float* output, float* gold, int N) {
+  for (int i=0; i<N; i++) {
+    // written as !(... <= ...) so that a NaN output is a mismatch
+    if (output[i] != gold[i] && !(abs(output[i] - gold[i]) <= 1e-5f + 1e-3f * abs(gold[i])))
+      return false;
+  }
+  return true;
+}
+
+static void printExpTime(bool ran, double ms, double baseline) {
+  if (ran)
+    printf(" %8.3f (%5.1fx) |", ms, baseline / ms);
+  else
+    printf(" %17s |", "-");
+}
+
+// Compares repeated multiplication with exponentiation by squaring on
+// exponent distributions of growing skew.  With repeated multiplication
+// a vector takes as many steps as its largest exponent, so a few large
+// exponents leave most lanes idle; squaring cuts that to log2 of the
+// largest exponent.  Reports the time of the optimized scalar and AVX2
+// kernels and, when logging is on, the CS149 instruction count and
+// utilization on the first 65536 elements.  It sets up its own N
+// elements, since it runs at a larger size than the other modes.
+bool expBenchmark(int N) {
+  float* values = new float[N+MAX_LANES];
+  int* exponents = new int[N+MAX_LANES];
+  float* gold = new float[N+MAX_LANES];
+  float* output = new float[N+MAX_LANES];
+  initValue(values, exponents, output, gold, N);
+  bool avx2 = clampedExpAvx2Supported();
+  int emulatedN = min(N, 65536);
+  int numDistributions = sizeof(expDistributions) / sizeof(expDistributions[0]);
+  bool ok = true;
+
+  printf("************************* Exponent Benchmark *************************\n");
+  printf("N = %d; best of 3 runs in ms, speedup over repeated scalar\n", N);
+  printf("    Distribution | mean y | max y |   repeated scalar |   squaring scalar |"
+         "     repeated avx2 |     squaring avx2 |\n");
+  for (int d=0; d<numDistributions; d++) {
+    long long sum = 0;
+    int maxExponent = 0;
+    for (int i=0; i<N+MAX_LANES; i++) {
+      exponents[i] = i < N ? expDistributions[d].exponent(i) : 0;
+      if (i < N) {
+        sum += exponents[i];
+        maxExponent = max(maxExponent, exponents[i]);
+      }
+    }
+    clampedExpSerial(values, exponents, gold, N);
+
+    printf("%16s | %6.1f | %5d |", expDistributions[d].name, (double)sum / N, maxExponent);
+    ExpKernel kernels[] = {clampedExpScalar, clampedExpSquaringScalar,
+                           clampedExpAvx2, clampedExpSquaringAvx2};
+    double baseline = 0;
+    bool correct = true;
+    for (int k=0; k<4; k++) {
+      bool ran = k < 2 || avx2;
+      double ms = ran ? timeExpKernel(kernels[k], values, exponents, output, N) : 0;
+      if (k == 0)
+        baseline = ms;
+      correct &= !ran || expMatches(output, gold, N);
+      printExpTime(ran, ms, baseline);
+    }
+    printf("%s\n", correct ? "" : " FAIL");
+    ok &= correct;
+  }
+
+  if (Logger::enabled) {
+    printf("\nCS149 intrinsics, first %d elements\n", emulatedN);
+    printf("    Distribution | %26s | %26s |\n", "clampedExpVector", "clampedExpSquaringVector");
+    for (int d=0; d<numDistributions; d++) {
+      for (int i=0; i<emulatedN+MAX_LANES; i++)
+        exponents[i] = i < emulatedN ? expDistributions[d].exponent(i) : 0;
+      clampedExpSerial(values, exponents, gold, emulatedN);
+
+      printf("%16s |", expDistributions[d].name);
+      CS149Logger.reset();
+      clampedExpVector(values, exponents, output, emulatedN);
+      printSweepCell(true, expMatches(output, gold, emulatedN));
+      clampedExpSquaringVector(values, exponents, output, emulatedN);
+      bool correct = expMatches(output, gold, emulatedN);
+      printSweepCell(true, correct);
+      printf("\n");
+      ok &= correct;
+    }
+  }
+
+  delete [] values;
+  delete [] exponents;
+  delete [] gold;
+  delete [] output;
+  return ok;
+}
+
+#ifndef CS149_NATIVE_SIMD
+
+// runs the three kernels at vector width W and prints a row of the table
+template <int W>
+void sweepWidth(float* values, int* exponents, float* absGold, float* expGold,
+                float sumGold, float* output, int N) {
+  printf(" %5d |", W);
+
+  CS149Logger.reset();
+  absVector<W>(values, output, N);
+  bool correct = true;
+  for (int i=0; i<N; i++)
+    correct &= output[i] == absGold[i];
+  printSweepCell(true, correct);
+
+  clampedExpVector<W>(values, exponents, output, N);
+  correct = true;
+  for (int i=0; i<N; i++)
+    correct &= abs(output[i] - expGold[i]) <= 0.00001f;
+  printSweepCell(true, correct);
+
+  // arraySumVector assumes N is a multiple of the width
+  if (N % W == 0) {
+    float sum = arraySumVector<W>(values, N);
+    printSweepCell(true, abs(sum - sumGold) < 0.2f);
+  } else {
+    printSweepCell(false, false);
+  }
+  printf("\n");
+}
+
+// Runs absVector, clampedExpVector and arraySumVector on the emulated
+// vector unit at every power of two width from 2 to 64, and reports
+// how the instruction count and lane utilization change with width.
+void widthSweep(float* values, int* exponents, int N) {
+  float* absGold = new float[N];
+  float* expGold = new float[N];
+  float* output = new float[N+MAX_LANES];
+  absSerial(values, absGold, N);
+  clampedExpSerial(values, exponents, expGold, N);
+  float sumGold = arraySumSerial(values, N);
+
+  printf("************************ Vector Width Sweep **************************\n");
+  printf("N = %d; instructions and lane utilization per kernel\n", N);
+  printf(" Width | %26s | %26s | %26s |\n", "absVector", "clampedExpVector", "arraySumVector");
+  printf("-------+----------------------------+----------------------------+----------------------------+\n");
+  sweepWidth<2>(values, exponents, absGold, expGold, sumGold, output, N);
+  sweepWidth<4>(values, exponents, absGold, expGold, sumGold, output, N);
+  sweepWidth<8>(values, exponents, absGold, expGold, sumGold, output, N);
+  sweepWidth<16>(values, exponents, absGold, expGold, sumGold, output, N);
+  sweepWidth<32>(values, exponents, absGold, expGold, sumGold, output, N);
+  sweepWidth<64>(values, exponents, absGold, expGold, sumGold, output, N);
+
+  delete [] absGold;
+  delete [] expGold;
+  delete [] output;
+}
+
+#else
+
+void widthSweep(float* values, int* exponents, int N) {
+  printf("The width sweep needs the emulated vector unit (build without SIMD=)\n");
+}
+
+#endif
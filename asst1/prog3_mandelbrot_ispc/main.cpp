@@ -1,9 +1,16 @@
 #include <stdio.h>
+#include <math.h>
 #include <algorithm>
+#include <functional>
+#include <queue>
+#include <thread>
+#include <vector>
 #include <getopt.h>
 
 #include "CycleTimer.h"
 #include "mandelbrot_ispc.h"
+#include "mandelbrotAvx.h"
+#include "mandelbrotProgressive.h"
 
 extern void mandelbrotSerial(
     float x0, float y0, float x1, float y1,
@@ -12,6 +19,13 @@ extern void mandelbrotSerial(
     int maxIterations,
     int output[]);
 
+extern void mandelbrotSerialInterior(
+    float x0, float y0, float x1, float y1,
+    int width, int height,
+    int startRow, int numRows,
+    int maxIterations,
+    int output[]);
+
 extern void mandelbrotThread(
     int numThreads,
     float x0, float y0, float x1, float y1,
@@ -60,11 +74,270 @@ scaleAndShift(float& x0, float& x1, float& y0, float& y1,
 
 using namespace ispc;
 
+// Number of cores to size tiles for: what this machine has, but at
+// least the 8 hardware threads of the myth machines.
+int tilingCores() {
+    return std::max(8u, std::thread::hardware_concurrency());
+}
+
+// Pick a tile size for mandelbrot_ispc_withtiles: about 16 tiles per
+// core, roughly square, with rows a whole number of 8-wide vectors.
+void chooseTileSize(int width, int height, int numCores,
+                    int* tileWidth, int* tileHeight) {
+    int targetTiles = 16 * std::max(1, numCores);
+    int side = std::max(1, (int)sqrtf((float)width * height / targetTiles));
+    *tileWidth = std::min(width, std::max(8, (side + 7) / 8 * 8));
+    *tileHeight = std::min(height, side);
+}
+
+// Estimated parallel efficiency of splitting the image into
+// tileWidth x tileHeight tasks, taken in launch order by numCores cores
+// that each grab the next task as soon as they're free.  Each pixel
+// costs its iteration count.  1.0 means perfectly balanced.
+double estimateEfficiency(const int* iterations, int width, int height,
+                          int tileWidth, int tileHeight, int numCores) {
+    std::priority_queue<long, std::vector<long>, std::greater<long> > coreFreeAt;
+    for (int c = 0; c < numCores; c++)
+        coreFreeAt.push(0);
+
+    long total = 0;
+    long makespan = 0;
+    for (int ty = 0; ty < height; ty += tileHeight) {
+        for (int tx = 0; tx < width; tx += tileWidth) {
+            long cost = 0;
+            for (int j = ty; j < std::min(ty + tileHeight, height); j++)
+                for (int i = tx; i < std::min(tx + tileWidth, width); i++)
+                    cost += iterations[j * width + i] + 1;
+            long finish = coreFreeAt.top() + cost;
+            coreFreeAt.pop();
+            coreFreeAt.push(finish);
+            total += cost;
+            makespan = std::max(makespan, finish);
+        }
+    }
+    return (double)total / ((double)numCores * makespan);
+}
+
+// Compare the 16-task row-block kernel with the tiled kernel across a
+// sequence of zooms toward the view 2 region, where the cost per pixel
+// gets more and more uneven.  The image size is deliberately not a
+// multiple of the tile or block size.
+int runViewSweep(int maxIterations) {
+    const int width = 1001;
+    const int height = 777;
+    const float scales[] = {1.f, .3f, .1f, .05f, .015f, .005f, .001f};
+    const int numScales = sizeof(scales) / sizeof(scales[0]);
+
+    int numCores = tilingCores();
+    int tileWidth, tileHeight;
+    chooseTileSize(width, height, numCores, &tileWidth, &tileHeight);
+    int rowsPerTask = (height + 15) / 16;
+
+    int *output_serial = new int[width*height];
+    int *output_tasks = new int[width*height];
+    int *output_tiles = new int[width*height];
+
+    printf("View sweep: %dx%d image, %dx%d tiles, efficiency estimated for %d cores\n",
+           width, height, tileWidth, tileHeight, numCores);
+    printf("%8s %12s %12s %12s %10s %10s\n",
+           "scale", "serial ms", "tasks ms", "tiles ms", "tasks eff", "tiles eff");
+
+    int status = 0;
+    for (int s = 0; s < numScales; s++) {
+        float x0 = -2, x1 = 1, y0 = -1, y1 = 1;
+        if (scales[s] != 1.f)
+            scaleAndShift(x0, x1, y0, y1, scales[s], -.986f, .30f);
+
+        double startTime = CycleTimer::currentSeconds();
+        mandelbrotSerial(x0, y0, x1, y1, width, height, 0, height, maxIterations, output_serial);
+        double serialTime = CycleTimer::currentSeconds() - startTime;
+
+        double minTasks = 1e30;
+        double minTiles = 1e30;
+        for (int i = 0; i < 3; ++i) {
+            startTime = CycleTimer::currentSeconds();
+            mandelbrot_ispc_withtasks(x0, y0, x1, y1, width, height, maxIterations, output_tasks);
+            minTasks = std::min(minTasks, CycleTimer::currentSeconds() - startTime);
+
+            startTime = CycleTimer::currentSeconds();
+            mandelbrot_ispc_withtiles(x0, y0, x1, y1, width, height, tileWidth, tileHeight,
+                                      maxIterations, output_tiles);
+            minTiles = std::min(minTiles, CycleTimer::currentSeconds() - startTime);
+        }
+
+        printf("%8.3f %12.3f %12.3f %12.3f %10.2f %10.2f\n",
+               scales[s], serialTime * 1000, minTasks * 1000, minTiles * 1000,
+               estimateEfficiency(output_serial, width, height, width, rowsPerTask, numCores),
+               estimateEfficiency(output_serial, width, height, tileWidth, tileHeight, numCores));
+
+        if (! verifyResult (output_serial, output_tasks, width, height) ||
+            ! verifyResult (output_serial, output_tiles, width, height)) {
+            printf ("Error : ISPC output differs from sequential output\n");
+            status = 1;
+            break;
+        }
+    }
+
+    delete[] output_serial;
+    delete[] output_tasks;
+    delete[] output_tiles;
+
+    return status;
+}
+
+// Fraction of lane-iterations doing useful work in a foreach kernel
+// that runs 'lanes' adjacent pixels of a row together until the
+// slowest of them is done.  Uses the same cost per pixel as the lane
+// refill kernels (iterations + 1, counting the final escape check), so
+// the two are directly comparable.
+double foreachLaneUtilization(const int* iterations, int width, int height, int lanes) {
+    long long useful = 0;
+    long long total = 0;
+    for (int j = 0; j < height; j++) {
+        for (int i = 0; i < width; i += lanes) {
+            int slowest = 0;
+            for (int k = i; k < std::min(i + lanes, width); k++) {
+                useful += iterations[j * width + k] + 1;
+                slowest = std::max(slowest, iterations[j * width + k] + 1);
+            }
+            total += (long long)lanes * slowest;
+        }
+    }
+    return (double)useful / total;
+}
+
+// Time one of the lane refill kernels, check it against the serial
+// output and report how busy its lanes were next to what a foreach
+// kernel of the same width would manage on this view.
+bool runLaneRefill(const char* name, MandelAvxKernel kernel,
+                   float x0, float y0, float x1, float y1,
+                   int width, int height, int maxIterations,
+                   const int* gold, int* output, double minSerial) {
+    MandelLaneStats stats;
+    double minTime = 1e30;
+    for (int i = 0; i < 3; ++i) {
+        for (int p = 0; p < width * height; ++p)
+            output[p] = 0;
+        double startTime = CycleTimer::currentSeconds();
+        kernel(x0, y0, x1, y1, width, height, 0, height, maxIterations, output, &stats);
+        double endTime = CycleTimer::currentSeconds();
+        minTime = std::min(minTime, endTime - startTime);
+    }
+
+    printf("[mandelbrot %s]:	[%.3f] ms	(%.2fx speedup, lanes %.1f%% busy vs %.1f%% for foreach)\n",
+           name, minTime * 1000, minSerial / minTime,
+           100. * stats.activeLaneSteps / ((double)stats.vectorSteps * stats.lanes),
+           100. * foreachLaneUtilization(gold, width, height, stats.lanes));
+
+    if (! verifyResult ((int*)gold, output, width, height)) {
+        printf ("Error : %s output differs from sequential output\n", name);
+        return false;
+    }
+    return true;
+}
+
+// Time the serial and ispc kernels with cardioid/bulb and periodicity
+// checks, and check that they produce exactly the brute-force output.
+bool runInteriorChecks(float x0, float y0, float x1, float y1,
+                       int width, int height, int maxIterations,
+                       int* gold, int* output, double minSerial, double minISPC) {
+    double minSerialInterior = 1e30;
+    double minISPCInterior = 1e30;
+
+    for (int i = 0; i < 3; ++i) {
+        double startTime = CycleTimer::currentSeconds();
+        mandelbrotSerialInterior(x0, y0, x1, y1, width, height, 0, height, maxIterations, output);
+        double endTime = CycleTimer::currentSeconds();
+        minSerialInterior = std::min(minSerialInterior, endTime - startTime);
+    }
+    printf("[mandelbrot serial interior]:\t[%.3f] ms\t(%.2fx speedup over serial)\n",
+           minSerialInterior * 1000, minSerial / minSerialInterior);
+    if (! verifyResult (gold, output, width, height)) {
+        printf ("Error : Serial output with interior checks differs from brute-force output\n");
+        return false;
+    }
+
+    for (int i = 0; i < 3; ++i) {
+        for (int p = 0; p < width * height; ++p)
+            output[p] = 0;
+        double startTime = CycleTimer::currentSeconds();
+        mandelbrot_ispc_interior(x0, y0, x1, y1, width, height, maxIterations, output);
+        double endTime = CycleTimer::currentSeconds();
+        minISPCInterior = std::min(minISPCInterior, endTime - startTime);
+    }
+    printf("[mandelbrot ispc interior]:\t[%.3f] ms\t(%.2fx speedup over ispc)\n",
+           minISPCInterior * 1000, minISPC / minISPCInterior);
+    if (! verifyResult (gold, output, width, height)) {
+        printf ("Error : ISPC output with interior checks differs from brute-force output\n");
+        return false;
+    }
+    return true;
+}
+
+// ispc's export header declares the points kernel with int32_t
+void mandelbrotIspcPoints(float x0, float y0, float x1, float y1,
+                          int width, int height, int maxIterations,
+                          const int points[], int numPoints, int output[]) {
+    mandelbrot_ispc_points(x0, y0, x1, y1, width, height, maxIterations,
+                           points, numPoints, output);
+}
+
+void recordFirstPass(int pass, const int output[], void* arg) {
+    if (pass == 0)
+        *(double*)arg = CycleTimer::currentSeconds();
+}
+
+// Render progressively with the given points kernel, report how soon
+// the coarse image was ready and how much of the image had to be
+// iterated, and compare the final image with the full render.  Single
+// pixels that float rounding lets escape in the middle of a uniform
+// region can't be found without iterating them, so a few (well under
+// 1 in 10000) may differ; anything more means a real bug.
+bool runProgressive(const char* name, MandelPointsKernel kernel,
+                    float x0, float y0, float x1, float y1,
+                    int width, int height, int maxIterations,
+                    int* gold, int* output, double minFull) {
+    const int blockSize = 32;
+    ProgressiveStats stats;
+    double minTime = 1e30, minFirstPass = 1e30;
+
+    for (int i = 0; i < 3; ++i) {
+        for (int p = 0; p < width * height; ++p)
+            output[p] = 0;
+        double firstPassTime = 0;
+        double startTime = CycleTimer::currentSeconds();
+        mandelbrotProgressive(kernel, x0, y0, x1, y1, width, height, maxIterations,
+                              blockSize, output, &stats, recordFirstPass, &firstPassTime);
+        double endTime = CycleTimer::currentSeconds();
+        minTime = std::min(minTime, endTime - startTime);
+        minFirstPass = std::min(minFirstPass, firstPassTime - startTime);
+    }
+
+    int mismatches = 0;
+    for (int p = 0; p < width * height; ++p)
+        if (gold[p] != output[p])
+            mismatches++;
+
+    printf("[mandelbrot %s]:\t[%.3f] ms\t(%.2fx speedup, coarse image after %.3f ms, "
+           "%d passes, %.1f%% of pixels iterated, %d differ)\n",
+           name, minTime * 1000, minFull / minTime, minFirstPass * 1000, stats.passes,
+           100. * stats.pixelsComputed / ((double)width * height), mismatches);
+
+    if (mismatches > width * height / 10000) {
+        printf ("Error : %s output differs from full render\n", name);
+        return false;
+    }
+    return true;
+}
+
 void usage(const char* progname) {
     printf("Usage: %s [options]\n", progname);
     printf("Program Options:\n");
     printf("  -t  --tasks        Run ISPC code implementation with tasks\n");
     printf("  -v  --view <INT>   Use specified view settings\n");
+    printf("  -s  --sweep        Compare task load balance across zoom levels\n");
+    printf("  -i  --interior     Also run kernels with interior and periodicity checks\n");
+    printf("  -p  --progressive  Also run progressive (Mariani-Silver) renderers\n");
     printf("  -?  --help         This message\n");
 }
 
@@ -81,17 +354,23 @@ int main(int argc, char** argv) {
     float y1 = 1;
 
     bool useTasks = false;
+    bool runSweep = false;
+    bool useInterior = false;
+    bool useProgressive = false;
 
     // parse commandline options ////////////////////////////////////////////
     int opt;
     static struct option long_options[] = {
         {"tasks", 0, 0, 't'},
         {"view",  1, 0, 'v'},
+        {"sweep", 0, 0, 's'},
+        {"interior", 0, 0, 'i'},
+        {"progressive", 0, 0, 'p'},
         {"help",  0, 0, '?'},
         {0 ,0, 0, 0}
     };
 
-    while ((opt = getopt_long(argc, argv, "tv:?", long_options, NULL)) != EOF) {
+    while ((opt = getopt_long(argc, argv, "tv:sip?", long_options, NULL)) != EOF) {
 
         switch (opt) {
         case 't':
@@ -112,6 +391,15 @@ int main(int argc, char** argv) {
             }
             break;
         }
+        case 's':
+            runSweep = true;
+            break;
+        case 'i':
+            useInterior = true;
+            break;
+        case 'p':
+            useProgressive = true;
+            break;
         case '?':
         default:
             usage(argv[0]);
@@ -120,6 +408,9 @@ int main(int argc, char** argv) {
     }
     // end parsing of commandline options
 
+    if (runSweep)
+        return runViewSweep(maxIterations);
+
     int *output_serial = new int[width*height];
     int *output_ispc = new int[width*height];
     int *output_ispc_tasks = new int[width*height];
@@ -179,12 +470,48 @@ int main(int argc, char** argv) {
         return 1;
     }
 
+    //
+    // Hand-written AVX kernels that refill finished lanes with new pixels
+    //
+    bool ok = runLaneRefill("avx2 refill", mandelbrotAvx2, x0, y0, x1, y1,
+                            width, height, maxIterations,
+                            output_serial, output_ispc_tasks, minSerial);
+    if (ok && mandelbrotAvx512Supported())
+        ok = runLaneRefill("avx512 refill", mandelbrotAvx512, x0, y0, x1, y1,
+                           width, height, maxIterations,
+                           output_serial, output_ispc_tasks, minSerial);
+    //
+    // Interior and periodicity checks
+    //
+    if (ok && useInterior)
+        ok = runInteriorChecks(x0, y0, x1, y1, width, height, maxIterations,
+                               output_serial, output_ispc_tasks, minSerial, minISPC);
+    //
+    // Progressive rendering by rectangle subdivision
+    //
+    if (ok && useProgressive)
+        ok = runProgressive("serial progressive", mandelbrotSerialPoints, x0, y0, x1, y1,
+                            width, height, maxIterations,
+                            output_serial, output_ispc_tasks, minSerial);
+    if (ok && useProgressive)
+        ok = runProgressive("ispc progressive", mandelbrotIspcPoints, x0, y0, x1, y1,
+                            width, height, maxIterations,
+                            output_serial, output_ispc_tasks, minISPC);
+    if (!ok) {
+        delete[] output_serial;
+        delete[] output_ispc;
+        delete[] output_ispc_tasks;
+
+        return 1;
+    }
+
     // Clear out the buffer
     for (unsigned int i = 0; i < width * height; ++i) {
         output_ispc_tasks[i] = 0;
     }
 
     double minTaskISPC = 1e30;
+    double minTileISPC = 1e30;
     if (useTasks) {
         //
         // Tasking version of the ISPC code
@@ -203,11 +530,36 @@ int main(int argc, char** argv) {
             printf ("Error : ISPC output differs from sequential output\n");
             return 1;
         }
+
+        //
+        // Dynamically scheduled 2D tiles
+        //
+        int tileWidth, tileHeight;
+        chooseTileSize(width, height, tilingCores(), &tileWidth, &tileHeight);
+        for (unsigned int i = 0; i < width * height; ++i) {
+            output_ispc_tasks[i] = 0;
+        }
+        for (int i = 0; i < 3; ++i) {
+            double startTime = CycleTimer::currentSeconds();
+            mandelbrot_ispc_withtiles(x0, y0, x1, y1, width, height, tileWidth, tileHeight,
+                                      maxIterations, output_ispc_tasks);
+            double endTime = CycleTimer::currentSeconds();
+            minTileISPC = std::min(minTileISPC, endTime - startTime);
+        }
+
+        printf("[mandelbrot tiled ispc]:\t[%.3f] ms\t(%dx%d tiles)\n",
+               minTileISPC * 1000, tileWidth, tileHeight);
+
+        if (! verifyResult (output_serial, output_ispc_tasks, width, height)) {
+            printf ("Error : ISPC output differs from sequential output\n");
+            return 1;
+        }
     }
 
     printf("\t\t\t\t(%.2fx speedup from ISPC)\n", minSerial/minISPC);
     if (useTasks) {
         printf("\t\t\t\t(%.2fx speedup from task ISPC)\n", minSerial/minTaskISPC);
+        printf("\t\t\t\t(%.2fx speedup from tiled ISPC)\n", minSerial/minTileISPC);
     }
 
     delete[] output_serial;
@@ -0,0 +1,230 @@
+#include <immintrin.h>
+
+#include "mandelbrotAvx.h"
+
+// Hand-vectorized mandelbrot kernels.  Unlike mandelbrotSerial() and
+// the ispc foreach kernel, where a vector keeps iterating until the
+// slowest of its pixels escapes, each lane here works on its own pixel:
+// as soon as a lane's pixel is done, its count is written out and the
+// lane picks up the next pixel of the image.  Lanes only sit idle at
+// the very end, when there are no pixels left to hand out.
+//
+// The arithmetic is done in the same order as mandelbrotSerial(), and
+// without FMA, so the output matches it exactly.
+//
+// The AVX2 and AVX-512 versions are compiled with per-function target
+// attributes, so this file builds without -mavx2; callers check
+// mandelbrotAvx512Supported(), which asks CPUID, before using AVX-512.
+
+// Pixels of rows [startRow, startRow + numRows) are handed out in
+// row-major order; pixel p is at row startRow + p / width, column
+// p % width.
+
+__attribute__((target("avx2")))
+void mandelbrotAvx2(
+    float x0, float y0, float x1, float y1,
+    int width, int height,
+    int startRow, int numRows,
+    int maxIterations,
+    int output[],
+    MandelLaneStats* stats)
+{
+    const int LANES = 8;
+    float dx = (x1 - x0) / width;
+    float dy = (y1 - y0) / height;
+    int numPixels = width * numRows;
+    int nextPixel = 0;
+
+    alignas(32) float cRe[LANES], cIm[LANES], zRe[LANES], zIm[LANES];
+    alignas(32) int iter[LANES], pixel[LANES], active[LANES];
+
+    // Loads the next pixel into 'lane', or retires the lane if there
+    // are no pixels left.
+    auto refill = [&](int lane) {
+        if (nextPixel < numPixels) {
+            int p = nextPixel++;
+            int i = p % width;
+            int j = startRow + p / width;
+            cRe[lane] = zRe[lane] = x0 + i * dx;
+            cIm[lane] = zIm[lane] = y0 + j * dy;
+            iter[lane] = 0;
+            pixel[lane] = p;
+            active[lane] = -1;
+        } else {
+            cRe[lane] = zRe[lane] = 0.f;
+            cIm[lane] = zIm[lane] = 0.f;
+            iter[lane] = 0;
+            pixel[lane] = -1;
+            active[lane] = 0;
+        }
+    };
+
+    for (int lane = 0; lane < LANES; lane++)
+        refill(lane);
+
+    __m256 c_re = _mm256_load_ps(cRe), c_im = _mm256_load_ps(cIm);
+    __m256 z_re = _mm256_load_ps(zRe), z_im = _mm256_load_ps(zIm);
+    __m256i count = _mm256_load_si256((__m256i*)iter);
+    __m256i live = _mm256_load_si256((__m256i*)active);
+
+    const __m256 four = _mm256_set1_ps(4.f);
+    const __m256 two = _mm256_set1_ps(2.f);
+    const __m256i maxIter = _mm256_set1_epi32(maxIterations);
+    const __m256i one = _mm256_set1_epi32(1);
+
+    long long vectorSteps = 0, activeLaneSteps = 0;
+    int liveMask = _mm256_movemask_ps(_mm256_castsi256_ps(live));
+
+    while (liveMask != 0) {
+        vectorSteps++;
+        activeLaneSteps += __builtin_popcount(liveMask);
+
+        // a lane is done when its pixel hits the iteration limit or
+        // escapes, exactly as in mandel()
+        __m256 mag = _mm256_add_ps(_mm256_mul_ps(z_re, z_re), _mm256_mul_ps(z_im, z_im));
+        __m256 escaped = _mm256_cmp_ps(mag, four, _CMP_GT_OQ);
+        __m256i atLimit = _mm256_cmpeq_epi32(count, maxIter);
+        __m256 done = _mm256_and_ps(_mm256_or_ps(escaped, _mm256_castsi256_ps(atLimit)),
+                                    _mm256_castsi256_ps(live));
+        int doneMask = _mm256_movemask_ps(done);
+
+        // every lane takes its next step; lanes that just finished are
+        // overwritten by the refill below
+        __m256 new_re = _mm256_sub_ps(_mm256_mul_ps(z_re, z_re), _mm256_mul_ps(z_im, z_im));
+        __m256 new_im = _mm256_mul_ps(_mm256_mul_ps(two, z_re), z_im);
+        z_re = _mm256_add_ps(c_re, new_re);
+        z_im = _mm256_add_ps(c_im, new_im);
+        __m256i next = _mm256_add_epi32(count, one);
+
+        if (doneMask != 0) {
+            _mm256_store_si256((__m256i*)iter, count);
+            for (int m = doneMask; m != 0; m &= m - 1) {
+                int lane = __builtin_ctz(m);
+                output[startRow * width + pixel[lane]] = iter[lane];
+            }
+            _mm256_store_ps(cRe, c_re);
+            _mm256_store_ps(cIm, c_im);
+            _mm256_store_ps(zRe, z_re);
+            _mm256_store_ps(zIm, z_im);
+            _mm256_store_si256((__m256i*)iter, next);
+            _mm256_store_si256((__m256i*)active, live);
+            for (int m = doneMask; m != 0; m &= m - 1)
+                refill(__builtin_ctz(m));
+            c_re = _mm256_load_ps(cRe);
+            c_im = _mm256_load_ps(cIm);
+            z_re = _mm256_load_ps(zRe);
+            z_im = _mm256_load_ps(zIm);
+            next = _mm256_load_si256((__m256i*)iter);
+            live = _mm256_load_si256((__m256i*)active);
+            liveMask = _mm256_movemask_ps(_mm256_castsi256_ps(live));
+        }
+        count = next;
+    }
+
+    if (stats) {
+        stats->vectorSteps = vectorSteps;
+        stats->activeLaneSteps = activeLaneSteps;
+        stats->lanes = LANES;
+    }
+}
+
+__attribute__((target("avx512f")))
+void mandelbrotAvx512(
+    float x0, float y0, float x1, float y1,
+    int width, int height,
+    int startRow, int numRows,
+    int maxIterations,
+    int output[],
+    MandelLaneStats* stats)
+{
+    const int LANES = 16;
+    float dx = (x1 - x0) / width;
+    float dy = (y1 - y0) / height;
+    int numPixels = width * numRows;
+    int nextPixel = 0;
+
+    alignas(64) float cRe[LANES], cIm[LANES], zRe[LANES], zIm[LANES];
+    alignas(64) int iter[LANES], pixel[LANES];
+    __mmask16 live = 0;
+
+    auto refill = [&](int lane) {
+        if (nextPixel < numPixels) {
+            int p = nextPixel++;
+            int i = p % width;
+            int j = startRow + p / width;
+            cRe[lane] = zRe[lane] = x0 + i * dx;
+            cIm[lane] = zIm[lane] = y0 + j * dy;
+            iter[lane] = 0;
+            pixel[lane] = p;
+            live |= (__mmask16)(1 << lane);
+        } else {
+            cRe[lane] = zRe[lane] = 0.f;
+            cIm[lane] = zIm[lane] = 0.f;
+            iter[lane] = 0;
+            pixel[lane] = -1;
+            live &= (__mmask16)~(1 << lane);
+        }
+    };
+
+    for (int lane = 0; lane < LANES; lane++)
+        refill(lane);
+
+    __m512 c_re = _mm512_load_ps(cRe), c_im = _mm512_load_ps(cIm);
+    __m512 z_re = _mm512_load_ps(zRe), z_im = _mm512_load_ps(zIm);
+    __m512i count = _mm512_load_si512(iter);
+
+    const __m512 four = _mm512_set1_ps(4.f);
+    const __m512 two = _mm512_set1_ps(2.f);
+    const __m512i maxIter = _mm512_set1_epi32(maxIterations);
+    const __m512i one = _mm512_set1_epi32(1);
+
+    long long vectorSteps = 0, activeLaneSteps = 0;
+
+    while (live != 0) {
+        vectorSteps++;
+        activeLaneSteps += __builtin_popcount(live);
+
+        __m512 mag = _mm512_add_ps(_mm512_mul_ps(z_re, z_re), _mm512_mul_ps(z_im, z_im));
+        __mmask16 done = (_mm512_cmp_ps_mask(mag, four, _CMP_GT_OQ) |
+                          _mm512_cmpeq_epi32_mask(count, maxIter)) & live;
+
+        __m512 new_re = _mm512_sub_ps(_mm512_mul_ps(z_re, z_re), _mm512_mul_ps(z_im, z_im));
+        __m512 new_im = _mm512_mul_ps(_mm512_mul_ps(two, z_re), z_im);
+        z_re = _mm512_add_ps(c_re, new_re);
+        z_im = _mm512_add_ps(c_im, new_im);
+        __m512i next = _mm512_add_epi32(count, one);
+
+        if (done != 0) {
+            _mm512_store_si512(iter, count);
+            for (unsigned int m = done; m != 0; m &= m - 1) {
+                int lane = __builtin_ctz(m);
+                output[startRow * width + pixel[lane]] = iter[lane];
+            }
+            _mm512_store_ps(cRe, c_re);
+            _mm512_store_ps(cIm, c_im);
+            _mm512_store_ps(zRe, z_re);
+            _mm512_store_ps(zIm, z_im);
+            _mm512_store_si512(iter, next);
+            for (unsigned int m = done; m != 0; m &= m - 1)
+                refill(__builtin_ctz(m));
+            c_re = _mm512_load_ps(cRe);
+            c_im = _mm512_load_ps(cIm);
+            z_re = _mm512_load_ps(zRe);
+            z_im = _mm512_load_ps(zIm);
+            next = _mm512_load_si512(iter);
+        }
+        count = next;
+    }
+
+    if (stats) {
+        stats->vectorSteps = vectorSteps;
+        stats->activeLaneSteps = activeLaneSteps;
+        stats->lanes = LANES;
+    }
+}
+
+bool mandelbrotAvx512Supported() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx512f");
+}
+
@@ -0,0 +1,42 @@
+#ifndef _MANDELBROT_AVX_H_
+#define _MANDELBROT_AVX_H_
+
+// Hand-vectorized, lane-refilling mandelbrot kernels; see
+// mandelbrotAvx.cpp.
+
+// Useful work is one lane-step per iteration plus one for the final
+// check of each pixel, the same as foreachLaneUtilization() in main.cpp.
+struct MandelLaneStats {
+    long long vectorSteps;      // iterations of the vector loop
+    long long activeLaneSteps;  // useful lane-steps, summed over steps
+    int lanes;                  // vector width used
+};
+
+typedef void (*MandelAvxKernel)(
+    float x0, float y0, float x1, float y1,
+    int width, int height,
+    int startRow, int numRows,
+    int maxIterations,
+    int output[],
+    MandelLaneStats* stats);
+
+void mandelbrotAvx2(
+    float x0, float y0, float x1, float y1,
+    int width, int height,
+    int startRow, int numRows,
+    int maxIterations,
+    int output[],
+    MandelLaneStats* stats);
+
+// Only call this where mandelbrotAvx512Supported() is true.
+void mandelbrotAvx512(
+    float x0, float y0, float x1, float y1,
+    int width, int height,
+    int startRow, int numRows,
+    int maxIterations,
+    int output[],
+    MandelLaneStats* stats);
+
+bool mandelbrotAvx512Supported();
+
+#endif // _MANDELBROT_AVX_H_
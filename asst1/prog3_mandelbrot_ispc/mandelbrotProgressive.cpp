@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <vector>
+
+#include "mandelbrotProgressive.h"
+
+// Progressive rendering by Mariani-Silver subdivision.
+//
+// The image is covered by square blocks whose edges lie on a coarse
+// grid.  Each pass computes the pixels on the edges of the current
+// blocks (one call to the points kernel for all of them), then looks
+// at each block: if every pixel on its edge has the same count, the
+// inside is filled with that count without iterating, since the set
+// and its escape-time bands are connected.  Otherwise the block is cut
+// into four, and the new edges are computed in the next pass.  Blocks
+// too small to be worth splitting are computed outright.
+//
+// After every pass the inside of each unresolved block holds the count
+// of its top-left corner, so the output is a complete, gradually
+// sharper image that can be shown right away.
+//
+// Filling relies on features being at least a pixel wide where they
+// cross a block's edge.  A filament thinner than that, or a lone pixel
+// that float rounding lets escape inside the set, is filled over, so a
+// handful of pixels can differ from a full render.
+
+namespace {
+
+// inclusive pixel bounds
+struct Block {
+    int x0, y0, x1, y1;
+};
+
+// blocks with no more than this many pixels inside are computed outright
+const int MIN_SPLIT_INTERIOR = 16;
+
+}
+
+void mandelbrotProgressive(
+    MandelPointsKernel kernel,
+    float x0, float y0, float x1, float y1,
+    int width, int height,
+    int maxIterations,
+    int blockSize,
+    int output[],
+    ProgressiveStats* stats,
+    ProgressivePassCallback onPass, void* arg)
+{
+    std::vector<char> known(width * height, 0);
+    std::vector<int> points;
+    std::vector<Block> blocks, next;
+
+    ProgressiveStats s = {0, 0, 0};
+
+    for (int by = 0; by < height - 1 || by == 0; by += blockSize) {
+        for (int bx = 0; bx < width - 1 || bx == 0; bx += blockSize) {
+            Block b = {bx, by, std::min(bx + blockSize, width - 1),
+                       std::min(by + blockSize, height - 1)};
+            blocks.push_back(b);
+        }
+    }
+
+    auto addPoint = [&](int i, int j) {
+        int index = j * width + i;
+        if (!known[index]) {
+            known[index] = 1;
+            points.push_back(index);
+        }
+    };
+
+    while (!blocks.empty()) {
+        // compute every edge pixel not already known
+        points.clear();
+        for (const Block& b : blocks) {
+            for (int i = b.x0; i <= b.x1; i++) {
+                addPoint(i, b.y0);
+                addPoint(i, b.y1);
+            }
+            for (int j = b.y0 + 1; j < b.y1; j++) {
+                addPoint(b.x0, j);
+                addPoint(b.x1, j);
+            }
+        }
+        kernel(x0, y0, x1, y1, width, height, maxIterations,
+               points.data(), (int)points.size(), output);
+        s.pixelsComputed += points.size();
+
+        // fill, split or finish off each block
+        next.clear();
+        points.clear();
+        for (const Block& b : blocks) {
+            int innerWidth = b.x1 - b.x0 - 1;
+            int innerHeight = b.y1 - b.y0 - 1;
+            if (innerWidth <= 0 || innerHeight <= 0)
+                continue;
+
+            int value = output[b.y0 * width + b.x0];
+            bool uniform = true;
+            for (int i = b.x0; i <= b.x1 && uniform; i++)
+                uniform = output[b.y0 * width + i] == value && output[b.y1 * width + i] == value;
+            for (int j = b.y0 + 1; j < b.y1 && uniform; j++)
+                uniform = output[j * width + b.x0] == value && output[j * width + b.x1] == value;
+
+            if (uniform) {
+                for (int j = b.y0 + 1; j < b.y1; j++) {
+                    for (int i = b.x0 + 1; i < b.x1; i++) {
+                        output[j * width + i] = value;
+                        known[j * width + i] = 1;
+                    }
+                }
+                s.pixelsFilled += innerWidth * innerHeight;
+            } else if (innerWidth * innerHeight <= MIN_SPLIT_INTERIOR) {
+                for (int j = b.y0 + 1; j < b.y1; j++)
+                    for (int i = b.x0 + 1; i < b.x1; i++)
+                        addPoint(i, j);
+            } else {
+                // coarse preview of the still-unknown inside
+                for (int j = b.y0 + 1; j < b.y1; j++)
+                    for (int i = b.x0 + 1; i < b.x1; i++)
+                        if (!known[j * width + i])
+                            output[j * width + i] = value;
+
+                int mx = (b.x0 + b.x1) / 2;
+                int my = (b.y0 + b.y1) / 2;
+                Block quarters[4] = {{b.x0, b.y0, mx, my}, {mx, b.y0, b.x1, my},
+                                     {b.x0, my, mx, b.y1}, {mx, my, b.x1, b.y1}};
+                next.insert(next.end(), quarters, quarters + 4);
+            }
+        }
+        if (!points.empty()) {
+            kernel(x0, y0, x1, y1, width, height, maxIterations,
+                   points.data(), (int)points.size(), output);
+            s.pixelsComputed += points.size();
+        }
+
+        if (onPass)
+            onPass(s.passes, output, arg);
+        s.passes++;
+        blocks.swap(next);
+    }
+
+    if (stats)
+        *stats = s;
+}
@@ -0,0 +1,42 @@
+#ifndef _MANDELBROT_PROGRESSIVE_H_
+#define _MANDELBROT_PROGRESSIVE_H_
+
+// Progressive rendering by Mariani-Silver subdivision; see
+// mandelbrotProgressive.cpp.
+
+// Computes the numPoints pixels listed in points[] (as j * width + i).
+typedef void (*MandelPointsKernel)(
+    float x0, float y0, float x1, float y1,
+    int width, int height,
+    int maxIterations,
+    const int points[], int numPoints,
+    int output[]);
+
+struct ProgressiveStats {
+    int passes;
+    long long pixelsComputed;   // pixels actually iterated
+    long long pixelsFilled;     // pixels filled from a uniform edge
+};
+
+// Called after every pass with the complete image so far.
+typedef void (*ProgressivePassCallback)(int pass, const int output[], void* arg);
+
+void mandelbrotProgressive(
+    MandelPointsKernel kernel,
+    float x0, float y0, float x1, float y1,
+    int width, int height,
+    int maxIterations,
+    int blockSize,
+    int output[],
+    ProgressiveStats* stats,
+    ProgressivePassCallback onPass, void* arg);
+
+// The serial points kernel, in mandelbrotSerial.cpp.
+void mandelbrotSerialPoints(
+    float x0, float y0, float x1, float y1,
+    int width, int height,
+    int maxIterations,
+    const int points[], int numPoints,
+    int output[]);
+
+#endif // _MANDELBROT_PROGRESSIVE_H_
@@ -56,6 +56,48 @@ static inline int mandel(float c_re, float c_im, int count)
     return i;
 }
 
+// Same result as mandel(), but points inside the main cardioid or the
+// period-2 bulb are answered without iterating, and orbits that land
+// exactly on an earlier value (Brent's method: compare against a saved
+// value that is refreshed at doubling intervals) are known to cycle
+// forever.  Equality is exact, so a detected cycle is one the float
+// iteration really repeats and would never escape from.
+static inline int mandelInterior(float c_re, float c_im, int count)
+{
+    float q_re = c_re - .25f;
+    float q = q_re * q_re + c_im * c_im;
+    if (q * (q + q_re) < .25f * c_im * c_im)
+        return count;
+    if ((c_re + 1.f) * (c_re + 1.f) + c_im * c_im < .0625f)
+        return count;
+
+    float z_re = c_re, z_im = c_im;
+    float saved_re = z_re, saved_im = z_im;
+    int period = 0, checkEvery = 8;
+    int i;
+    for (i = 0; i < count; ++i) {
+
+        if (z_re * z_re + z_im * z_im > 4.f)
+            break;
+
+        float new_re = z_re*z_re - z_im*z_im;
+        float new_im = 2.f * z_re * z_im;
+        z_re = c_re + new_re;
+        z_im = c_im + new_im;
+
+        if (z_re == saved_re && z_im == saved_im)
+            return count;
+        if (++period == checkEvery) {
+            period = 0;
+            checkEvery *= 2;
+            saved_re = z_re;
+            saved_im = z_im;
+        }
+    }
+
+    return i;
+}
+
 //
 // MandelbrotSerial --
 //
@@ -90,3 +132,57 @@ void mandelbrotSerial(
     }
 }
 
+//
+// MandelbrotSerialPoints --
+//
+// Like mandelbrotSerial(), but only computes the numPoints pixels
+// listed in points[] (as j * width + i), for renderers that decide
+// pixel by pixel what needs computing.
+void mandelbrotSerialPoints(
+    float x0, float y0, float x1, float y1,
+    int width, int height,
+    int maxIterations,
+    const int points[], int numPoints,
+    int output[])
+{
+    float dx = (x1 - x0) / width;
+    float dy = (y1 - y0) / height;
+
+    for (int k = 0; k < numPoints; k++) {
+        int index = points[k];
+        int j = index / width;
+        int i = index - j * width;
+        float x = x0 + i * dx;
+        float y = y0 + j * dy;
+
+        output[index] = mandel(x, y, maxIterations);
+    }
+}
+
+//
+// MandelbrotSerialInterior --
+//
+// mandelbrotSerial() with the interior and periodicity checks of
+// mandelInterior().  Produces the same output.
+void mandelbrotSerialInterior(
+    float x0, float y0, float x1, float y1,
+    int width, int height,
+    int startRow, int totalRows,
+    int maxIterations,
+    int output[])
+{
+    float dx = (x1 - x0) / width;
+    float dy = (y1 - y0) / height;
+
+    int endRow = startRow + totalRows;
+
+    for (int j = startRow; j < endRow; j++) {
+        for (int i = 0; i < width; ++i) {
+            float x = x0 + i * dx;
+            float y = y0 + j * dy;
+
+            int index = (j * width + i);
+            output[index] = mandelInterior(x, y, maxIterations);
+        }
+    }
+}
@@ -1,16 +1,17 @@
 #include <stdio.h>
 #include <algorithm>
+#include <getopt.h>
 #include <pthread.h>
+#include <string.h>
 #include <math.h>
+#include <thread>
 
 #include "CycleTimer.h"
 #include "sqrt_ispc.h"
+#include "sqrtKernels.h"
 
 using namespace ispc;
 
-extern void sqrtSerial(int N, float startGuess, float* values, float* output);
-extern void sqrtAvx(int N, float initialGuess, float* values, float* outputna);
-
 static void verifyResult(int N, float* result, float* gold) {
     for (int i=0; i<N; i++) {
         if (fabs(result[i] - gold[i]) > 1e-4) {
@@ -19,10 +20,261 @@ static void verifyResult(int N, float* result, float* gold) {
     }
 }
 
-int main() {
+static const char* inputNames[] = {"uniform", "best", "worst"};
+static const int NUM_INPUTS = 3;
+
+// Fills values with one of the input distributions:
+//   uniform  random values in [0.001, 2.999], as in the starter code
+//   best     every value 2.999, so all lanes take the same, large
+//            number of Newton steps
+//   worst    one value in eight is 2.999 and the rest are 1, which
+//            converge at once, so each 8-wide vector does the work of
+//            its slowest lane while the other seven idle
+static void initValues(int input, unsigned int N, float* values) {
+    for (unsigned int i=0; i<N; i++)
+    {
+        if (input == 1)
+            values[i] = 2.999f;
+        else if (input == 2)
+            values[i] = i % 8 == 0 ? 2.999f : 1.f;
+        else
+            values[i] = 0.001 + 2.998 * static_cast<float>(rand()) / RAND_MAX;
+    }
+}
+
+template <typename F>
+static double minTime(F run) {
+    double minRun = 1e30;
+    for (int i = 0; i < 3; ++i) {
+        double startTime = CycleTimer::currentSeconds();
+        run();
+        double endTime = CycleTimer::currentSeconds();
+        minRun = std::min(minRun, endTime - startTime);
+    }
+    return minRun;
+}
+
+// Times the serial, AVX and threaded AVX versions on every input
+// distribution, showing how far dynamic chunking evens out the
+// uneven per-element cost across threads.
+static void runBenchmark(unsigned int N, int numThreads, float initialGuess,
+                         float* values, float* output, float* gold) {
+    printf("N = %u, %d threads; min of 3 runs in ms\n", N, numThreads);
+    printf("  Input |    Serial |       AVX |  AVX threads |  (AVX speedup, threads over AVX)\n");
+    for (int input = 0; input < NUM_INPUTS; input++) {
+        initValues(input, N, values);
+        for (unsigned int i=0; i<N; i++)
+            gold[i] = sqrt(values[i]);
+
+        double minSerial = minTime([&] { sqrtSerial(N, initialGuess, values, output); });
+        verifyResult(N, output, gold);
+        double minAvx = minTime([&] { sqrtAvx(N, initialGuess, values, output); });
+        verifyResult(N, output, gold);
+        double minThreads = minTime([&] {
+            sqrtAvxThreads(numThreads, N, initialGuess, values, output); });
+        verifyResult(N, output, gold);
+
+        printf("%7s | %9.3f | %9.3f | %12.3f |  (%.2fx, %.2fx)\n", inputNames[input],
+               minSerial * 1000, minAvx * 1000, minThreads * 1000,
+               minSerial / minAvx, minAvx / minThreads);
+    }
+}
 
-    const unsigned int N = 20 * 1000 * 1000;
+// Starting guesses, as defined in sqrtSerial.cpp
+static const char* seedNames[] = {"constant", "bits", "rsqrt"};
+static const int NUM_SEEDS = 3;
+static const int MAX_STEPS = 64;
+
+// Compares the constant starting guess with the bit-trick and rsqrt
+// estimates: prints how many Newton steps elements take under each,
+// how many an 8-wide vector takes (the most of its lanes), and the
+// time of the serial, ispc and AVX kernels.
+static void runSeedComparison(unsigned int N, float initialGuess,
+                              float* values, float* output, float* gold) {
+    int* iterations = new int[N];
+    long long histogram[NUM_SEEDS][MAX_STEPS + 1] = {};
+    double elementSteps[NUM_SEEDS], vectorSteps[NUM_SEEDS];
+    int maxSteps = 0;
+
+    for (int seed = 0; seed < NUM_SEEDS; seed++) {
+        sqrtSerialSeeded(N, seed, initialGuess, values, output, iterations);
+        verifyResult(N, output, gold);
+
+        long long total = 0, vectorTotal = 0;
+        for (unsigned int i=0; i<N; i+=8) {
+            int slowest = 0;
+            for (unsigned int j=i; j<std::min(N, i+8); j++) {
+                int steps = std::min(iterations[j], MAX_STEPS);
+                histogram[seed][steps]++;
+                total += iterations[j];
+                slowest = std::max(slowest, iterations[j]);
+            }
+            vectorTotal += slowest;
+            maxSteps = std::max(maxSteps, slowest);
+        }
+        elementSteps[seed] = (double)total / N;
+        vectorSteps[seed] = (double)vectorTotal / ((N + 7) / 8);
+    }
+
+    printf("Newton steps per element\n");
+    printf("  Steps | %12s | %12s | %12s |\n", seedNames[0], seedNames[1], seedNames[2]);
+    for (int steps = 0; steps <= std::min(maxSteps, MAX_STEPS); steps++) {
+        if (histogram[0][steps] + histogram[1][steps] + histogram[2][steps] == 0)
+            continue;
+        printf(steps == MAX_STEPS ? "  %4d+ |" : "  %5d |", steps);
+        for (int seed = 0; seed < NUM_SEEDS; seed++)
+            printf(" %12lld |", histogram[seed][steps]);
+        printf("\n");
+    }
+    printf("   Mean |");
+    for (int seed = 0; seed < NUM_SEEDS; seed++)
+        printf(" %12.2f |", elementSteps[seed]);
+    printf("\n Vector |");
+    for (int seed = 0; seed < NUM_SEEDS; seed++)
+        printf(" %12.2f |", vectorSteps[seed]);
+    printf("  (mean of the slowest lane of each 8)\n");
+
+    printf("\nmin of 3 runs in ms\n");
+    printf("    Seed |    Serial |      ISPC |       AVX\n");
+    for (int seed = 0; seed < NUM_SEEDS; seed++) {
+        double minSerial = minTime([&] {
+            sqrtSerialSeeded(N, seed, initialGuess, values, output, NULL); });
+        verifyResult(N, output, gold);
+        double minISPC = minTime([&] { sqrt_ispc_seeded(N, seed, initialGuess, values, output); });
+        verifyResult(N, output, gold);
+        double minAvx = minTime([&] { sqrtAvxSeeded(N, seed, initialGuess, values, output); });
+        verifyResult(N, output, gold);
+        printf("%8s | %9.3f | %9.3f | %9.3f\n", seedNames[seed],
+               minSerial * 1000, minISPC * 1000, minAvx * 1000);
+    }
+
+    delete [] iterations;
+}
+
+static void printStreamRow(const char* name, unsigned int N, double seconds,
+                           double utilization) {
+    printf("%16s | %9.3f | %10.1f | %10.1f%%\n", name, seconds * 1000,
+           N / seconds / 1e6, utilization * 100);
+}
+
+// Compares sqrtAvx(), where a vector runs until its slowest lane is
+// done, with the streaming kernels, which refill each lane as soon as
+// its element converges.  Run it on the worst input (-i worst) to see
+// the difference.  Utilization is useful lane-steps over lane-steps
+// executed; for sqrtAvx() it comes from the step counts of each element.
+static void runStreamComparison(unsigned int N, float initialGuess,
+                                float* values, float* output, float* gold) {
+    int* iterations = new int[N];
+    sqrtSerialSeeded(N, SEED_CONSTANT, initialGuess, values, output, iterations);
+    long long useful = 0, executed = 0;
+    for (unsigned int i=0; i<N; i+=8) {
+        int slowest = 0;
+        for (unsigned int j=i; j<std::min(N, i+8); j++) {
+            useful += iterations[j];
+            slowest = std::max(slowest, iterations[j]);
+        }
+        executed += 8 * slowest;
+    }
+    delete [] iterations;
+
+    printf("min of 3 runs\n");
+    printf("          Kernel |        ms | M elems/s | Utilization\n");
+
+    double minAvx = minTime([&] { sqrtAvx(N, initialGuess, values, output); });
+    verifyResult(N, output, gold);
+    printStreamRow("avx", N, minAvx, executed ? (double)useful / executed : 1.0);
+
+    SqrtLaneStats stats;
+    double minStream = minTime([&] {
+        sqrtStreamAvx2(N, SEED_CONSTANT, initialGuess, values, output, &stats); });
+    verifyResult(N, output, gold);
+    printStreamRow("avx2 stream", N, minStream, stats.vectorSteps ?
+                   (double)stats.activeLaneSteps / (stats.vectorSteps * stats.lanes) : 1.0);
+
+    if (sqrtStreamAvx512Supported()) {
+        double minStream512 = minTime([&] {
+            sqrtStreamAvx512(N, SEED_CONSTANT, initialGuess, values, output, &stats); });
+        verifyResult(N, output, gold);
+        printStreamRow("avx512 stream", N, minStream512, stats.vectorSteps ?
+                       (double)stats.activeLaneSteps / (stats.vectorSteps * stats.lanes) : 1.0);
+    }
+}
+
+static void usage(const char* progname) {
+    printf("Usage: %s [options]\n", progname);
+    printf("Program Options:\n");
+    printf("  -i  --input <NAME>  Input values: uniform (default), best or worst\n");
+    printf("  -s  --size <N>      Number of elements (Default = 20M)\n");
+    printf("  -t  --threads <N>   Threads for the threaded AVX version, 1 to %d (Default = all cores)\n", SQRT_MAX_THREADS);
+    printf("  -b  --bench         Compare serial, AVX and threaded AVX on every input\n");
+    printf("  -g  --seeds         Compare Newton steps and times for each starting guess\n");
+    printf("  -c  --compact       Compare sqrtAvx with the lane-refilling streaming kernels\n");
+    printf("  -?  --help          This message\n");
+}
+
+int main(int argc, char** argv) {
+
+    unsigned int N = 20 * 1000 * 1000;
     const float initialGuess = 1.0f;
+    int input = 0;
+    int numThreads = std::min(SQRT_MAX_THREADS, (int)std::max(1u, std::thread::hardware_concurrency()));
+    bool runBench = false;
+    bool runSeeds = false;
+    bool runStream = false;
+
+    // parse commandline options ////////////////////////////////////////////
+    int opt;
+    static struct option long_options[] = {
+        {"input", 1, 0, 'i'},
+        {"size", 1, 0, 's'},
+        {"threads", 1, 0, 't'},
+        {"bench", 0, 0, 'b'},
+        {"seeds", 0, 0, 'g'},
+        {"compact", 0, 0, 'c'},
+        {"help", 0, 0, '?'},
+        {0 ,0, 0, 0}
+    };
+
+    while ((opt = getopt_long(argc, argv, "i:s:t:bgc?", long_options, NULL)) != EOF) {
+
+        switch (opt) {
+        case 'i':
+            for (input = 0; input < NUM_INPUTS && strcmp(optarg, inputNames[input]) != 0; input++);
+            if (input == NUM_INPUTS) {
+                fprintf(stderr, "Unknown input %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 's':
+            if (atoi(optarg) <= 0) {
+                fprintf(stderr, "Invalid size %s\n", optarg);
+                return 1;
+            }
+            N = atoi(optarg);
+            break;
+        case 't':
+            numThreads = atoi(optarg);
+            if (numThreads < 1 || numThreads > SQRT_MAX_THREADS) {
+                fprintf(stderr, "Invalid thread count %s (1 to %d)\n", optarg, SQRT_MAX_THREADS);
+                return 1;
+            }
+            break;
+        case 'b':
+            runBench = true;
+            break;
+        case 'g':
+            runSeeds = true;
+            break;
+        case 'c':
+            runStream = true;
+            break;
+        case '?':
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    // end parsing of commandline options
 
     float* values = new float[N];
     float* output = new float[N];
@@ -30,20 +282,31 @@ int main() {
 
     srand(time(NULL));
 
-    for (unsigned int i=0; i<N; i++)
-    {
-        // TODO: CS149 students.  Attempt to change the values in the
-        // array here to meet the instructions in the handout: we want
-        // to you generate best and worse-case speedups
-        
-        // starter code populates array with random input values
-        values[i] = 0.001 + 2.998 * static_cast<float>(rand()) / RAND_MAX;
+    if (runBench) {
+        runBenchmark(N, numThreads, initialGuess, values, output, gold);
+        delete [] values;
+        delete [] output;
+        delete [] gold;
+        return 0;
     }
 
+    initValues(input, N, values);
+
     // generate a gold version to check results
     for (unsigned int i=0; i<N; i++)
         gold[i] = sqrt(values[i]);
 
+    if (runSeeds || runStream) {
+        if (runSeeds)
+            runSeedComparison(N, initialGuess, values, output, gold);
+        if (runStream)
+            runStreamComparison(N, initialGuess, values, output, gold);
+        delete [] values;
+        delete [] output;
+        delete [] gold;
+        return 0;
+    }
+
     //
     // And run the serial implementation 3 times, again reporting the
     // minimum time.
@@ -95,6 +358,20 @@ int main() {
 
     verifyResult(N, output, gold);
 
+    // Clear out the buffer
+    for (unsigned int i = 0; i < N; ++i)
+        output[i] = 0;
+
+    //
+    // Multi-threaded version of the AVX code
+    //
+    double minAvxThreads = minTime([&] {
+        sqrtAvxThreads(numThreads, N, initialGuess, values, output); });
+
+    printf("[sqrt avx threads]:\t[%.3f] ms\t(%d threads)\n", minAvxThreads * 1000, numThreads);
+
+    verifyResult(N, output, gold);
+
     // Clear out the buffer
     for (unsigned int i = 0; i < N; ++i)
         output[i] = 0;
@@ -116,6 +393,7 @@ int main() {
     printf("\t\t\t\t(%.2fx speedup from ISPC)\n", minSerial/minISPC);
     printf("\t\t\t\t(%.2fx speedup from task ISPC)\n", minSerial/minTaskISPC);
     printf("\t\t\t\t(%.2fx speedup from AVX)\n", minSerial/minAvx);
+    printf("\t\t\t\t(%.2fx speedup from AVX threads)\n", minSerial/minAvxThreads);
 
     delete [] values;
     delete [] output;
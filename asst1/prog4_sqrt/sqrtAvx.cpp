@@ -3,19 +3,42 @@
 #include <immintrin.h>
 #include <omp.h>
 
-void sqrtAvx(int N,
-                   float initialGuess,
-                   float values[],
-                   float output[])
+#include <algorithm>
+#include <atomic>
+
+#include "ThreadPool.h"
+#include "sqrtKernels.h"
+
+static const float kThreshold = 0.00001f;
+
+static inline __m256 seedGuess(int seed, float initialGuess, __m256 x) {
+    if (seed == SEED_BITS)
+        return _mm256_castsi256_ps(_mm256_sub_epi32(_mm256_set1_epi32(0x5f3759df),
+                                   _mm256_srli_epi32(_mm256_castps_si256(x), 1)));
+    if (seed == SEED_RSQRT)
+        return _mm256_rsqrt_ps(x);
+    return _mm256_set1_ps(initialGuess);
+}
+
+static inline float seedGuess(int seed, float initialGuess, float x) {
+    return _mm256_cvtss_f32(seedGuess(seed, initialGuess, _mm256_set1_ps(x)));
+}
+
+// Computes elements [start, end), eight at a time and then one at a
+// time for the last few.
+static void sqrtAvxRange(int start, int end,
+                         int seed,
+                         float initialGuess,
+                         float values[],
+                         float output[])
 {
-    static const float kThreshold = 0.00001f;
-    int alignedN = N & ~0x7;
+    int alignedEnd = start + ((end - start) & ~0x7);
 
-    for(int i=0; i<alignedN; i+=8) {
+    for(int i=start; i<alignedEnd; i+=8) {
         
         __m256 x_vec = _mm256_loadu_ps(values+i);
         __m256 thresh = _mm256_set1_ps(kThreshold);
-        __m256 guess = _mm256_set1_ps(initialGuess);
+        __m256 guess = seedGuess(seed, initialGuess, x_vec);
 
         __m256 error = _mm256_andnot_ps(
             _mm256_set1_ps(-0.0f),
@@ -47,11 +70,11 @@ void sqrtAvx(int N,
         _mm256_storeu_ps(output+i, _mm256_mul_ps(x_vec, guess));
     }
 
-    if(alignedN < N) {
+    if(alignedEnd < end) {
 
-        for (int i=alignedN; i<N; i++) {
+        for (int i=alignedEnd; i<end; i++) {
             float x = values[i];
-            float guess = initialGuess;
+            float guess = seedGuess(seed, initialGuess, x);
             float error = fabs(guess * guess * x - 1.f);
 
             while (error > kThreshold) {
@@ -62,4 +85,55 @@ void sqrtAvx(int N,
             output[i] = x * guess;
         }
     }
-}
\ No newline at end of file
+}
+
+void sqrtAvx(int N,
+                   float initialGuess,
+                   float values[],
+                   float output[])
+{
+    sqrtAvxRange(0, N, SEED_CONSTANT, initialGuess, values, output);
+}
+
+// sqrtAvx() with a choice of starting guess (see sqrtSerialSeeded())
+void sqrtAvxSeeded(int N,
+                   int seed,
+                   float initialGuess,
+                   float values[],
+                   float output[])
+{
+    sqrtAvxRange(0, N, seed, initialGuess, values, output);
+}
+
+//
+// sqrtAvxThreads --
+//
+// sqrtAvx() on numThreads threads of a persistent pool (see
+// ThreadPool.h), the calling thread included, so no threads are created
+// inside the timed region after the first call.  The
+// number of Newton steps depends on the input value, so equal shares of
+// the array can take very different times.  Instead, threads claim
+// CHUNK elements at a time from an atomic counter until none are left,
+// and a thread that lands on cheap elements simply claims more chunks.
+// A chunk of input and output (32 KB) stays in the L1/L2 caches while
+// it is worked on.
+void sqrtAvxThreads(int numThreads,
+                    int N,
+                    float initialGuess,
+                    float values[],
+                    float output[])
+{
+    static const int CHUNK = 4096;
+    static ThreadPool pool;
+
+    std::atomic<int> nextChunk(0);
+    int numChunks = (N + CHUNK - 1) / CHUNK;
+    pool.run(numThreads, [&](int, int) {
+        int chunk;
+        while ((chunk = nextChunk.fetch_add(1)) < numChunks) {
+            int start = chunk * CHUNK;
+            sqrtAvxRange(start, std::min(N, start + CHUNK), SEED_CONSTANT, initialGuess,
+                         values, output);
+        }
+    });
+}
@@ -0,0 +1,234 @@
+#include <immintrin.h>
+
+#include "sqrtKernels.h"
+
+// Streaming sqrt kernels.  sqrtAvx() keeps iterating on a vector of
+// eight elements until the slowest of them converges, so on inputs
+// where a few elements need many more Newton steps than the rest, most
+// lanes sit idle.  Here each lane works on its own element: as soon as
+// an element converges its result is written out and the lane is
+// refilled with the next element of the input.  The refill loads the
+// next k elements in one go and spreads them into the k finished
+// lanes.  Lanes only sit idle at the very end, when there are no
+// elements left to hand out.
+//
+// An element is checked for convergence before its first Newton step
+// and after each one, as in sqrtAvx().  The compiler may fuse different
+// multiply-adds here than there, so the last bit of a result can differ.
+//
+// The AVX2 and AVX-512 versions are compiled with per-function target
+// attributes; callers check sqrtStreamAvx512Supported(), which asks
+// CPUID, before using AVX-512.
+
+static const float kThreshold = 0.00001f;
+
+// For each 8-bit mask of finished lanes, which of the newly loaded
+// elements each finished lane takes: the number of finished lanes
+// below it.
+struct RefillTable {
+    alignas(32) int offsets[256][8];
+
+    RefillTable() {
+        for (int mask = 0; mask < 256; mask++) {
+            int next = 0;
+            for (int lane = 0; lane < 8; lane++)
+                offsets[mask][lane] = (mask >> lane) & 1 ? next++ : 0;
+        }
+    }
+};
+
+__attribute__((target("avx2")))
+static inline __m256 seedGuess8(int seed, __m256 initialGuess, __m256 x) {
+    if (seed == SEED_BITS)
+        return _mm256_castsi256_ps(_mm256_sub_epi32(_mm256_set1_epi32(0x5f3759df),
+                                   _mm256_srli_epi32(_mm256_castps_si256(x), 1)));
+    if (seed == SEED_RSQRT)
+        return _mm256_rsqrt_ps(x);
+    return initialGuess;
+}
+
+__attribute__((target("avx2")))
+void sqrtStreamAvx2(int N,
+                    int seed,
+                    float initialGuess,
+                    float values[],
+                    float output[],
+                    SqrtLaneStats* stats)
+{
+    const int LANES = 8;
+    static const RefillTable table;
+
+    const __m256 thresh = _mm256_set1_ps(kThreshold);
+    const __m256 one = _mm256_set1_ps(1.f);
+    const __m256 three = _mm256_set1_ps(3.f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 signBit = _mm256_set1_ps(-0.f);
+    const __m256 guess0 = _mm256_set1_ps(initialGuess);
+    const __m256i laneIds = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i laneBits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+
+    // dead lanes hold x = 1 and guess = 1, which never need a step
+    __m256 x = one, guess = one;
+    __m256i index = _mm256_setzero_si256();
+    int liveMask = 0;
+    int doneMask = (1 << LANES) - 1;
+    int next = 0;
+
+    long long vectorSteps = 0, activeLaneSteps = 0;
+    alignas(32) float result[LANES];
+    alignas(32) int where[LANES];
+
+    while (true) {
+        if (doneMask != 0) {
+            // write out the finished elements
+            if (doneMask & liveMask) {
+                _mm256_store_ps(result, _mm256_mul_ps(x, guess));
+                _mm256_store_si256((__m256i*)where, index);
+                for (int m = doneMask & liveMask; m != 0; m &= m - 1) {
+                    int lane = __builtin_ctz(m);
+                    output[where[lane]] = result[lane];
+                }
+            }
+
+            // the k-th finished lane takes element next + k, if there
+            // is one, and the rest of the finished lanes go dead
+            __m256i offset = _mm256_load_si256((const __m256i*)table.offsets[doneMask]);
+            __m256i done = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(doneMask), laneBits), laneBits);
+            __m256i refill = _mm256_and_si256(done, _mm256_cmpgt_epi32(_mm256_set1_epi32(N - next), offset));
+            __m256 refillPs = _mm256_castsi256_ps(refill);
+            __m256 dead = _mm256_castsi256_ps(_mm256_andnot_si256(refill, done));
+            int refillMask = _mm256_movemask_ps(refillPs);
+
+            __m256i inRange = _mm256_cmpgt_epi32(_mm256_set1_epi32(N - next), laneIds);
+            __m256 newX = _mm256_permutevar8x32_ps(_mm256_maskload_ps(values + next, inRange), offset);
+
+            x = _mm256_blendv_ps(x, newX, refillPs);
+            guess = _mm256_blendv_ps(guess, seedGuess8(seed, guess0, newX), refillPs);
+            x = _mm256_blendv_ps(x, one, dead);
+            guess = _mm256_blendv_ps(guess, one, dead);
+            index = _mm256_blendv_epi8(index, _mm256_add_epi32(_mm256_set1_epi32(next), offset), refill);
+
+            liveMask = (liveMask & ~doneMask) | refillMask;
+            next += __builtin_popcount(refillMask);
+            if (liveMask == 0)
+                break;
+        }
+
+        __m256 error = _mm256_andnot_ps(signBit,
+            _mm256_sub_ps(_mm256_mul_ps(_mm256_mul_ps(guess, guess), x), one));
+        int pending = _mm256_movemask_ps(_mm256_cmp_ps(error, thresh, _CMP_GT_OQ));
+        doneMask = liveMask & ~pending;
+
+        // re-check refilled lanes before stepping: some start converged
+        if (doneMask != 0)
+            continue;
+
+        vectorSteps++;
+        activeLaneSteps += __builtin_popcount(liveMask);
+        guess = _mm256_mul_ps(half, _mm256_sub_ps(_mm256_mul_ps(three, guess),
+                              _mm256_mul_ps(x, _mm256_mul_ps(guess, _mm256_mul_ps(guess, guess)))));
+    }
+
+    if (stats) {
+        stats->vectorSteps = vectorSteps;
+        stats->activeLaneSteps = activeLaneSteps;
+        stats->lanes = LANES;
+    }
+}
+
+__attribute__((target("avx512f")))
+static inline __m512 seedGuess16(int seed, __m512 initialGuess, __m512 x) {
+    if (seed == SEED_BITS)
+        return _mm512_castsi512_ps(_mm512_sub_epi32(_mm512_set1_epi32(0x5f3759df),
+                                   _mm512_maskz_srli_epi32(0xffff, _mm512_castps_si512(x), 1)));
+    if (seed == SEED_RSQRT)
+        return _mm512_maskz_rsqrt14_ps(0xffff, x);
+    return initialGuess;
+}
+
+// The same as sqrtStreamAvx2(), but AVX-512 has the refill built in:
+// an expanding load puts the next k elements into the k finished lanes,
+// and a scatter writes the finished results out.  The rsqrt seed is
+// the more precise rsqrt14 estimate, so it may need fewer steps.
+__attribute__((target("avx512f")))
+void sqrtStreamAvx512(int N,
+                      int seed,
+                      float initialGuess,
+                      float values[],
+                      float output[],
+                      SqrtLaneStats* stats)
+{
+    const int LANES = 16;
+
+    const __m512 thresh = _mm512_set1_ps(kThreshold);
+    const __m512 one = _mm512_set1_ps(1.f);
+    const __m512 three = _mm512_set1_ps(3.f);
+    const __m512 half = _mm512_set1_ps(0.5f);
+    const __m512 guess0 = _mm512_set1_ps(initialGuess);
+    const __m512i laneIds = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7,
+                                              8, 9, 10, 11, 12, 13, 14, 15);
+
+    // dead lanes hold x = 1 and guess = 1, which never need a step
+    __m512 x = one, guess = one;
+    __m512i index = _mm512_setzero_si512();
+    __mmask16 liveMask = 0;
+    __mmask16 doneMask = 0xffff;
+    int next = 0;
+
+    long long vectorSteps = 0, activeLaneSteps = 0;
+
+    while (true) {
+        if (doneMask != 0) {
+            _mm512_mask_i32scatter_ps(output, doneMask & liveMask, index, _mm512_mul_ps(x, guess), 4);
+
+            // keep only as many of the finished lanes as there are
+            // elements left
+            __mmask16 refillMask = doneMask;
+            int remaining = N - next;
+            if (remaining < __builtin_popcount(refillMask)) {
+                refillMask = 0;
+                for (int m = doneMask, k = 0; m != 0 && k < remaining; m &= m - 1, k++)
+                    refillMask |= m & -m;
+            }
+            __mmask16 deadMask = doneMask & ~refillMask;
+
+            __m512 newX = _mm512_maskz_expandloadu_ps(refillMask, values + next);
+            x = _mm512_mask_blend_ps(refillMask, x, newX);
+            guess = _mm512_mask_blend_ps(refillMask, guess, seedGuess16(seed, guess0, newX));
+            x = _mm512_mask_blend_ps(deadMask, x, one);
+            guess = _mm512_mask_blend_ps(deadMask, guess, one);
+            index = _mm512_mask_expand_epi32(index, refillMask,
+                                             _mm512_add_epi32(_mm512_set1_epi32(next), laneIds));
+
+            liveMask = (liveMask & ~doneMask) | refillMask;
+            next += __builtin_popcount(refillMask);
+            if (liveMask == 0)
+                break;
+        }
+
+        __m512 error = _mm512_abs_ps(_mm512_sub_ps(_mm512_mul_ps(_mm512_mul_ps(guess, guess), x), one));
+        __mmask16 pending = _mm512_cmp_ps_mask(error, thresh, _CMP_GT_OQ);
+        doneMask = liveMask & ~pending;
+
+        // re-check refilled lanes before stepping: some start converged
+        if (doneMask != 0)
+            continue;
+
+        vectorSteps++;
+        activeLaneSteps += __builtin_popcount(liveMask);
+        guess = _mm512_mul_ps(half, _mm512_sub_ps(_mm512_mul_ps(three, guess),
+                              _mm512_mul_ps(x, _mm512_mul_ps(guess, _mm512_mul_ps(guess, guess)))));
+    }
+
+    if (stats) {
+        stats->vectorSteps = vectorSteps;
+        stats->activeLaneSteps = activeLaneSteps;
+        stats->lanes = LANES;
+    }
+}
+
+bool sqrtStreamAvx512Supported() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx512f");
+}
+
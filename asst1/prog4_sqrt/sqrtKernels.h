@@ -0,0 +1,43 @@
+#ifndef _SQRT_KERNELS_H_
+#define _SQRT_KERNELS_H_
+
+// Starting guesses for 1/sqrt(x), selected by the seed argument of the
+// *Seeded kernels:
+//   SEED_CONSTANT  initialGuess for every element, as in sqrtSerial()
+//   SEED_BITS      halve the exponent with integer arithmetic on the
+//                  bits of x (0x5f3759df - (bits >> 1)), within 3.5%
+//   SEED_RSQRT     the rsqrtss hardware estimate, within 1.5 * 2^-12
+// With either estimate Newton converges in 1-3 steps for any x instead
+// of taking longer the further x is from 1 / initialGuess^2.
+#define SEED_CONSTANT 0
+#define SEED_BITS     1
+#define SEED_RSQRT    2
+
+// sqrtSerial.cpp
+void sqrtSerial(int N, float initialGuess, float values[], float output[]);
+void sqrtSerialSeeded(int N, int seed, float initialGuess, float values[], float output[],
+                      int iterations[]);
+
+// sqrtAvx.cpp
+void sqrtAvx(int N, float initialGuess, float values[], float output[]);
+void sqrtAvxSeeded(int N, int seed, float initialGuess, float values[], float output[]);
+// numThreads is 1 to SQRT_MAX_THREADS.
+#define SQRT_MAX_THREADS 64
+void sqrtAvxThreads(int numThreads, int N, float initialGuess, float values[], float output[]);
+
+// Useful work is one lane-step per Newton step of an element.
+struct SqrtLaneStats {
+    long long vectorSteps;      // Newton steps of the vector loop
+    long long activeLaneSteps;  // useful lane-steps, summed over steps
+    int lanes;                  // vector width used
+};
+
+// sqrtAvxStream.cpp; only call sqrtStreamAvx512() where
+// sqrtStreamAvx512Supported() is true.
+void sqrtStreamAvx2(int N, int seed, float initialGuess, float values[], float output[],
+                    SqrtLaneStats* stats);
+void sqrtStreamAvx512(int N, int seed, float initialGuess, float values[], float output[],
+                      SqrtLaneStats* stats);
+bool sqrtStreamAvx512Supported();
+
+#endif // _SQRT_KERNELS_H_
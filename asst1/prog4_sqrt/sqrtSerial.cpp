@@ -1,6 +1,10 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <immintrin.h>
+
+#include "sqrtKernels.h"
 
 
 void sqrtSerial(int N,
@@ -27,3 +31,49 @@ void sqrtSerial(int N,
     }
 }
 
+// The SEED_* starting guesses are described in sqrtKernels.h.
+static inline float seedGuess(int seed, float initialGuess, float x) {
+    if (seed == SEED_BITS) {
+        int bits;
+        memcpy(&bits, &x, sizeof(bits));
+        bits = 0x5f3759df - (bits >> 1);
+        float guess;
+        memcpy(&guess, &bits, sizeof(guess));
+        return guess;
+    }
+    if (seed == SEED_RSQRT)
+        return _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(x)));
+    return initialGuess;
+}
+
+// sqrtSerial() with a choice of starting guess.  If iterations is not
+// NULL, it receives the number of Newton steps each element took.
+void sqrtSerialSeeded(int N,
+                      int seed,
+                      float initialGuess,
+                      float values[],
+                      float output[],
+                      int iterations[])
+{
+
+    static const float kThreshold = 0.00001f;
+
+    for (int i=0; i<N; i++) {
+
+        float x = values[i];
+        float guess = seedGuess(seed, initialGuess, x);
+        int steps = 0;
+
+        float error = fabs(guess * guess * x - 1.f);
+
+        while (error > kThreshold) {
+            guess = (3.f * guess - x * guess * guess * guess) * 0.5f;
+            error = fabs(guess * guess * x - 1.f);
+            steps++;
+        }
+
+        output[i] = x * guess;
+        if (iterations)
+            iterations[i] = steps;
+    }
+}
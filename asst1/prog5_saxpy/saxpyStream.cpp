@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <algorithm>
+
+#include <sys/mman.h>
+#include <immintrin.h>
+
+#include "CycleTimer.h"
+#include "ThreadPool.h"
+
+// Bandwidth-bound saxpy.  saxpy moves 12 bytes per element (load X and
+// Y, store result) but a plain store first reads the result's cache
+// line in (read-for-ownership), so it really moves 16.  The kernels here
+// use non-temporal stores, which write whole lines straight to memory
+// without reading them, and so take the memory system's full bandwidth.
+//
+// The buffers are 2 MB aligned and backed by huge pages when the system
+// has them, to save TLB misses on the long streams.  They are touched
+// first by the same pool thread that later works on each part of them,
+// so on a NUMA machine each thread's pages land on its own node.  For
+// that to hold, the pool threads are pinned and always get the same
+// slice of the arrays.
+
+static const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+static size_t bufferBytes(int N) {
+    size_t bytes = (size_t)N * sizeof(float);
+    return (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+}
+
+//
+// saxpyStreamAlloc --
+//
+// Returns a buffer of N floats, or NULL.  It comes from the explicit
+// huge page pool if one is configured, and otherwise from ordinary
+// pages marked for transparent huge pages.  No page is touched, so
+// saxpyStreamInit() gets to place them.
+float* saxpyStreamAlloc(int N, bool* hugePages) {
+    size_t bytes = bufferBytes(N);
+    void* p = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED) {
+        if (hugePages) *hugePages = true;
+        return (float*)p;
+    }
+
+    // map an extra huge page so the buffer can start on a 2 MB boundary
+    size_t mapped = bytes + HUGE_PAGE_SIZE;
+    p = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        return NULL;
+    char* start = (char*)(((size_t)p + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+    if (start > (char*)p)
+        munmap(p, start - (char*)p);
+    munmap(start + bytes, (char*)p + mapped - (start + bytes));
+    madvise(start, bytes, MADV_HUGEPAGE);
+    if (hugePages) *hugePages = false;
+    return (float*)start;
+}
+
+void saxpyStreamFree(float* buffer, int N) {
+    if (buffer)
+        munmap(buffer, bufferBytes(N));
+}
+
+// Pool threads are pinned and the caller only waits, so the same
+// pinned thread always works on the same slice.
+static ThreadPool pool(false, true);
+
+// Thread threadId's slice of N elements.  Boundaries fall on 16 floats,
+// a 64-byte line, so no two threads write the same line and every slice
+// but the last is a whole number of lines.
+static void sliceOf(int threadId, int numThreads, int N, int* start, int* end) {
+    int lines = (N + 15) / 16;
+    *start = std::min(N, (int)((long long)lines * threadId / numThreads) * 16);
+    *end = std::min(N, (int)((long long)lines * (threadId + 1) / numThreads) * 16);
+}
+
+//
+// saxpyStreamInit --
+//
+// Fills X and Y with 0, 1, 2, ... (as main() does for its arrays) and
+// zeroes result, each thread writing its own slice so the pages are
+// first touched where saxpyStream() will use them.
+void saxpyStreamInit(int numThreads, int N, float X[], float Y[], float result[]) {
+    pool.run(numThreads, [=](int threadId, int numThreads) {
+        int start, end;
+        sliceOf(threadId, numThreads, N, &start, &end);
+        for (int i = start; i < end; i++) {
+            X[i] = i;
+            Y[i] = i;
+            result[i] = 0.f;
+        }
+    });
+}
+
+// result[i] = scale * X[i] + Y[i] for [start, end), storing around the
+// caches.  Inputs and result must be 16-byte aligned at start.
+static void saxpyRange(int start, int end, float scale, float X[], float Y[], float result[]) {
+    __m128 s = _mm_set1_ps(scale);
+    int i = start;
+    for (; i + 4 <= end; i += 4)
+        _mm_stream_ps(result + i, _mm_add_ps(_mm_mul_ps(s, _mm_load_ps(X + i)), _mm_load_ps(Y + i)));
+    for (; i < end; i++)
+        result[i] = scale * X[i] + Y[i];
+}
+
+//
+// saxpyStream --
+//
+// saxpy on the pool with non-temporal stores.  The arrays should come
+// from saxpyStreamAlloc() and be set up by saxpyStreamInit() with the
+// same numThreads.
+void saxpyStream(int numThreads, int N, float scale, float X[], float Y[], float result[]) {
+    pool.run(numThreads, [=](int threadId, int numThreads) {
+        int start, end;
+        sliceOf(threadId, numThreads, N, &start, &end);
+        saxpyRange(start, end, scale, X, Y, result);
+        // make the streamed lines visible before the pool reports done
+        _mm_sfence();
+    });
+}
+
+// The four STREAM kernels over [start, end), storing around the caches
+// as saxpyRange() does, with the scalar 3.
+static void streamCopy(int start, int end, float a[], float b[], float c[]) {
+    int i = start;
+    for (; i + 4 <= end; i += 4)
+        _mm_stream_ps(c + i, _mm_load_ps(a + i));
+    for (; i < end; i++)
+        c[i] = a[i];
+}
+
+static void streamScale(int start, int end, float a[], float b[], float c[]) {
+    __m128 s = _mm_set1_ps(3.f);
+    int i = start;
+    for (; i + 4 <= end; i += 4)
+        _mm_stream_ps(b + i, _mm_mul_ps(s, _mm_load_ps(c + i)));
+    for (; i < end; i++)
+        b[i] = 3.f * c[i];
+}
+
+static void streamAdd(int start, int end, float a[], float b[], float c[]) {
+    int i = start;
+    for (; i + 4 <= end; i += 4)
+        _mm_stream_ps(c + i, _mm_add_ps(_mm_load_ps(a + i), _mm_load_ps(b + i)));
+    for (; i < end; i++)
+        c[i] = a[i] + b[i];
+}
+
+static void streamTriad(int start, int end, float a[], float b[], float c[]) {
+    saxpyRange(start, end, 3.f, c, b, a);
+}
+
+//
+// streamPeak --
+//
+// Measures the STREAM copy, scale, add and triad kernels on the pool
+// with non-temporal stores, and returns the best rate in GB/s (2^30
+// bytes, as main() counts them); rates gets all four.  As in STREAM,
+// bytes are those read plus those written, with no read-for-ownership,
+// so saxpy (a triad) moves 12 bytes per element.  a, b and c are
+// clobbered.
+double streamPeak(int numThreads, int N, float a[], float b[], float c[], double rates[4]) {
+    typedef void (*StreamKernel)(int, int, float[], float[], float[]);
+    const StreamKernel kernels[] = {streamCopy, streamScale, streamAdd, streamTriad};
+    const int arraysMoved[] = {2, 2, 3, 3};
+    double best = 0;
+
+    for (int k = 0; k < 4; k++) {
+        StreamKernel kernel = kernels[k];
+        double minTime = 1e30;
+        for (int run = 0; run < 5; run++) {
+            double startTime = CycleTimer::currentSeconds();
+            pool.run(numThreads, [=](int threadId, int numThreads) {
+                int start, end;
+                sliceOf(threadId, numThreads, N, &start, &end);
+                kernel(start, end, a, b, c);
+                _mm_sfence();
+            });
+            minTime = std::min(minTime, CycleTimer::currentSeconds() - startTime);
+        }
+        double rate = (double)arraysMoved[k] * N * sizeof(float) / (1024. * 1024. * 1024.) / minTime;
+        if (rates)
+            rates[k] = rate;
+        best = std::max(best, rate);
+    }
+    return best;
+}
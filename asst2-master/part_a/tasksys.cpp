@@ -4,6 +4,7 @@
 #include <vector>
 #include <atomic>
 #include <queue>
+#include <algorithm>
 
 
 IRunnable::~IRunnable() {}
@@ -11,6 +12,74 @@ IRunnable::~IRunnable() {}
 ITaskSystem::ITaskSystem(int num_threads) : _num_threads(num_threads) {}
 ITaskSystem::~ITaskSystem() {}
 
+IRunnable3D::~IRunnable3D() {}
+
+/*
+ * ================================================================
+ * Multidimensional launches
+ * ================================================================
+ */
+
+// Interleaves the bits of x and y (x in the even bits) to give the
+// position of (x, y) along a Z-order curve.
+static unsigned long long mortonKey2D(unsigned int x, unsigned int y) {
+    unsigned long long key = 0;
+    for (int bit = 0; bit < 32; bit++) {
+        key |= (unsigned long long)((x >> bit) & 1) << (2 * bit);
+        key |= (unsigned long long)((y >> bit) & 1) << (2 * bit + 1);
+    }
+    return key;
+}
+
+/*
+ * Flattens a multidimensional launch into a 1D one: flat task i runs
+ * the i'th coordinate of the chosen ordering.
+ */
+class Runnable3DAdapter: public IRunnable {
+    public:
+        Runnable3DAdapter(IRunnable3D* runnable, TaskIndex3D count, TaskOrder order)
+          : runnable_(runnable), count_(count) {
+            indices_.reserve(count.x * count.y * count.z);
+            for (int z = 0; z < count.z; z++) {
+                for (int y = 0; y < count.y; y++) {
+                    for (int x = 0; x < count.x; x++) {
+                        TaskIndex3D index = {x, y, z};
+                        indices_.push_back(index);
+                    }
+                }
+            }
+            if (order == TASK_ORDER_MORTON) {
+                std::sort(indices_.begin(), indices_.end(),
+                          [](const TaskIndex3D& a, const TaskIndex3D& b) {
+                    if (a.z != b.z) {
+                        return a.z < b.z;
+                    }
+                    return mortonKey2D(a.x, a.y) < mortonKey2D(b.x, b.y);
+                });
+            }
+        }
+        ~Runnable3DAdapter() {}
+
+        void runTask(int task_id, int num_total_tasks) {
+            runnable_->runTask(indices_[task_id], count_);
+        }
+
+    private:
+        IRunnable3D* runnable_;
+        TaskIndex3D count_;
+        std::vector<TaskIndex3D> indices_;
+};
+
+void ITaskSystem::run3D(IRunnable3D* runnable, int count_x, int count_y, int count_z,
+                        TaskOrder order) {
+    if (count_x <= 0 || count_y <= 0 || count_z <= 0) {
+        return;
+    }
+    TaskIndex3D count = {count_x, count_y, count_z};
+    Runnable3DAdapter adapter(runnable, count, order);
+    run(&adapter, count_x * count_y * count_z);
+}
+
 /*
  * ================================================================
  * Serial task system implementation
@@ -160,11 +229,7 @@ void TaskSystemParallelThreadPoolSpinning::worker() {
 
         runner->runTask(taskid, total_tasks);
 
-        // printf("runnignf taskid: %d\n", taskid);
-        {
-            std::lock_guard<std::mutex> lock_f(lk_finish);
-            taskCount++;
-        }
+        taskCount.fetch_add(1, std::memory_order_release);
     }
 }
 
@@ -178,12 +243,15 @@ void TaskSystemParallelThreadPoolSpinning::run(IRunnable* runnable, int num_tota
     //
 
     
-    runner = runnable;
     taskCount = 0;
-    total_tasks = num_total_tasks;
-    left_tasks = num_total_tasks;
+    {
+        std::lock_guard<std::mutex> lock_w(lk_worker);
+        runner = runnable;
+        total_tasks = num_total_tasks;
+        left_tasks = num_total_tasks;
+    }
 
-    while(taskCount < num_total_tasks){
+    while(taskCount.load(std::memory_order_acquire) < num_total_tasks){
         std::this_thread::yield();
     }
     
@@ -231,7 +299,7 @@ void TaskSystemParallelThreadPoolSleeping::worker() {
         std::unique_lock<std::mutex> lock_w(lk_worker);
         cv_worker.wait(lock_w, [this](){ return left_tasks > 0 || terminated;});
 
-        if(left_tasks == 0 && terminated){
+        if(left_tasks <= 0 && terminated){
             break;
         }
 
@@ -282,9 +350,17 @@ void TaskSystemParallelThreadPoolSleeping::run(IRunnable* runnable, int num_tota
     // tasks sequentially on the calling thread.
     //
 
-    runner = runnable;
-    total_tasks = left_tasks = num_total_tasks;
-    taskCount = 0;
+    {
+        std::lock_guard<std::mutex> lock_f(lk_finish);
+        taskCount = 0;
+    }
+    {
+        // Publish the launch under lk_worker so a worker never sees a
+        // new left_tasks paired with a stale runner/total_tasks.
+        std::lock_guard<std::mutex> lock_w(lk_worker);
+        runner = runnable;
+        total_tasks = left_tasks = num_total_tasks;
+    }
 
     cv_worker.notify_all();
 
@@ -7,6 +7,10 @@
 #include <atomic>
 #include <condition_variable>
 
+// Hot shared counters are aligned to this so that threads updating
+// different counters never write to the same cache line.
+#define CACHE_LINE_SIZE 64
+
 /*
  * TaskSystemSerial: This class is the student's implementation of a
  * serial task execution engine.  See definition of ITaskSystem in
@@ -57,14 +61,18 @@ class TaskSystemParallelThreadPoolSpinning: public ITaskSystem {
         void sync();
     private:
         std::vector<std::thread> threadPool;
-        std::mutex lk_worker;
-        std::mutex lk_finish;
         void worker();
+        // Launch description: written by run() under lk_worker, then only
+        // read by the workers.
         IRunnable *runner;
         int total_tasks;
-        int taskCount;
-        int left_tasks;
         std::atomic<bool> terminated;
+        // Task claiming: every worker takes lk_worker and decrements
+        // left_tasks, so keep both off the read-mostly line above.
+        alignas(CACHE_LINE_SIZE) std::mutex lk_worker;
+        int left_tasks;
+        // Completion counter: bumped by every worker and polled by run().
+        alignas(CACHE_LINE_SIZE) std::atomic<int> taskCount;
 };
 
 /*
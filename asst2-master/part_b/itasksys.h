@@ -20,6 +20,43 @@ class IRunnable {
         virtual void runTask(int task_id, int num_total_tasks) = 0;
 };
 
+/*
+  Coordinates of one task of a multidimensional bulk launch (see
+  ITaskSystem::run3D()).  Also used to describe the launch's extent.
+ */
+struct TaskIndex3D {
+    int x;
+    int y;
+    int z;
+};
+
+/*
+  Order in which the tasks of a multidimensional launch are numbered
+  when they are handed to the task system.  Task systems dispense task
+  ids roughly in increasing order, so tasks with nearby ids run at
+  around the same time.
+ */
+enum TaskOrder {
+    TASK_ORDER_ROW_MAJOR,  // x fastest, then y, then z
+    TASK_ORDER_MORTON,     // Z-order curve over (x, y); z slowest
+};
+
+class IRunnable3D {
+    public:
+        virtual ~IRunnable3D();
+
+        /*
+          Executes an instance of the task as part of a multidimensional
+          bulk task launch.
+
+           - index: the current task's coordinates, each between 0 and
+             the corresponding component of count minus 1.
+
+           - count: the extent of the bulk task launch in each dimension.
+         */
+        virtual void runTask(TaskIndex3D index, TaskIndex3D count) = 0;
+};
+
 class ITaskSystem {
     public:
         /*
@@ -67,6 +104,23 @@ class ITaskSystem {
          */
         virtual void sync() = 0;
 
+        /*
+          Executes a bulk task launch of count_x * count_y * count_z
+          tasks.  Like run(), execution is synchronous with the calling
+          thread.  The tasks are numbered in the given order and run
+          through run(), so every task system supports multidimensional
+          launches.  With TASK_ORDER_MORTON, tasks that run close
+          together in time also cover neighbouring tiles of the domain,
+          which keeps the data they share in cache.
+        */
+        void run3D(IRunnable3D* runnable, int count_x, int count_y, int count_z = 1,
+                   TaskOrder order = TASK_ORDER_MORTON);
+
+        /*
+          The num_threads the task system was created with.
+         */
+        int numThreads() const { return _num_threads; }
+
     protected:
         int _num_threads; // Maximum number of threads that the task system can use.
 };
@@ -6,12 +6,83 @@
 #include <atomic>
 #include <queue>
 #include <fstream>
+#include <algorithm>
+#include <climits>
+#include <stdio.h>
 
 IRunnable::~IRunnable() {}
 
 ITaskSystem::ITaskSystem(int num_threads) : _num_threads(num_threads) {}
 ITaskSystem::~ITaskSystem() {}
 
+IRunnable3D::~IRunnable3D() {}
+
+/*
+ * ================================================================
+ * Multidimensional launches
+ * ================================================================
+ */
+
+// Interleaves the bits of x and y (x in the even bits) to give the
+// position of (x, y) along a Z-order curve.
+static unsigned long long mortonKey2D(unsigned int x, unsigned int y) {
+    unsigned long long key = 0;
+    for (int bit = 0; bit < 32; bit++) {
+        key |= (unsigned long long)((x >> bit) & 1) << (2 * bit);
+        key |= (unsigned long long)((y >> bit) & 1) << (2 * bit + 1);
+    }
+    return key;
+}
+
+/*
+ * Flattens a multidimensional launch into a 1D one: flat task i runs
+ * the i'th coordinate of the chosen ordering.
+ */
+class Runnable3DAdapter: public IRunnable {
+    public:
+        Runnable3DAdapter(IRunnable3D* runnable, TaskIndex3D count, TaskOrder order)
+          : runnable_(runnable), count_(count) {
+            indices_.reserve(count.x * count.y * count.z);
+            for (int z = 0; z < count.z; z++) {
+                for (int y = 0; y < count.y; y++) {
+                    for (int x = 0; x < count.x; x++) {
+                        TaskIndex3D index = {x, y, z};
+                        indices_.push_back(index);
+                    }
+                }
+            }
+            if (order == TASK_ORDER_MORTON) {
+                std::sort(indices_.begin(), indices_.end(),
+                          [](const TaskIndex3D& a, const TaskIndex3D& b) {
+                    if (a.z != b.z) {
+                        return a.z < b.z;
+                    }
+                    return mortonKey2D(a.x, a.y) < mortonKey2D(b.x, b.y);
+                });
+            }
+        }
+        ~Runnable3DAdapter() {}
+
+        void runTask(int task_id, int num_total_tasks) {
+            runnable_->runTask(indices_[task_id], count_);
+        }
+
+    private:
+        IRunnable3D* runnable_;
+        TaskIndex3D count_;
+        std::vector<TaskIndex3D> indices_;
+};
+
+void ITaskSystem::run3D(IRunnable3D* runnable, int count_x, int count_y, int count_z,
+                        TaskOrder order) {
+    if (count_x <= 0 || count_y <= 0 || count_z <= 0) {
+        return;
+    }
+    TaskIndex3D count = {count_x, count_y, count_z};
+    Runnable3DAdapter adapter(runnable, count, order);
+    run(&adapter, count_x * count_y * count_z);
+}
+
 /*
  * ================================================================
  * Serial task system implementation
@@ -122,6 +193,158 @@ void TaskSystemParallelThreadPoolSpinning::sync() {
     return;
 }
 
+/*
+ * ================================================================
+ * Shared Worker Pool Implementation
+ * ================================================================
+ */
+
+SharedWorkerPool& SharedWorkerPool::instance() {
+    static SharedWorkerPool pool;
+    return pool;
+}
+
+SharedWorkerPool::SharedWorkerPool() {
+    next_frontend = 0;
+    work_generation = 0;
+    terminated = false;
+}
+
+SharedWorkerPool::~SharedWorkerPool() {
+    {
+        std::lock_guard<CountingMutex> lock_p(lk_pool);
+        terminated = true;
+    }
+    cv_worker.notify_all();
+    for (auto& t : threadPool) {
+        if (t.joinable()) {
+            t.join();
+        }
+    }
+    threadPool.clear();
+}
+
+void SharedWorkerPool::attach(TaskSystemParallelThreadPoolSleeping* ts, int num_threads) {
+    std::lock_guard<CountingMutex> lock_p(lk_pool);
+    frontends.push_back(ts);
+    // Grow to the widest front-end; never one pool per instance.
+    while ((int)threadPool.size() < num_threads) {
+        workerSlots.emplace_back();
+        WorkerSlot* slot = &workerSlots.back();
+        threadPool.emplace_back([this, slot]() { worker(slot); });
+    }
+}
+
+void SharedWorkerPool::detach(TaskSystemParallelThreadPoolSleeping* ts) {
+    {
+        std::lock_guard<CountingMutex> lock_p(lk_pool);
+        for (auto it = frontends.begin(); it != frontends.end(); ++it) {
+            if (*it == ts) {
+                frontends.erase(it);
+                break;
+            }
+        }
+    }
+    // A worker may still be inside finishTask() for this front-end after
+    // its last sync() returned; wait for it to let go.
+    while (ts->active_workers > 0) {
+        std::this_thread::yield();
+    }
+}
+
+void SharedWorkerPool::notify() {
+    {
+        std::lock_guard<CountingMutex> lock_p(lk_pool);
+        ++work_generation;
+    }
+    cv_worker.notify_all();
+}
+
+#ifdef TASKSYS_METRICS
+void SharedWorkerPool::metrics(TaskSystemMetrics& m) {
+    m.lk_pool.acquisitions = lk_pool.acquisitions;
+    m.lk_pool.contended = lk_pool.contended;
+    std::lock_guard<CountingMutex> lock_p(lk_pool);
+    m.workers.clear();
+    for (const WorkerSlot& slot : workerSlots) {
+        WorkerMetrics w;
+        w.tasks_executed = slot.tasks_executed;
+        w.idle_seconds = slot.idle_ns * 1e-9;
+        w.busy_seconds = slot.busy_ns * 1e-9;
+        m.workers.push_back(w);
+    }
+}
+#endif
+
+// Only the front-end list and the active_workers reservations are
+// guarded by lk_pool.  A worker reserves a slot on a front-end, drops
+// lk_pool and dequeues under that front-end's own locks, and gives the
+// slot back if there was nothing to run.  Concurrent instances therefore
+// only contend on lk_pool for the reservation, never for the dequeue.
+void SharedWorkerPool::worker(WorkerSlot* slot) {
+#ifdef TASKSYS_METRICS
+    typedef std::chrono::steady_clock clock;
+    clock::time_point idle_start = clock::now();
+#endif
+    lk_pool.lock();
+    std::unique_lock<std::mutex> lock_p(lk_pool.native(), std::adopt_lock);
+    while (!terminated) {
+        // Anything launched while lk_pool is dropped below bumps
+        // work_generation, so a worker that found nothing only sleeps if
+        // nothing has been launched since it started looking.
+        unsigned long long seen = work_generation;
+        TaskSystemParallelThreadPoolSleeping::task_t task;
+        TaskSystemParallelThreadPoolSleeping* owner = nullptr;
+        for (size_t tried = 0; tried < frontends.size(); tried++) {
+            TaskSystemParallelThreadPoolSleeping* ts = frontends[next_frontend % frontends.size()];
+            next_frontend = (next_frontend + 1) % frontends.size();
+            // active_workers only grows under lk_pool, so this
+            // cannot let more than max_workers in.
+            if (ts->active_workers >= ts->max_workers) {
+                continue;
+            }
+            // The reservation also keeps detach() from returning, so ts
+            // stays valid while lk_pool is dropped.
+            ts->active_workers++;
+            lock_p.unlock();
+            task = ts->getTask();
+            if (!task.isnull()) {
+                owner = ts;
+                break;
+            }
+            ts->active_workers--;
+            lk_pool.lock();
+            lock_p = std::unique_lock<std::mutex>(lk_pool.native(), std::adopt_lock);
+        }
+
+        if (owner == nullptr) {
+            cv_worker.wait(lock_p, [this, seen]() {
+                return terminated || work_generation != seen;
+            });
+            continue;
+        }
+
+#ifdef TASKSYS_METRICS
+        clock::time_point busy_start = clock::now();
+#endif
+        task.run();
+        owner->finishTask(task);
+        owner->active_workers--;
+#ifdef TASKSYS_METRICS
+        clock::time_point busy_end = clock::now();
+
+        slot->idle_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            busy_start - idle_start).count(), std::memory_order_relaxed);
+        slot->busy_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            busy_end - busy_start).count(), std::memory_order_relaxed);
+        slot->tasks_executed.fetch_add(1, std::memory_order_relaxed);
+        idle_start = busy_end;
+#endif
+        lk_pool.lock();
+        lock_p = std::unique_lock<std::mutex>(lk_pool.native(), std::adopt_lock);
+    }
+}
+
 /*
  * ================================================================
  * Parallel Thread Pool Sleeping Task System Implementation
@@ -141,16 +364,23 @@ TaskSystemParallelThreadPoolSleeping::TaskSystemParallelThreadPoolSleeping(int n
     //
 
     next_task_id = 0;
-    terminated = false;
+    num_running = 0;
+    active_workers = 0;
+    max_workers = num_threads > 0 ? num_threads : 1;
+
+#ifdef TASKSYS_METRICS
+    created = std::chrono::steady_clock::now();
+    ready_depth = wait_depth = 0;
+    max_ready_depth = max_wait_depth = 0;
+    depth_changes = 0;
+    num_depth_samples = 0;
+#endif
 
     for (int i = 0; i < MAX_TASKS; i++) {
-        done[i] = 0;
         running[i] = false;
     }
 
-    for (int i = 0; i < num_threads; i++) {
-        threadPool.emplace_back([this]() { worker(); });
-    }
+    SharedWorkerPool::instance().attach(this, num_threads);
 }
 
 TaskSystemParallelThreadPoolSleeping::~TaskSystemParallelThreadPoolSleeping() {
@@ -161,49 +391,37 @@ TaskSystemParallelThreadPoolSleeping::~TaskSystemParallelThreadPoolSleeping() {
     // (requiring changes to tasksys.h).
     //
 
-    terminated = true;
-    cv_worker.notify_all();
-    for (auto& t : threadPool) {
-        if (t.joinable()) {
-            t.join();
-        }
-    }
-    threadPool.clear();
+    // The workers belong to the shared pool, so only drain our own
+    // launches before detaching from it.
+    sync();
+    SharedWorkerPool::instance().detach(this);
 }
 
-void TaskSystemParallelThreadPoolSleeping::worker() {
-    while (true) {
-        task_t task;
-        std::unique_lock<std::mutex> lock_w(lk_worker);
-        cv_worker.wait(lock_w, [this, &task]() {
-            task = getTask(); 
-            return !task.isnull() || terminated; 
-        });
-
-        if (terminated && task.isnull()) {
-            break;
-        }
-
-        lock_w.unlock();
-        task.run();
-            
-        {
-            std::lock_guard<std::mutex> lock_done(lk_done);
-            ++done[task.task_id];
-            if (done[task.task_id] == task.num_total_tasks) {
-                std::lock_guard<std::mutex> lock_run(lk_run);
-                running[task.task_id] = false;
-                cv_finish.notify_all();
-            }
-        }
+void TaskSystemParallelThreadPoolSleeping::finishTask(task_t& task) {
+    int done = task.counter->done.fetch_add(1, std::memory_order_acq_rel) + 1;
+    if (done == task.num_total_tasks) {
+        delete task.counter;
+        std::lock_guard<CountingMutex> lock_run(lk_run);
+        running[task.task_id & (MAX_TASKS - 1)] = false;
+        --num_running;
+        cv_finish.notify_all();
+    }
+}
 
+// Called with lk_run held.  A launch's slot is only handed to the id
+// MAX_TASKS after it once the launch has finished, so any id at least
+// that far behind next_task_id is done.
+bool TaskSystemParallelThreadPoolSleeping::isRunning(TaskID task_id) {
+    if (((next_task_id - task_id) & INT_MAX) > MAX_TASKS) {
+        return false;
     }
+    return running[task_id & (MAX_TASKS - 1)];
 }
 
 bool TaskSystemParallelThreadPoolSleeping::isReady(task_t& task) {
-    std::lock_guard<std::mutex> lock_run(lk_run);
+    std::lock_guard<CountingMutex> lock_run(lk_run);
     for (const TaskID& dep : task.deps) {
-        if (running[dep]) {
+        if (isRunning(dep)) {
             return false;
         }
     }
@@ -211,16 +429,17 @@ bool TaskSystemParallelThreadPoolSleeping::isReady(task_t& task) {
 }
 
 TaskSystemParallelThreadPoolSleeping::task_t TaskSystemParallelThreadPoolSleeping::getTask() {
-    std::unique_lock<std::mutex> lock_t(lk_taskque);
+    std::unique_lock<CountingMutex> lock_t(lk_taskque);
     if (!taskQueue.empty()) {
         auto& task = taskQueue.front();
         task_t returnTask = task;
         if(++task.taskCount == task.num_total_tasks) {
             taskQueue.pop();
+            recordDepth(-1, 0);
         }
         return returnTask;
     }
-    std::unique_lock<std::mutex> lock_w(lk_waitstk);
+    std::unique_lock<CountingMutex> lock_w(lk_waitstk);
     if (!waitStack.empty()) {
         task_t returnTask = {-1, -1, -1, nullptr, {}};
         for (auto it = waitStack.begin(); it != waitStack.end(); ) {
@@ -232,8 +451,11 @@ TaskSystemParallelThreadPoolSleeping::task_t TaskSystemParallelThreadPoolSleepin
                 }
                 if (++readyTask.taskCount < readyTask.num_total_tasks) {
                     taskQueue.push(readyTask);
+                    recordDepth(1, -1);
+                } else {
+                    recordDepth(0, -1);
                 }
-                cv_worker.notify_all();
+                SharedWorkerPool::instance().notify();
                 return returnTask;
             } else {
                 ++it;
@@ -267,36 +489,47 @@ TaskID TaskSystemParallelThreadPoolSleeping::runAsyncWithDeps(IRunnable* runnabl
     // TODO: CS149 students will implement this method in Part B.
     //
 
-    TaskID task_id = next_task_id.fetch_add(1);
-
-
     struct task_t task;
     bool is_ready = true;
-    task.task_id = task_id;
     task.taskCount = 0;
     task.num_total_tasks = num_total_tasks > 0 ? num_total_tasks : 1;
     task.runnable = runnable;
     task.deps = deps;
+    task.counter = new launch_counter_t;
+    task.counter->done = 0;
     
+    TaskID task_id;
     {
-        std::lock_guard<std::mutex> lock_run(lk_run);
-        running[task_id] = true;
+        lk_run.lock();
+        std::unique_lock<std::mutex> lock_run(lk_run.native(), std::adopt_lock);
+        // Ids wrap at INT_MAX and reuse the slot of the launch MAX_TASKS
+        // before them, which must have finished first.
+        cv_finish.wait(lock_run, [this]() {
+            return !running[next_task_id & (MAX_TASKS - 1)];
+        });
+        task_id = next_task_id;
         for (const TaskID& dep : deps) {
-            if (running[dep]) {
+            if (isRunning(dep)) {
                 is_ready = false;
             }
         }
+        running[task_id & (MAX_TASKS - 1)] = true;
+        ++num_running;
+        next_task_id = (task_id + 1) & INT_MAX;
     }
+    task.task_id = task_id;
 
     if (is_ready) {
-        std::lock_guard<std::mutex> lock_task(lk_taskque);
+        std::lock_guard<CountingMutex> lock_task(lk_taskque);
         taskQueue.push(task);
+        recordDepth(1, 0);
     } else {
-        std::lock_guard<std::mutex> lock_wait(lk_waitstk);
+        std::lock_guard<CountingMutex> lock_wait(lk_waitstk);
         waitStack.push_back(task);
+        recordDepth(0, 1);
     }
     
-    cv_worker.notify_all();
+    SharedWorkerPool::instance().notify();
 
     return task_id;
 }
@@ -307,15 +540,95 @@ void TaskSystemParallelThreadPoolSleeping::sync() {
     // TODO: CS149 students will modify the implementation of this method in Part B.
     //
 
-    std::unique_lock<std::mutex> lock_f(lk_run);
-    cv_finish.wait(lock_f, [this]() {
-        for (int i = 0; i < next_task_id; i++) {
-            if (running[i]) {
-                return false;
-            }
-        }
-        return true;
-    });
+    lk_run.lock();
+    std::unique_lock<std::mutex> lock_f(lk_run.native(), std::adopt_lock);
+    cv_finish.wait(lock_f, [this]() { return num_running == 0; });
 
     return;
 }
+
+#ifdef TASKSYS_METRICS
+static void atomicMax(std::atomic<int>& max, int value) {
+    int seen = max.load(std::memory_order_relaxed);
+    while (value > seen &&
+           !max.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {
+    }
+}
+#endif
+
+// The depths are relaxed atomics, so concurrent front-end locks never
+// serialize on the bookkeeping; only every DEPTH_SAMPLE_INTERVAL'th
+// change reads the clock and takes lk_metrics to record a sample.
+void TaskSystemParallelThreadPoolSleeping::recordDepth(int ready_delta, int wait_delta) {
+#ifdef TASKSYS_METRICS
+    int ready = ready_depth.fetch_add(ready_delta, std::memory_order_relaxed) + ready_delta;
+    int wait = wait_depth.fetch_add(wait_delta, std::memory_order_relaxed) + wait_delta;
+    atomicMax(max_ready_depth, ready);
+    atomicMax(max_wait_depth, wait);
+
+    if (depth_changes.fetch_add(1, std::memory_order_relaxed) % DEPTH_SAMPLE_INTERVAL != 0) {
+        return;
+    }
+    double now = std::chrono::duration<double>(std::chrono::steady_clock::now() - created).count();
+    std::lock_guard<std::mutex> lock_m(lk_metrics);
+    QueueDepthSample& sample = depthSamples[num_depth_samples % MAX_DEPTH_SAMPLES];
+    sample.time = now;
+    sample.ready_depth = ready;
+    sample.wait_depth = wait;
+    ++num_depth_samples;
+#endif
+}
+
+#ifdef TASKSYS_METRICS
+static LockMetrics lockMetrics(const CountingMutex& m) {
+    LockMetrics l;
+    l.acquisitions = m.acquisitions;
+    l.contended = m.contended;
+    return l;
+}
+
+TaskSystemMetrics TaskSystemParallelThreadPoolSleeping::metrics() {
+    TaskSystemMetrics m;
+    m.lk_taskque = lockMetrics(lk_taskque);
+    m.lk_waitstk = lockMetrics(lk_waitstk);
+    m.lk_run = lockMetrics(lk_run);
+    {
+        std::lock_guard<std::mutex> lock_m(lk_metrics);
+        m.ready_depth = ready_depth;
+        m.wait_depth = wait_depth;
+        m.max_ready_depth = max_ready_depth;
+        m.max_wait_depth = max_wait_depth;
+        unsigned long long first = num_depth_samples > MAX_DEPTH_SAMPLES ?
+            num_depth_samples - MAX_DEPTH_SAMPLES : 0;
+        for (unsigned long long i = first; i < num_depth_samples; i++) {
+            m.depth_history.push_back(depthSamples[i % MAX_DEPTH_SAMPLES]);
+        }
+    }
+    SharedWorkerPool::instance().metrics(m);
+    return m;
+}
+
+void TaskSystemParallelThreadPoolSleeping::printMetrics() {
+    TaskSystemMetrics m = metrics();
+
+    const char* lock_names[] = {"lk_taskque", "lk_waitstk", "lk_run", "lk_pool"};
+    LockMetrics* locks[] = {&m.lk_taskque, &m.lk_waitstk, &m.lk_run, &m.lk_pool};
+    printf("  %-12s %14s %14s %9s\n", "lock", "acquisitions", "contended", "contend%");
+    for (int i = 0; i < 4; i++) {
+        double pct = locks[i]->acquisitions ?
+            100.0 * locks[i]->contended / locks[i]->acquisitions : 0.0;
+        printf("  %-12s %14llu %14llu %8.2f%%\n", lock_names[i],
+               locks[i]->acquisitions, locks[i]->contended, pct);
+    }
+
+    printf("  ready queue depth: %d (max %d), wait stack depth: %d (max %d), %d samples\n",
+           m.ready_depth, m.max_ready_depth, m.wait_depth, m.max_wait_depth,
+           (int)m.depth_history.size());
+
+    printf("  %-12s %14s %14s %14s\n", "worker", "tasks", "idle (ms)", "busy (ms)");
+    for (size_t i = 0; i < m.workers.size(); i++) {
+        printf("  %-12d %14llu %14.3f %14.3f\n", (int)i, m.workers[i].tasks_executed,
+               m.workers[i].idle_seconds * 1000, m.workers[i].busy_seconds * 1000);
+    }
+}
+#endif
@@ -1,7 +1,31 @@
 #ifndef _TASKSYS_H
 #define _TASKSYS_H
 
-#define MAX_TASKS 1000000
+// Launches in flight at once.  Task ids are recycled through a ring of
+// this many slots, so it is a power of two that divides 2^31 and the
+// ring stays in step when ids wrap around.
+#define MAX_TASKS (1 << 20)
+
+// Task systems in this part run on one process-wide SharedWorkerPool
+// rather than owning their own threads; tests use this to check that
+// concurrent instances do not oversubscribe the machine.
+#define TASKSYS_SHARED_POOL
+
+// Building with -DTASKSYS_METRICS (make METRICS=1) makes
+// TaskSystemParallelThreadPoolSleeping count lock, queue and worker
+// activity and expose it through metrics()/printMetrics().  It is off by
+// default: it adds atomic counters to every lock and queue operation and
+// clock reads to every task.
+
+#define MAX_DEPTH_SAMPLES 1024
+
+// With TASKSYS_METRICS, one queue-depth change in this many is recorded
+// in the depth history.
+#define DEPTH_SAMPLE_INTERVAL 16
+
+// Hot shared counters are aligned to this so that threads updating
+// different counters never write to the same cache line.
+#define CACHE_LINE_SIZE 64
 
 #include "itasksys.h"
 #include <thread>
@@ -10,6 +34,8 @@
 #include <condition_variable>
 #include <atomic>
 #include <queue>
+#include <deque>
+#include <chrono>
 
 /*
  * TaskSystemSerial: This class is the student's implementation of a
@@ -61,6 +87,124 @@ class TaskSystemParallelThreadPoolSpinning: public ITaskSystem {
         void sync();
 };
 
+/*
+ * CountingMutex: std::mutex that counts how often it is acquired and how
+ * often an acquisition found it already held (a contended wait).  Usable
+ * with std::lock_guard / std::unique_lock; code that needs a
+ * std::unique_lock<std::mutex> for a condition variable locks the
+ * CountingMutex and then adopts native().  Re-acquisitions performed
+ * inside condition_variable::wait() are not counted.  Without
+ * TASKSYS_METRICS it counts nothing and is a plain std::mutex.
+ */
+class alignas(CACHE_LINE_SIZE) CountingMutex {
+    public:
+        CountingMutex() : acquisitions(0), contended(0) {}
+        void lock() {
+#ifdef TASKSYS_METRICS
+            if (!mtx.try_lock()) {
+                contended.fetch_add(1, std::memory_order_relaxed);
+                mtx.lock();
+            }
+            acquisitions.fetch_add(1, std::memory_order_relaxed);
+#else
+            mtx.lock();
+#endif
+        }
+        bool try_lock() {
+            if (!mtx.try_lock()) {
+                return false;
+            }
+#ifdef TASKSYS_METRICS
+            acquisitions.fetch_add(1, std::memory_order_relaxed);
+#endif
+            return true;
+        }
+        void unlock() { mtx.unlock(); }
+        std::mutex& native() { return mtx; }
+        std::atomic<unsigned long long> acquisitions;
+        std::atomic<unsigned long long> contended;
+    private:
+        std::mutex mtx;
+};
+
+struct LockMetrics {
+    unsigned long long acquisitions;
+    unsigned long long contended;
+};
+
+struct QueueDepthSample {
+    double time;        // seconds since the task system was created
+    int ready_depth;    // bulk launches in the ready queue
+    int wait_depth;     // bulk launches blocked on dependencies
+};
+
+struct WorkerMetrics {
+    unsigned long long tasks_executed;
+    double idle_seconds;
+    double busy_seconds;
+};
+
+/*
+ * Snapshot returned by TaskSystemParallelThreadPoolSleeping::metrics().
+ * Lock and queue counters are per task system instance; lk_pool and the
+ * per-worker counters belong to the SharedWorkerPool and therefore
+ * accumulate over every instance that has used it.
+ */
+struct TaskSystemMetrics {
+    LockMetrics lk_taskque;
+    LockMetrics lk_waitstk;
+    LockMetrics lk_run;
+    LockMetrics lk_pool;
+    int ready_depth;
+    int wait_depth;
+    int max_ready_depth;
+    int max_wait_depth;
+    std::vector<QueueDepthSample> depth_history; // oldest first
+    std::vector<WorkerMetrics> workers;
+};
+
+class TaskSystemParallelThreadPoolSleeping;
+
+/*
+ * SharedWorkerPool: process-wide set of sleeping worker threads shared by
+ * every TaskSystemParallelThreadPoolSleeping instance.  Each task system
+ * attaches itself as a front-end on construction; workers pull bulk
+ * launch tasks from the attached front-ends in round-robin order.  The
+ * pool only grows to the largest num_threads requested by any front-end,
+ * so N concurrent instances share num_threads workers instead of
+ * spawning N * num_threads of them.  A front-end never has more than its
+ * own num_threads workers running its tasks at once, so a narrow
+ * instance stays narrow even after a wider one has grown the pool.
+ */
+class SharedWorkerPool {
+    public:
+        static SharedWorkerPool& instance();
+        void attach(TaskSystemParallelThreadPoolSleeping* ts, int num_threads);
+        void detach(TaskSystemParallelThreadPoolSleeping* ts);
+        void notify();  // new work may be ready; takes the pool lock
+#ifdef TASKSYS_METRICS
+        void metrics(TaskSystemMetrics& m);
+#endif
+    private:
+        struct alignas(CACHE_LINE_SIZE) WorkerSlot {
+            std::atomic<unsigned long long> tasks_executed;
+            std::atomic<long long> idle_ns;
+            std::atomic<long long> busy_ns;
+            WorkerSlot() : tasks_executed(0), idle_ns(0), busy_ns(0) {}
+        };
+        SharedWorkerPool();
+        ~SharedWorkerPool();
+        void worker(WorkerSlot* slot);
+        std::vector<std::thread> threadPool;
+        std::deque<WorkerSlot> workerSlots;
+        std::vector<TaskSystemParallelThreadPoolSleeping*> frontends;
+        CountingMutex lk_pool;
+        std::condition_variable cv_worker;
+        size_t next_frontend;
+        unsigned long long work_generation;  // bumped by notify()
+        bool terminated;
+};
+
 /*
  * TaskSystemParallelThreadPoolSleeping: This class is the student's
  * optimized implementation of a parallel task execution engine that uses
@@ -76,23 +220,33 @@ class TaskSystemParallelThreadPoolSleeping: public ITaskSystem {
         TaskID runAsyncWithDeps(IRunnable* runnable, int num_total_tasks,
                                 const std::vector<TaskID>& deps);
         void sync();
+#ifdef TASKSYS_METRICS
+        TaskSystemMetrics metrics();
+        void printMetrics();
+#endif
     private:
-        std::vector<std::thread> threadPool;
-        std::mutex lk_worker;
-        std::mutex lk_taskque;
-        std::mutex lk_waitstk;
-        std::mutex lk_done;
-        std::mutex lk_run;
-        std::condition_variable cv_worker;
+        friend class SharedWorkerPool;
+        CountingMutex lk_taskque;
+        CountingMutex lk_waitstk;
+        CountingMutex lk_run;
         std::condition_variable cv_finish;
-        std::atomic<bool> terminated;
-        std::atomic<TaskID> next_task_id;
+        TaskID next_task_id;  // guarded by lk_run
+        int num_running;      // launches not yet finished; guarded by lk_run
+        alignas(CACHE_LINE_SIZE) std::atomic<int> active_workers;
+        int max_workers;  // this instance's num_threads
+        // Completion counter of one bulk launch, on its own cache line.
+        // Allocated by runAsyncWithDeps() and freed by the worker that
+        // finishes the launch's last task.
+        struct alignas(CACHE_LINE_SIZE) launch_counter_t {
+            std::atomic<int> done;
+        };
         struct task_t {
             int task_id;
             int taskCount;
             int num_total_tasks;
             IRunnable* runnable;
             std::vector<TaskID> deps;
+            launch_counter_t* counter;
             void run() {
                 runnable->runTask(taskCount, num_total_tasks);
             }
@@ -104,9 +258,25 @@ class TaskSystemParallelThreadPoolSleeping: public ITaskSystem {
         std::vector<task_t> waitStack;
         task_t getTask();
         bool isReady(task_t& task);
-        int done[MAX_TASKS];
+        bool isRunning(TaskID task_id);
+        // running[id & (MAX_TASKS - 1)]: launch id has not finished.
         bool running[MAX_TASKS];
-        void worker();
+        void finishTask(task_t& task);
+        // Queue-depth bookkeeping for metrics(); a no-op without
+        // TASKSYS_METRICS.
+        void recordDepth(int ready_delta, int wait_delta);
+#ifdef TASKSYS_METRICS
+        std::atomic<int> ready_depth;
+        std::atomic<int> wait_depth;
+        std::atomic<int> max_ready_depth;
+        std::atomic<int> max_wait_depth;
+        std::atomic<unsigned long long> depth_changes;
+        // The depth history; guarded by lk_metrics.
+        std::mutex lk_metrics;
+        std::chrono::steady_clock::time_point created;
+        QueueDepthSample depthSamples[MAX_DEPTH_SAMPLES];
+        unsigned long long num_depth_samples;
+#endif
 };
 
 #endif
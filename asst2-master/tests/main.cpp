@@ -16,6 +16,7 @@ void usage(const char* progname, std::string *testnames, int num_tests) {
     printf("Program Options:\n");
     printf("  -n  --num_threads  <INT>      Number of threads: <INT> (default=%d)\n", DEFAULT_NUM_THREADS);
     printf("  -i  --num_timing_iterations <INT> Number of timing iterations: <INT> (default=%d)\n", DEFAULT_NUM_TIMING_ITERATIONS);
+    printf("  -m  --metrics                 Print task system lock/queue/worker metrics\n");
     printf("  -?  --help                    This message\n");
     printf("Valid testnames are:");
     for(int i = 0; i < num_tests; i++) {
@@ -49,9 +50,10 @@ ITaskSystem *selectTaskSystemRefImpl(int num_threads, TaskSystemType type) {
 
 int main(int argc, char** argv)
 {
-    const int n_tests = 31;
+    const int n_tests = 32;
     int num_threads = DEFAULT_NUM_THREADS;
     int num_timing_iterations = DEFAULT_NUM_TIMING_ITERATIONS;
+    bool print_metrics = false;
 
     TestResults (*test[n_tests])(ITaskSystem*) = {
         simpleTestSync,
@@ -83,6 +85,9 @@ int main(int argc, char** argv)
         strictGraphDepsSmall,
         strictGraphDepsMedium,
         strictGraphDepsLarge,
+        sharedThreadPoolTest,
+        taskOverheadScalingTest,
+        mandelbrotTiledTest,
     };
 
     std::string test_names[n_tests] = {
@@ -115,6 +120,9 @@ int main(int argc, char** argv)
         "strict_graph_deps_small_async",
         "strict_graph_deps_med_async",
         "strict_graph_deps_large_async",
+        "shared_thread_pool",
+        "task_overhead_scaling",
+        "mandelbrot_tiled",
     };
  
     // Parse commandline options
@@ -122,10 +130,11 @@ int main(int argc, char** argv)
     static struct option long_options[] = {
         {"num_threads",           1, 0,  'n'},
         {"num_timing_iterations", 1, 0,  'i'},
+        {"metrics",               0, 0,  'm'},
         {"help",                  0, 0,  '?'},
     };
 
-    while ((opt = getopt_long(argc, argv, "n:i:?", long_options, NULL)) != EOF) {
+    while ((opt = getopt_long(argc, argv, "n:i:m?", long_options, NULL)) != EOF) {
 
         switch (opt) {
         case 'n':
@@ -134,6 +143,9 @@ int main(int argc, char** argv)
         case 'i':
             num_timing_iterations = atoi(optarg);
             break;
+        case 'm':
+            print_metrics = true;
+            break;
         case '?':
         default:
             usage(argv[0], test_names, n_tests);
@@ -141,6 +153,12 @@ int main(int argc, char** argv)
         }
     }
 
+#ifndef TASKSYS_METRICS
+    if (print_metrics) {
+        fprintf(stderr, "Warning: this task system does not export metrics\n");
+    }
+#endif
+
     if (optind + 1 > argc) {
         fprintf(stderr, "Error: missing test_name!\n");
         usage(argv[0], test_names, n_tests);
@@ -184,6 +202,13 @@ int main(int argc, char** argv)
                 // TODO: do this better
                 if( j+1 == num_timing_iterations) {
                     printf("[%s]:\t\t[%.3f] ms\n", t->name(), minT * 1000);
+#ifdef TASKSYS_METRICS
+                    TaskSystemParallelThreadPoolSleeping* sleeping =
+                        dynamic_cast<TaskSystemParallelThreadPoolSleeping*>(t);
+                    if (print_metrics && sleeping != NULL) {
+                        sleeping->printMetrics();
+                    }
+#endif
                 }
 
                 // Shutdown task system so each timing run is from a clean start
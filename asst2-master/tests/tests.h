@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <chrono>
 #include <cmath>
 #include <math.h>
@@ -5,6 +6,7 @@
 #include <stdio.h>
 #include <thread>
 #include <atomic>
+#include <mutex>
 #include <set>
 
 #include "CycleTimer.h"
@@ -37,6 +39,18 @@ TestResults mathOperationsInTightForLoopReductionTreeAsyncTest(ITaskSystem* t);
 TestResults spinBetweenRunCallsAsyncTest(ITaskSystem *t);
 TestResults mandelbrotChunkedAsyncTest(ITaskSystem* t);
 TestResults simpleRunDepsTest(ITaskSystem *t);
+
+Multidimensional launch tests
+=============================
+TestResults mandelbrotTiledTest(ITaskSystem *t);
+
+Shared thread pool tests
+========================
+TestResults sharedThreadPoolTest(ITaskSystem *t);
+
+Microbenchmarks
+===============
+TestResults taskOverheadScalingTest(ITaskSystem *t);
 */
 
 /*
@@ -415,6 +429,43 @@ class MandelbrotTask: public IRunnable {
         }
 };
 
+/*
+ * Each task of a 2D launch computes one tile_width x tile_height tile of
+ * the Mandelbrot image; tiles on the right and bottom edges are clipped
+ * to the image.
+ */
+class MandelbrotTileTask: public IRunnable3D {
+    public:
+        MandelbrotTask::MandelArgs *args_;
+        int tile_width_;
+        int tile_height_;
+        MandelbrotTask kernel_;
+
+        MandelbrotTileTask(MandelbrotTask::MandelArgs *args, int tile_width, int tile_height)
+          : args_(args), tile_width_(tile_width), tile_height_(tile_height),
+            kernel_(args, false) {}
+        ~MandelbrotTileTask() {}
+
+        void runTask(TaskIndex3D index, TaskIndex3D count) {
+            float dx = (args_->x1 - args_->x0) / args_->width;
+            float dy = (args_->y1 - args_->y0) / args_->height;
+
+            int startCol = index.x * tile_width_;
+            int endCol = std::min(startCol + tile_width_, args_->width);
+            int startRow = index.y * tile_height_;
+            int endRow = std::min(startRow + tile_height_, args_->height);
+
+            for (int j = startRow; j < endRow; j++) {
+                for (int i = startCol; i < endCol; i++) {
+                    float x = args_->x0 + i * dx;
+                    float y = args_->y0 + j * dy;
+                    args_->output[j * args_->width + i] =
+                        kernel_.mandel(x, y, args_->max_iterations);
+                }
+            }
+        }
+};
+
 /*
  * Each task sleeps for the prescribed amount of time, and then
  * print a message to stdout.
@@ -488,6 +539,62 @@ class StrictDependencyTask: public IRunnable {
         ~StrictDependencyTask() {}
 };
 
+/*
+ * Each task records how many tasks (across every task system instance
+ * sharing the probe) are executing at once, and which OS threads ran
+ * them.  Used to detect oversubscription by concurrent task systems.
+ */
+class ConcurrencyProbeTask: public IRunnable {
+    private:
+        std::atomic<int>* in_flight_;
+        std::atomic<int>* peak_;
+        std::atomic<int>* tasks_run_;
+        std::mutex* lk_threads_;
+        std::set<std::thread::id>* threads_;
+
+    public:
+        ConcurrencyProbeTask(std::atomic<int>* in_flight, std::atomic<int>* peak,
+                             std::atomic<int>* tasks_run, std::mutex* lk_threads,
+                             std::set<std::thread::id>* threads)
+          : in_flight_(in_flight), peak_(peak), tasks_run_(tasks_run),
+            lk_threads_(lk_threads), threads_(threads) {}
+        ~ConcurrencyProbeTask() {}
+
+        void runTask(int task_id, int num_total_tasks) {
+            int now = ++(*in_flight_);
+            int peak = *peak_;
+            while (now > peak && !peak_->compare_exchange_weak(peak, now)) {}
+
+            {
+                std::lock_guard<std::mutex> lock(*lk_threads_);
+                threads_->insert(std::this_thread::get_id());
+            }
+
+            // Using this as a proxy for actual work.
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+
+            --(*in_flight_);
+            ++(*tasks_run_);
+        }
+};
+
+/*
+ * Each task does no real work: it bumps its own cache-line-sized slot of
+ * the output array, so any cross-thread cache traffic measured comes
+ * from the task system itself.
+ */
+class EmptyTask: public IRunnable {
+    public:
+        static const int kSlotStride = 16; // ints per 64-byte cache line
+        int* slots_;
+        EmptyTask(int* slots) : slots_(slots) {}
+        ~EmptyTask() {}
+
+        void runTask(int task_id, int num_total_tasks) {
+            slots_[task_id * kSlotStride]++;
+        }
+};
+
 /* 
  * ==================================================================
  *   Begin test definitions
@@ -1240,6 +1347,61 @@ TestResults mandelbrotChunkedAsyncTest(ITaskSystem* t) {
     return mandelbrotChunkedTestBase(t, true);
 }
 
+/*
+ * Computation: This test computes the same Mandelbrot image as
+ * mandelbrotChunkedTest, but as a single 2D bulk task launch of 64x64
+ * pixel tiles issued in Morton order through ITaskSystem::run3D().  The
+ * image size is not a multiple of the tile size, so the edge tiles are
+ * partial.
+ */
+TestResults mandelbrotTiledTest(ITaskSystem* t) {
+    int tile_size = 64;
+
+    MandelbrotTask::MandelArgs ma;
+    ma.x0 = -2;
+    ma.x1 = 1;
+    ma.y0 = -1;
+    ma.y1 = 1;
+    ma.width = 1600;
+    ma.height = 1200;
+    ma.max_iterations = 256;
+    ma.output = new int[ma.width * ma.height];
+    for (int i = 0; i < (ma.width * ma.height); i++) {
+        ma.output[i] = 0;
+    }
+
+    MandelbrotTileTask tile_task(&ma, tile_size, tile_size);
+    int tiles_x = (ma.width + tile_size - 1) / tile_size;
+    int tiles_y = (ma.height + tile_size - 1) / tile_size;
+
+    double start_time = CycleTimer::currentSeconds();
+    t->run3D(&tile_task, tiles_x, tiles_y, 1, TASK_ORDER_MORTON);
+    double end_time = CycleTimer::currentSeconds();
+
+    int *golden = new int[ma.width * ma.height];
+    tile_task.kernel_.mandelbrotSerial(ma.x0, ma.y0, ma.x1, ma.y1,
+                                       ma.width, ma.height,
+                                       0, ma.height,
+                                       ma.max_iterations,
+                                       golden);
+
+    TestResults result;
+    result.passed = true;
+    for (int i = 0; i < ma.width * ma.height; i++) {
+        if (golden[i] != ma.output[i]) {
+            result.passed = false;
+            printf("%d: %d expected=%d\n", i, ma.output[i], golden[i]);
+            break;
+        }
+    }
+    result.time = end_time - start_time;
+
+    delete [] golden;
+    delete [] ma.output;
+
+    return result;
+}
+
 /*
  * Computation: Simple correctness test for runAsyncWithDeps.
  * Tasks sleep for a prescribed amount of time and then print
@@ -1403,3 +1565,166 @@ TestResults strictGraphDepsMedium(ITaskSystem* t) {
 TestResults strictGraphDepsLarge(ITaskSystem* t) {
     return strictGraphDepsTestBase(t,1000,20000,0);
 }
+
+/*
+ * Computation: num_instances task systems of the same type as `t` are
+ * constructed and driven concurrently from num_instances application
+ * threads, each performing a series of bulk task launches of
+ * ConcurrencyProbeTask.  When the task system shares one process-wide
+ * worker pool (TASKSYS_SHARED_POOL), the number of distinct worker
+ * threads and the peak number of concurrently running tasks must not
+ * exceed worker_limit, the widest num_threads any instance was created
+ * with, and there must be fewer worker threads than the instances would
+ * own between them, i.e. the instances must not oversubscribe the
+ * machine.  A worker_limit of 0 skips the check.
+ */
+template <class TaskSystem>
+TestResults sharedThreadPoolTestBase(int num_instances, int num_threads,
+                                     int worker_limit) {
+    int num_bulk_task_launches = 20;
+    int num_tasks = 16;
+
+    std::atomic<int> in_flight(0);
+    std::atomic<int> peak(0);
+    std::atomic<int> tasks_run(0);
+    std::mutex lk_threads;
+    std::set<std::thread::id> threads;
+    ConcurrencyProbeTask task(&in_flight, &peak, &tasks_run, &lk_threads, &threads);
+
+    std::vector<TaskSystem*> systems;
+    for (int i = 0; i < num_instances; i++) {
+        systems.push_back(new TaskSystem(num_threads));
+    }
+
+    double start_time = CycleTimer::currentSeconds();
+    std::vector<std::thread> app_threads;
+    for (int i = 0; i < num_instances; i++) {
+        TaskSystem* ts = systems[i];
+        app_threads.emplace_back([ts, &task, num_tasks, num_bulk_task_launches]() {
+            for (int j = 0; j < num_bulk_task_launches; j++) {
+                ts->run(&task, num_tasks);
+            }
+        });
+    }
+    for (auto& th : app_threads) {
+        th.join();
+    }
+    double end_time = CycleTimer::currentSeconds();
+
+    for (TaskSystem* ts : systems) {
+        delete ts;
+    }
+
+    TestResults result;
+    result.passed = true;
+    int expected = num_instances * num_bulk_task_launches * num_tasks;
+    if (tasks_run != expected) {
+        printf("tasks run: %d expected=%d\n", tasks_run.load(), expected);
+        result.passed = false;
+    }
+    if (worker_limit > 0 &&
+        ((int)threads.size() > worker_limit || peak > worker_limit ||
+         (int)threads.size() >= num_instances * num_threads)) {
+        printf("oversubscribed: %d worker threads, %d tasks in flight (limit %d)\n",
+               (int)threads.size(), peak.load(), worker_limit);
+        result.passed = false;
+    }
+    result.time = end_time - start_time;
+    return result;
+}
+
+TestResults sharedThreadPoolTest(ITaskSystem* t) {
+    int num_instances = 4;
+    int num_threads = 4;
+#ifdef TASKSYS_SHARED_POOL
+    // The caller's own `t` is attached to the pool too, so the pool may
+    // be as wide as -n.  The instances here are made that wide as well,
+    // so a pool per instance would need num_instances times the limit.
+    // The limit comes from the widths asked for, never from the pool.
+    num_threads = std::max(num_threads, t->numThreads());
+    int worker_limit = num_threads;
+#else
+    int worker_limit = 0;
+#endif
+
+    if (dynamic_cast<TaskSystemParallelThreadPoolSleeping*>(t)) {
+        return sharedThreadPoolTestBase<TaskSystemParallelThreadPoolSleeping>(
+            num_instances, num_threads, worker_limit);
+    } else if (dynamic_cast<TaskSystemParallelThreadPoolSpinning*>(t)) {
+        return sharedThreadPoolTestBase<TaskSystemParallelThreadPoolSpinning>(
+            num_instances, num_threads, 0);
+    } else if (dynamic_cast<TaskSystemParallelSpawn*>(t)) {
+        return sharedThreadPoolTestBase<TaskSystemParallelSpawn>(
+            num_instances, num_threads, 0);
+    }
+    return sharedThreadPoolTestBase<TaskSystemSerial>(
+        num_instances, num_threads, 0);
+}
+
+/*
+ * Computation: microbenchmark of per-task scheduling overhead.  For each
+ * thread count from 1 up to max(8, hardware threads), doubling, a fresh
+ * task system of the same type as `t` performs num_bulk_task_launches
+ * launches of num_tasks EmptyTasks, and the mean cost is reported in
+ * ns/task.  Shared state that bounces between cores (e.g. falsely shared
+ * completion counters) shows up as ns/task growing with the thread
+ * count.  The reported time is the sum over all thread counts.  With a
+ * shared pool the pool may be wider than num_threads, but each task
+ * system still runs its tasks on at most num_threads workers.
+ */
+template <class TaskSystem>
+TestResults taskOverheadScalingTestBase() {
+    int num_bulk_task_launches = 200;
+    int num_tasks = 256;
+    int max_threads = std::max(8, (int)std::thread::hardware_concurrency());
+
+    int* slots = new int[num_tasks * EmptyTask::kSlotStride]();
+    EmptyTask task(slots);
+
+    TestResults result;
+    result.passed = true;
+    result.time = 0;
+    int launches_run = 0;
+    for (int num_threads = 1; ; num_threads *= 2) {
+        num_threads = std::min(num_threads, max_threads);
+        TaskSystem* ts = new TaskSystem(num_threads);
+
+        double start_time = CycleTimer::currentSeconds();
+        for (int i = 0; i < num_bulk_task_launches; i++) {
+            ts->run(&task, num_tasks);
+        }
+        double end_time = CycleTimer::currentSeconds();
+        delete ts;
+
+        launches_run += num_bulk_task_launches;
+        result.time += end_time - start_time;
+        printf("  %3d threads: %10.1f ns/task\n", num_threads,
+               (end_time - start_time) * 1e9 / (num_bulk_task_launches * num_tasks));
+
+        if (num_threads == max_threads) {
+            break;
+        }
+    }
+
+    for (int i = 0; i < num_tasks; i++) {
+        if (slots[i * EmptyTask::kSlotStride] != launches_run) {
+            printf("%d: %d expected=%d\n", i, slots[i * EmptyTask::kSlotStride], launches_run);
+            result.passed = false;
+            break;
+        }
+    }
+
+    delete [] slots;
+    return result;
+}
+
+TestResults taskOverheadScalingTest(ITaskSystem* t) {
+    if (dynamic_cast<TaskSystemParallelThreadPoolSleeping*>(t)) {
+        return taskOverheadScalingTestBase<TaskSystemParallelThreadPoolSleeping>();
+    } else if (dynamic_cast<TaskSystemParallelThreadPoolSpinning*>(t)) {
+        return taskOverheadScalingTestBase<TaskSystemParallelThreadPoolSpinning>();
+    } else if (dynamic_cast<TaskSystemParallelSpawn*>(t)) {
+        return taskOverheadScalingTestBase<TaskSystemParallelSpawn>();
+    }
+    return taskOverheadScalingTestBase<TaskSystemSerial>();
+}